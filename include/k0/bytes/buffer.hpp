@@ -1,11 +1,26 @@
 #ifndef KING_LIB_HEADER_BYTES_BUFFER
 #define KING_LIB_HEADER_BYTES_BUFFER
 
-#include <list>
+#include <algorithm>
+#include <vector>
 
-#include <boost/foreach.hpp>
+#include <boost/array.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/circular_buffer.hpp>
 
 #include "type.hpp"
+#include "chunk.hpp"
+#include "slice.hpp"
+#include "search.hpp"
+#include "spill.hpp"
+
+/**
+*	\brief buffer_t 默認 最多緩存的 空閒數據塊 數量
+*/
+#ifndef KING_BYTES_BUFFER_CACHE
+#define KING_BYTES_BUFFER_CACHE 4
+#endif
+
 namespace k0
 {
 namespace bytes
@@ -14,93 +29,252 @@ namespace bytes
 /**
 *   \brief k0::byte_t 流緩衝區
 *
-*   一個類似 golang bytes.Buffer 的 io 緩衝區
+*   一個類似 golang bytes.Buffer 的 io 緩衝區\n
+*   數據 保存在 chunk_t 中 chunk_t 指針 保存在 連續的 環形數組中\n
+*   每個 chunk_t 記錄了 自己在流中的 位置 所以 可以 二分查找 指定偏移 所在的 數據塊\n
+*   data/consume prepare/commit 類似 asio DynamicBuffer 可以直接 用於 asio 的 分散/聚集 io\n
+*   讀空的 數據塊 按容量分級 緩存在 空閒鏈表 中 超過 緩存上限 的數據塊 歸還 pool_t 的線程緩存\n
+*   find 直接 在 數據塊 上 使用 simd 查找 分隔符 不需要 先 拷貝出 數據\n
+*   啓用 spill 後 待讀數據 超過 閾值時 新數據 追加到 臨時文件 直到 文件 被讀空 讀取接口 不變
 */
 class buffer_t
 {
 public:
-	/** 
+	/**
     *    \brief 字節定義
     */
     typedef k0::byte_t byte_t;
-	/** 
-    *   \brief 分片定義
+	/**
+    *   \brief 數據塊 環形數組
+    */
+    typedef boost::circular_buffer<chunk_t*> chunks_t;
+	/**
+    *   \brief 可讀區域 的 const buffer 序列
+    */
+    typedef std::vector<boost::asio::const_buffer> const_buffers_t;
+	/**
+    *   \brief prepare 返回的 可寫區域 最多 分佈在 2個 數據塊 中
     */
-    typedef boost::shared_ptr<fragmentation_t> fragmentation_spt;
+    typedef boost::array<boost::asio::mutable_buffer,2> mutable_buffers_t;
 protected:
-    /** 
-    *   \brief 創建分片時 分片的參考大小
+    /**
+    *   \brief 創建數據塊時 數據塊的參考大小
     */
     int _capacity;
 
-    /** 
-    *   \brief 分片 緩存
+    /**
+    *   \brief 待讀 數據塊
+    */
+    chunks_t _chunks;
+
+    /**
+    *   \brief 按 容量分級 緩存的 空閒數據塊 以便 可以重複利用
+    */
+	chunk_t* _cache[pool_t::classes + 1];
+    /**
+    *   \brief 已緩存的 數據塊 數量
+    */
+    std::size_t _cached;
+    /**
+    *   \brief 最多緩存的 數據塊 數量
+    */
+    std::size_t _cache_max;
+    /**
+    *   \brief prepare 創建的 數據塊 在 commit 前 不在 _chunks 中
+    */
+	chunk_t* _prepared;
+
+    /**
+    *   \brief 待讀 字節數
+    */
+    std::size_t _size;
+    /**
+    *   \brief 首個 待讀字節 在流中的 位置
     */
-    std::list<fragmentation_spt> _fragmentations;
+    k0::uint64_t _position;
 
-    /** 
-    *   \brief 緩存一個 分片 以便 可以重複利用
+    /**
+    *   \brief 溢出文件 未啓用時 爲 NULL
     */
-	fragmentation_spt _cache;
+    spill_file_t* _spill;
+    /**
+    *   \brief 開始 溢出的 待讀字節數 爲0 時 不再 溢出 新數據
+    */
+    std::size_t _spill_threshold;
+    /**
+    *   \brief prepare 返回的 是否是 溢出文件 的 可寫區域
+    */
+    bool _spill_prepared;
 public:
-	/** 
+	/**
     *   \brief 構造一個 緩衝區
-    *   \param capacity 當需要創建新分片時 分片參考大小
+    *   \param capacity 當需要創建新數據塊時 數據塊參考大小
+    *   \param cache 最多緩存的 空閒數據塊 數量
     */
-    explicit buffer_t(int capacity = 1024):_capacity(capacity)
+    explicit buffer_t(int capacity = 1024,std::size_t cache = KING_BYTES_BUFFER_CACHE)
+        :_capacity(capacity),_cached(0),_cache_max(cache),_prepared(NULL),_size(0),_position(0),
+        _spill(NULL),_spill_threshold(0),_spill_prepared(false)
     {
+        for(std::size_t i=0;i<pool_t::classes + 1;++i)
+        {
+            _cache[i] = NULL;
+        }
+    }
+	/**
+    *   \brief 釋放 所有數據塊
+    */
+    ~buffer_t()
+    {
+        reset();
+        delete _spill;
     }
 private:
 	buffer_t& operator=(const buffer_t&);
     buffer_t(const buffer_t&);
 public:
-    /** 
+    /**
     *   \brief 清空流中的 數據
-    *   \param clearcache  是否刪除 this._cache
+    *   \param clearcache  是否刪除 緩存的 空閒數據塊 爲 false 時 流中的數據塊 也會被緩存
     */
     void reset(bool clearcache = true)
     {
         if(clearcache)
         {
-            _cache.reset();
+            reset_cache();
         }
-        else
+        while(!_chunks.empty())
         {
-            if(!_cache && !_fragmentations.empty())
+            chunk_t* c = _chunks.front();
+            _chunks.pop_front();
+            if(clearcache)
             {
-                _cache = _fragmentations.back();
+                chunk_t::release(c);
+            }
+            else
+            {
+                cache_chunk(c);
             }
         }
-        _fragmentations.clear();
+        if(_spill)
+        {
+            _spill->reset();
+        }
+        _spill_prepared = false;
+        _position += _size;
+        _size = 0;
     }
-    /** 
-    *   \brief 刪除 this._cache
+    /**
+    *   \brief 刪除 緩存的 空閒數據塊
     */
     inline void reset_cache()
     {
-         _cache.reset();
+        for(std::size_t i=0;i<pool_t::classes + 1;++i)
+        {
+            while(_cache[i])
+            {
+                chunk_t* c = _cache[i];
+                _cache[i] = c->next();
+                chunk_t::destroy(c);
+            }
+        }
+        _cached = 0;
+        if(_prepared)
+        {
+            chunk_t::destroy(_prepared);
+            _prepared = NULL;
+        }
     }
 
-    /** 
+    /**
+    *   \brief 返回 最多緩存的 空閒數據塊 數量
+    */
+    inline std::size_t cache()const
+    {
+        return _cache_max;
+    }
+    /**
+    *   \brief 設置 最多緩存的 空閒數據塊 數量 多出的 緩存 會被 釋放
+    */
+    void cache(std::size_t n)
+    {
+        _cache_max = n;
+        for(std::size_t i=pool_t::classes + 1;i && _cached > _cache_max;--i)
+        {
+            //優先 釋放 大數據塊
+            while(_cache[i - 1] && _cached > _cache_max)
+            {
+                chunk_t* c = _cache[i - 1];
+                _cache[i - 1] = c->next();
+                chunk_t::destroy(c);
+                --_cached;
+            }
+        }
+    }
+    /**
+    *   \brief 返回 已緩存的 空閒數據塊 數量
+    */
+    inline std::size_t cached()const
+    {
+        return _cached;
+    }
+
+    /**
     *   \brief 返回 流中 待讀字節數
     */
-    std::size_t size()const
+    inline std::size_t size()const
     {
-       std::size_t sum = 0;
-       BOOST_FOREACH(const fragmentation_spt& f,_fragmentations)
-       {
-           sum += f->size();
-       }
-       return sum;
+        return _size;
     }
 
-    /** 
+    /**
+    *   \brief 啓用 溢出模式
+    *
+    *   待讀數據 超過 threshold 時 新數據 不再 分配 數據塊 而是 追加到 dir 下的 臨時文件\n
+    *   在 文件 被讀空 之前 所有 新數據 都寫入 文件 以 保持 順序\n
+    *   threshold 爲 0 時 停止 溢出 已溢出的 數據 仍然 可以 讀取
+    *
+    *   \param threshold    內存中 最多 保存的 待讀字節數
+    *   \param dir    臨時文件 目錄 爲 NULL 時 使用 系統臨時目錄
+    *   \return 失敗 返回 false
+    */
+    bool spill(const std::size_t threshold,const char* dir = NULL)
+    {
+        if(threshold && !_spill)
+        {
+            try
+            {
+                _spill = new spill_file_t(dir);
+            }
+            catch(const std::bad_alloc&)
+            {
+                return false;
+            }
+        }
+        _spill_threshold = threshold;
+        return true;
+    }
+    /**
+    *   \brief 返回 開始 溢出的 待讀字節數 0 表示 未啓用
+    */
+    inline std::size_t spill()const
+    {
+        return _spill_threshold;
+    }
+    /**
+    *   \brief 返回 保存在 溢出文件 中的 待讀字節數
+    */
+    inline std::size_t spilled()const
+    {
+        return _spill ? _spill->size() : 0;
+    }
+
+    /**
     *   \brief 向流中 寫入數據
     *
     *   如果 發生任何 錯誤 將 不寫入 數據 並返回 0
     *   \param bytes    待 寫入字節指針
     *   \param n    寫入長度
-    *   \return 實際寫入長度 
+    *   \return 實際寫入長度
     */
     std::size_t write(const byte_t* bytes,const std::size_t n)
     {
@@ -108,40 +282,24 @@ public:
         {
             return 0;
         }
-
-        if (_fragmentations.empty())
+        if(spilling(n))
         {
-            //1次 寫入
-            fragmentation_spt f = create_fragmentation(n);
-            if(!f)
-            {
-                //創建 分片 失敗
-                return 0;
-            }
-
-            try
-            {
-                //添加新 分片
-                _fragmentations.push_back(f);
-
-                //寫入 分片
-                f->write(bytes,n);
-            }
-            catch(const std::bad_alloc&)
-            {
-                return 0;
-            }
-
-            return n;
+            std::size_t count = _spill->write(bytes,n);
+            _size += count;
+            return count;
         }
 
-        fragmentation_spt& f0 = _fragmentations.back();
-        std::size_t free = f0->get_free();
-        if(free >= n)
+        std::size_t free = 0;
+        if(!_chunks.empty())
         {
-            //1次 寫入
-            f0->write(bytes,n);
-            return n;
+            free = _chunks.back()->get_free();
+            if(free >= n)
+            {
+                //1次 寫入
+                _chunks.back()->write(bytes,n);
+                _size += n;
+                return n;
+            }
         }
 
         //2次 寫入
@@ -151,62 +309,99 @@ public:
         {
             capacity = need;
         }
-        //創建 新分片
-        fragmentation_spt f = create_fragmentation(capacity);
-        if(!f)
+        //創建 新數據塊
+        chunk_t* c = create_chunk(capacity);
+        if(!c)
         {
-            //創建 分片 失敗
+            //創建 數據塊 失敗
             return 0;
         }
-        try
-        {
-            //添加新 分片
-            _fragmentations.push_back(f);
-
-            //寫入 數據
-            f0->write(bytes,free);
-            f->write(bytes + free,need);
-        }
-        catch(const std::bad_alloc&)
+        c->position(_position + _size + free);
+        if(!push_chunk(c))
         {
+            cache_chunk(c);
             return 0;
         }
 
+        //寫入 數據
+        if(free)
+        {
+            _chunks[_chunks.size() - 2]->write(bytes,free);
+        }
+        c->write(bytes + free,need);
+        _size += n;
         return n;
     }
 protected:
-    /** 
-    *   \brief 創建 一個大小至少為 capacity 的分片
+    /**
+    *   \brief 創建 一個大小至少為 capacity 的數據塊
     *
-    *   \param capacity  分片參考大小
+    *   \param capacity  數據塊參考大小
+    *   \return 失敗 返回 NULL
     */
-    fragmentation_spt create_fragmentation(const std::size_t capacity)
+    chunk_t* create_chunk(const std::size_t capacity)
     {
-        try
+        //從 容量足夠的 最小分級 取出 緩存
+        for(std::size_t i=chunk_t::index(capacity);_cached && i<pool_t::classes + 1;++i)
         {
-            if(!_cache)
+            //只有 超過最大分級的 數據塊 容量 不一 需要 逐個比較
+            chunk_t* prev = NULL;
+            for(chunk_t* c = _cache[i];c;c = c->next())
             {
-                return boost::make_shared<fragmentation_t>(capacity);
-            }
-            if(_cache->capacity() < capacity)
-            {
-                return boost::make_shared<fragmentation_t>(capacity);
+                if(c->capacity() >= capacity)
+                {
+                    if(prev)
+                    {
+                        prev->next(c->next());
+                    }
+                    else
+                    {
+                        _cache[i] = c->next();
+                    }
+                    --_cached;
+                    c->next(NULL);
+                    c->init();
+                    return c;
+                }
+                prev = c;
             }
         }
+        try
+        {
+            return chunk_t::create(capacity);
+        }
         catch(const std::bad_alloc&)
         {
-            return fragmentation_spt();
         }
-
-        fragmentation_spt f = _cache;
-        f->init();
-        _cache.reset();
-
-        return f;
+        return NULL;
+    }
+    /**
+    *   \brief 將數據塊 加入 環形數組尾 必要時 擴大 環形數組
+    */
+    bool push_chunk(chunk_t* c)
+    {
+        if(_chunks.full())
+        {
+            std::size_t capacity = _chunks.capacity() * 2;
+            if(capacity < 8)
+            {
+                capacity = 8;
+            }
+            try
+            {
+                _chunks.set_capacity(capacity);
+            }
+            catch(const std::bad_alloc&)
+            {
+                return false;
+            }
+        }
+        _chunks.push_back(c);
+        return true;
     }
 
 public:
-    /** 
+    /**
     *   \brief 將緩衝區 copy 到指定內存 返回實際 copy數據長
     *
     *   被copy的數據 不會從 緩衝區中 刪除\n
@@ -216,25 +411,11 @@ public:
     *   \param n    緩衝區長度
     *   \return 返回實際 copy數據長
     */
-    std::size_t copy_to(byte_t* bytes,std::size_t n)const
+    inline std::size_t copy_to(byte_t* bytes,std::size_t n)const
     {
-        std::size_t sum = 0;
-        std::size_t count;
-        BOOST_FOREACH(const fragmentation_spt& f,_fragmentations)
-        {
-            count = f->copy_to(bytes,n);
-            n -= count;
-            bytes += count;
-            sum += count;
-
-            if(n < 1)
-            {
-                break;
-            }
-        }
-        return sum;
+        return copy_to(0,bytes,n);
     }
-    /** 
+    /**
     *   \brief 將緩衝區 copy 到指定內存 返回實際 copy數據長
     *
     *   被copy的數據 不會從 緩衝區中 刪除\n
@@ -247,46 +428,184 @@ public:
     */
 	std::size_t copy_to(std::size_t skip,byte_t* bytes,std::size_t n)const
     {
+        if(skip >= _size)
+        {
+            return 0;
+        }
+        std::size_t memory = _size - spilled();
+        if(skip >= memory)
+        {
+            return _spill->copy_to(skip - memory,bytes,n);
+        }
+        chunks_t::const_iterator iter = find_chunk(skip);
+        skip = (std::size_t)(_position + skip - (*iter)->position());
+
         std::size_t sum = 0;
-        std::size_t need_skip = 0;
-        std::size_t size;
         std::size_t count;
-        BOOST_FOREACH(const fragmentation_spt& f,_fragmentations)
+        for(;n && iter != _chunks.end();++iter)
         {
-            if(skip)
-            {
-                need_skip = skip;
+            count = (*iter)->copy_to(skip,bytes,n);
+            skip = 0;
+            n -= count;
+            bytes += count;
+            sum += count;
+        }
+        if(n && spilled())
+        {
+            sum += _spill->copy_to(0,bytes,n);
+        }
+        return sum;
+    }
 
-                size = f->size();
-                if(need_skip > size)
+
+    /**
+    *   \brief 查找 失敗時 返回的 位置
+    */
+    static const std::size_t npos = (std::size_t)-1;
+    /**
+    *   \brief 從 第 skip 個 待讀字節 開始 查找 字節 b
+    *
+    *   在每個 數據塊 內 使用 find_byte 查找 不會 拷貝數據
+    *
+    *   \param b    要查找的 字節
+    *   \param skip    忽略 Buffer 中前skip個字節
+    *   \return 返回 b 相對 流頭的 偏移 找不到 返回 npos
+    */
+    std::size_t find(const byte_t b,std::size_t skip = 0)const
+    {
+        if(skip >= _size)
+        {
+            return npos;
+        }
+        std::size_t memory = _size - spilled();
+        if(skip < memory)
+        {
+            chunks_t::const_iterator iter = find_chunk(skip);
+            std::size_t offset = (std::size_t)(_position + skip - (*iter)->position());
+            std::size_t base = skip - offset;
+            for(;iter != _chunks.end();++iter)
+            {
+                const byte_t* p = (*iter)->begin();
+                std::size_t size = (*iter)->size();
+                const byte_t* found = find_byte(p + offset,size - offset,b);
+                if(found)
                 {
-                    need_skip = size;
+                    return base + (found - p);
                 }
-                skip -= need_skip;
-
+                base += size;
+                offset = 0;
             }
-            if(need_skip)
+            skip = memory;
+        }
+        if(spilled())
+        {
+            const byte_t* p = _spill->begin();
+            const byte_t* found = find_byte(p + (skip - memory),_size - skip,b);
+            if(found)
             {
-                count = f->copy_to(need_skip,bytes,n);
+                return memory + (found - p);
             }
-            else
+        }
+        return npos;
+    }
+    /**
+    *   \brief 從 第 skip 個 待讀字節 開始 查找 [pattern,pattern+m)
+    *
+    *   先在 每個 數據塊 內 使用 find_pattern 查找\n
+    *   再 逐個 檢查 從 數據塊尾 開始 跨越到 後續數據塊 的 候選位置
+    *
+    *   \param pattern    要查找的 模式
+    *   \param m    模式長度
+    *   \param skip    忽略 Buffer 中前skip個字節
+    *   \return 返回 模式 相對 流頭的 偏移 找不到 返回 npos
+    */
+    std::size_t find(const byte_t* pattern,const std::size_t m,std::size_t skip = 0)const
+    {
+        if(skip > _size || m > _size - skip)
+        {
+            return npos;
+        }
+        if(!m)
+        {
+            return skip;
+        }
+        std::size_t memory = _size - spilled();
+        if(skip < memory)
+        {
+            std::size_t found = find_memory(pattern,m,skip);
+            if(found != npos)
             {
-                count = f->copy_to(bytes,n);
+                return found;
             }
-            n -= count;
-            bytes += count;
-            sum += count;
-
-            if(n < 1)
+            skip = memory;
+        }
+        if(spilled() && m <= _size - skip)
+        {
+            const byte_t* p = _spill->begin();
+            const byte_t* found = find_pattern(p + (skip - memory),_size - skip,pattern,m);
+            if(found)
             {
-                break;
+                return memory + (found - p);
             }
         }
-        return sum;
+        return npos;
+    }
+    /**
+    *   \brief 查找 以 0 結尾的 字符串 pattern
+    */
+    inline std::size_t find(const char* pattern,std::size_t skip = 0)const
+    {
+        return find((const byte_t*)pattern,strlen(pattern),skip);
     }
+protected:
+    /**
+    *   \brief 在 數據塊 中 查找 起點 在 [skip,內存數據尾) 的 模式 模式 可以 延伸到 溢出文件
+    */
+    std::size_t find_memory(const byte_t* pattern,const std::size_t m,std::size_t skip)const
+    {
+        chunks_t::const_iterator iter = find_chunk(skip);
+        std::size_t offset = (std::size_t)(_position + skip - (*iter)->position());
+        std::size_t base = skip - offset;
+        for(;iter != _chunks.end() && base + offset + m <= _size;++iter)
+        {
+            const byte_t* p = (*iter)->begin();
+            std::size_t size = (*iter)->size();
+            if(offset < size)
+            {
+                const byte_t* found = find_pattern(p + offset,size - offset,pattern,m);
+                if(found)
+                {
+                    return base + (found - p);
+                }
 
+                //跨越 數據塊 邊界的 候選位置
+                std::size_t i = size > m - 1 ? size - (m - 1) : 0;
+                if(i < offset)
+                {
+                    i = offset;
+                }
+                for(;i < size && base + i + m <= _size;++i)
+                {
+                    const byte_t* first = (const byte_t*)memchr(p + i,pattern[0],size - i);
+                    if(!first)
+                    {
+                        break;
+                    }
+                    i = first - p;
+                    if(base + i + m <= _size && equal_at(iter,i,pattern,m))
+                    {
+                        return base + i;
+                    }
+                }
+            }
+            base += size;
+            offset = 0;
+        }
+        return npos;
+    }
+public:
 
-    /** 
+    /**
     *   \brief 從流中 讀取數據 被讀取的數據 將被刪除
     *
     *   \param bytes    待 讀緩衝區
@@ -297,68 +616,371 @@ public:
     {
         std::size_t sum = 0;
         std::size_t count;
-        while(n)
+        while(n && !_chunks.empty())
         {
-            //返回 可讀 分片
-            fragmentation_spt f = get_read_fragmentation();
-            if(!f)
-            {
-                break;
-            }
-            count = f->read(bytes,n);
+            chunk_t* c = _chunks.front();
+            count = c->read(bytes,n);
             n -= count;
             bytes += count;
             sum += count;
+            if(!c->size())
+            {
+                _chunks.pop_front();
+                cache_chunk(c);
+            }
+        }
+        if(n && spilled())
+        {
+            sum += _spill->read(bytes,n);
+        }
+        _size -= sum;
+        _position += sum;
+        return sum;
+    }
+    /**
+    *   \brief 從流中 讀取 n 字節 到 切片 被讀取的數據 將被刪除
+    *
+    *   數據 在同一個 數據塊 中時 切片 直接 共享 數據塊 否則 (包括 溢出文件 中的 數據) 拷貝到 新數據塊
+    *
+    *   \param n    讀取長度
+    *   \param slice    輸出的 切片
+    *   \return 成功返回 n 數據不足 或 失敗 返回 0
+    */
+    std::size_t read(std::size_t n,slice_t& slice)
+    {
+        if(!n || n > _size)
+        {
+            return 0;
+        }
+        chunk_t* c = _chunks.empty() ? NULL : _chunks.front();
+        if(c && c->size() >= n)
+        {
+            //共享 數據塊
+            slice = slice_t(c,c->begin(),n);
+            consume(n);
+            return n;
         }
-        remove_no_read_fragmentation();
 
+        //跨 數據塊 拷貝
+        try
+        {
+            c = chunk_t::create(n);
+        }
+        catch(const std::bad_alloc&)
+        {
+            return 0;
+        }
+        read(c->end(),n);
+        c->commit(n);
+        slice = slice_t(c,c->begin(),n,false);
+        return n;
+    }
+
+    /**
+    *   \brief 將 可讀區域 前 n 字節 以 const buffer 序列 追加到 buffers
+    *
+    *   返回的 buffer 在 下次 修改緩衝區 前有效 可直接 交給 async_write
+    *
+    *   \param buffers    輸出的 buffer 序列
+    *   \param n    最多 返回的 字節數
+    *   \return 實際 返回的 字節數
+    */
+    std::size_t data(const_buffers_t& buffers,std::size_t n = (std::size_t)-1)const
+    {
+        std::size_t sum = 0;
+        for(chunks_t::const_iterator iter = _chunks.begin();n && iter != _chunks.end();++iter)
+        {
+            std::size_t count = (*iter)->size();
+            if(count > n)
+            {
+                count = n;
+            }
+            buffers.push_back(boost::asio::const_buffer((*iter)->begin(),count));
+            n -= count;
+            sum += count;
+        }
+        if(n && spilled())
+        {
+            std::size_t count = spilled();
+            if(count > n)
+            {
+                count = n;
+            }
+            buffers.push_back(boost::asio::const_buffer(_spill->begin(),count));
+            sum += count;
+        }
         return sum;
     }
-protected:
-	/** 
-    *   \brief 返回當前 可讀 緩衝區 或 空指針
+    /**
+    *   \brief 忽略 前skip個字節 將 可讀區域 n 字節 以 const buffer 序列 追加到 buffers
+    *
+    *   \param buffers    輸出的 buffer 序列
+    *   \param skip    忽略 Buffer 中前skip個字節
+    *   \param n    最多 返回的 字節數
+    *   \return 實際 返回的 字節數
     */
-    fragmentation_spt get_read_fragmentation()
+    std::size_t data(const_buffers_t& buffers,std::size_t skip,std::size_t n)const
     {
-        while(!_fragmentations.empty())
+        if(skip >= _size)
+        {
+            return 0;
+        }
+        std::size_t sum = 0;
+        std::size_t memory = _size - spilled();
+        if(skip < memory)
         {
-            const fragmentation_spt& f = _fragmentations.front();
-            if(f->size() < 1)
+            chunks_t::const_iterator iter = find_chunk(skip);
+            std::size_t offset = (std::size_t)(_position + skip - (*iter)->position());
+            for(;n && iter != _chunks.end();++iter)
             {
-                cache_fragmentation(f);
-                _fragmentations.pop_front();
-                continue;
+                std::size_t count = (*iter)->size() - offset;
+                if(count > n)
+                {
+                    count = n;
+                }
+                buffers.push_back(boost::asio::const_buffer((*iter)->begin() + offset,count));
+                n -= count;
+                sum += count;
+                offset = 0;
             }
-            return f;
+            skip = memory;
         }
-
-        return fragmentation_spt();
+        if(n && spilled())
+        {
+            std::size_t count = _size - skip;
+            if(count > n)
+            {
+                count = n;
+            }
+            buffers.push_back(boost::asio::const_buffer(_spill->begin() + (skip - memory),count));
+            sum += count;
+        }
+        return sum;
     }
-    /** 
-    *   \brief 將 f 設置爲 緩存
+    /**
+    *   \brief 從流中 刪除 前 n 字節 數據
+    *
+    *   \return 實際 刪除 長度
     */
-    inline void cache_fragmentation(const fragmentation_spt& f)
+    std::size_t consume(std::size_t n)
     {
-        if(!_cache || _cache->size() < f->size())
+        std::size_t sum = 0;
+        while(n && !_chunks.empty())
         {
-            _cache = f;
+            chunk_t* c = _chunks.front();
+            std::size_t count = c->size();
+            if(count > n)
+            {
+                count = n;
+            }
+            c->consume(count);
+            n -= count;
+            sum += count;
+            if(!c->size())
+            {
+                _chunks.pop_front();
+                cache_chunk(c);
+            }
+        }
+        if(n && spilled())
+        {
+            sum += _spill->consume(n);
         }
+        _size -= sum;
+        _position += sum;
+        return sum;
     }
+    /**
+    *   \brief 返回 流尾 n 字節 可寫區域
+    *
+    *   可寫區域 由 最後一個數據塊的 空閒區 和 一個新數據塊 組成 數據 寫入後 調用 commit\n
+    *   在 commit 之前 不能 調用 write 或 再次 prepare
+    *
+    *   \param n    需要的 字節數
+    *   \param buffers    輸出的 可寫區域
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t prepare(std::size_t n,mutable_buffers_t& buffers)
+    {
+        _spill_prepared = spilling(n);
+        if(_spill_prepared)
+        {
+            //直接 讀入 溢出文件
+            byte_t* p = _spill->prepare(n);
+            if(!p)
+            {
+                return 0;
+            }
+            buffers[0] = boost::asio::mutable_buffer(p,n);
+            buffers[1] = boost::asio::mutable_buffer();
+            return n;
+        }
+        std::size_t free = 0;
+        if(!_chunks.empty())
+        {
+            chunk_t* c = _chunks.back();
+            free = c->get_free();
+            if(free > n)
+            {
+                free = n;
+            }
+            buffers[0] = boost::asio::mutable_buffer(c->end(),free);
+        }
+        else
+        {
+            buffers[0] = boost::asio::mutable_buffer();
+        }
 
-    /** 
-    *   \brief 刪除 無數據可讀的 分片
+        std::size_t need = n - free;
+        if(!need)
+        {
+            buffers[1] = boost::asio::mutable_buffer();
+            return n;
+        }
+        if(_prepared && _prepared->get_free() < need)
+        {
+            cache_chunk(_prepared);
+            _prepared = NULL;
+        }
+        if(!_prepared)
+        {
+            std::size_t capacity = _capacity;
+            if(capacity < need)
+            {
+                capacity = need;
+            }
+            _prepared = create_chunk(capacity);
+            if(!_prepared)
+            {
+                return 0;
+            }
+        }
+        buffers[1] = boost::asio::mutable_buffer(_prepared->end(),need);
+        return n;
+    }
+    /**
+    *   \brief 將 prepare 返回區域的 前 n 字節 加入 可讀區域
+    *
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t commit(std::size_t n)
+    {
+        if(_spill_prepared)
+        {
+            _spill_prepared = false;
+            if(n != _spill->commit(n))
+            {
+                return 0;
+            }
+            _size += n;
+            return n;
+        }
+        std::size_t need = n;
+        if(!_chunks.empty())
+        {
+            chunk_t* c = _chunks.back();
+            std::size_t free = c->get_free();
+            if(free > need)
+            {
+                free = need;
+            }
+            c->commit(free);
+            need -= free;
+        }
+        if(need)
+        {
+            if(!_prepared || _prepared->get_free() < need)
+            {
+                return 0;
+            }
+            _prepared->position(_position + _size + n - need);
+            if(!push_chunk(_prepared))
+            {
+                return 0;
+            }
+            _prepared->commit(need);
+            _prepared = NULL;
+        }
+        _size += n;
+        return n;
+    }
+protected:
+    /**
+    *   \brief 返回 寫入 n 字節 是否 應該 寫入 溢出文件
     */
-    void remove_no_read_fragmentation()
+    inline bool spilling(const std::size_t n)const
     {
-        while(!_fragmentations.empty())
+        if(!_spill)
         {
-            const fragmentation_spt& f = _fragmentations.front();
-            if(f->size())
+            return false;
+        }
+        //溢出文件 讀空前 保持 順序
+        return _spill->size() || (_spill_threshold && _size + n > _spill_threshold);
+    }
+    /**
+    *   \brief 比較 數據塊 在流中的 位置
+    */
+    static inline bool position_less(const k0::uint64_t pos,const chunk_t* c)
+    {
+        return pos < c->position();
+    }
+    /**
+    *   \brief 二分查找 第 skip 個 待讀字節 所在的 數據塊 (skip 必須 小於 size())
+    */
+    inline chunks_t::const_iterator find_chunk(const std::size_t skip)const
+    {
+        //首個 位置 大於 目標的 數據塊 的前一個
+        chunks_t::const_iterator iter = std::upper_bound(_chunks.begin(),_chunks.end(),_position + skip,position_less);
+        return --iter;
+    }
+    /**
+    *   \brief 返回 從 iter 的 第 offset 個 有效字節 開始 是否 與 [pattern,pattern+m) 相同 可以 跨越 數據塊 和 溢出文件
+    */
+    inline bool equal_at(chunks_t::const_iterator iter,std::size_t offset,const byte_t* pattern,std::size_t m)const
+    {
+        for(;m && iter != _chunks.end();++iter)
+        {
+            std::size_t size = (*iter)->size() - offset;
+            if(size > m)
             {
-                break;
+                size = m;
             }
-            cache_fragmentation(f);
-            _fragmentations.pop_front();
+            if(memcmp((*iter)->begin() + offset,pattern,size))
+            {
+                return false;
+            }
+            pattern += size;
+            m -= size;
+            offset = 0;
+        }
+        if(m && m <= spilled())
+        {
+            return !memcmp(_spill->begin(),pattern,m);
+        }
+        return !m;
+    }
+    /**
+    *   \brief 將 c 設置爲 緩存 或 釋放
+    *
+    *   被 slice_t 共享的 數據塊 只 釋放 緩衝區 持有的 引用
+    */
+    inline void cache_chunk(chunk_t* c)
+    {
+        if(c->shared())
+        {
+            chunk_t::release(c);
+        }
+        else if(_cached < _cache_max)
+        {
+            std::size_t i = c->index();
+            c->next(_cache[i]);
+            _cache[i] = c;
+            ++_cached;
+        }
+        else
+        {
+            //歸還 pool_t 線程緩存
+            chunk_t::destroy(c);
         }
     }
 };
@@ -0,0 +1,310 @@
+//緩衝區 使用的 數據塊
+#ifndef KING_LIB_HEADER_BYTES_CHUNK
+#define KING_LIB_HEADER_BYTES_CHUNK
+
+#include "pool.hpp"
+
+#include <cstring>
+
+#include <boost/atomic.hpp>
+namespace k0
+{
+namespace bytes
+{
+
+/**
+*	\brief 數據塊
+*
+*	頭部 和 數據 在同一塊 內存中 數據 緊跟在 頭部之後\n
+*	由 create 從 pool_t 分配 由 destroy 釋放 一個數據塊 只需要一次分配\n
+*	數據塊 帶有 引用計數 被 slice_t 共享時 由 release 在 最後一個引用 消失時 釋放
+*/
+class chunk_t
+{
+protected:
+    typedef k0::byte_t byte_t;
+
+	/**
+	*	\brief 數據 容量
+	*/
+    std::size_t _capacity;
+	/**
+	*	\brief 數據 偏移
+	*/
+    std::size_t _offset;
+	/**
+	*	\brief 數據 大小
+	*/
+    std::size_t _size;
+	/**
+	*	\brief data() 首字節 在流中的 位置
+	*/
+    k0::uint64_t _position;
+	/**
+	*	\brief 引用計數
+	*/
+    boost::atomic<long> _refs;
+	/**
+	*	\brief 空閒鏈表 中的 下一個數據塊
+	*/
+    chunk_t* _next;
+
+    explicit chunk_t(const std::size_t capacity):
+        _capacity(capacity),_offset(0),_size(0),_position(0),_refs(1),_next(NULL)
+    {
+    }
+    ~chunk_t()
+    {
+    }
+private:
+    chunk_t(const chunk_t&);
+    chunk_t& operator=(const chunk_t&);
+public:
+    /**
+	*	\brief 創建一個 容量 至少爲 capacity 的數據塊
+	*
+	*	容量 會被擴展到 pool_t 分級的 大小 以免浪費
+	*
+	*	\exception std::bad_alloc
+	*/
+    static chunk_t* create(const std::size_t capacity)
+    {
+        std::size_t size = pool_t::round(sizeof(chunk_t) + capacity);
+        void* p = pool_t::instance().malloc(size);
+        return new(p) chunk_t(size - sizeof(chunk_t));
+    }
+    /**
+	*	\brief 釋放 create 創建的 數據塊
+	*/
+    static void destroy(chunk_t* c)
+    {
+        std::size_t size = sizeof(chunk_t) + c->_capacity;
+        c->~chunk_t();
+        pool_t::instance().free(c,size);
+    }
+    /**
+	*	\brief 增加 引用計數
+	*/
+    inline void add_ref()
+    {
+        _refs.fetch_add(1,boost::memory_order_relaxed);
+    }
+    /**
+	*	\brief 減少 引用計數 爲0時 釋放 數據塊
+	*/
+    static inline void release(chunk_t* c)
+    {
+        if(c->_refs.fetch_sub(1,boost::memory_order_release) == 1)
+        {
+            boost::atomic_thread_fence(boost::memory_order_acquire);
+            destroy(c);
+        }
+    }
+    /**
+	*	\brief 返回 數據塊 是否 被多處 引用
+	*/
+    inline bool shared()const
+    {
+        return _refs.load(boost::memory_order_acquire) > 1;
+    }
+
+    /**
+	*	\brief 返回 數據塊 所在的 pool_t 分級 超過最大分級 返回 pool_t::classes
+	*/
+    inline std::size_t index()const
+    {
+        std::size_t size = sizeof(chunk_t) + _capacity;
+        if(size > pool_t::max_size)
+        {
+            return pool_t::classes;
+        }
+        return pool_t::index(size);
+    }
+    /**
+	*	\brief 返回 容量至少爲 capacity 的數據塊 所在的 分級
+	*/
+    static inline std::size_t index(const std::size_t capacity)
+    {
+        std::size_t size = sizeof(chunk_t) + capacity;
+        if(size > pool_t::max_size)
+        {
+            return pool_t::classes;
+        }
+        return pool_t::index(size);
+    }
+    /**
+	*	\brief 返回 空閒鏈表 中的 下一個數據塊
+	*/
+    inline chunk_t* next()const
+    {
+        return _next;
+    }
+    /**
+	*	\brief 設置 空閒鏈表 中的 下一個數據塊
+	*/
+    inline void next(chunk_t* c)
+    {
+        _next = c;
+    }
+
+    /**
+	*	\brief 返回 數據 起始地址
+	*/
+    inline byte_t* data()
+    {
+        return (byte_t*)(this + 1);
+    }
+    /**
+	*	\brief 返回 數據 起始地址
+	*/
+    inline const byte_t* data()const
+    {
+        return (const byte_t*)(this + 1);
+    }
+    /**
+	*	\brief 返回 有效數據 起始地址
+	*/
+    inline const byte_t* begin()const
+    {
+        return data() + _offset;
+    }
+
+    /**
+	*	\brief 返回 空閒區 起始地址
+	*/
+    inline byte_t* end()
+    {
+        return data() + _offset + _size;
+    }
+
+    /**
+	*	\brief 重置 數據塊
+	*
+	*	此後 大小 偏移 爲0  容量不變
+	*/
+    inline void init()
+    {
+        _offset = _size = 0;
+    }
+    /**
+	*	\brief 返回 容量
+	*/
+    inline std::size_t capacity()const
+    {
+        return _capacity;
+    }
+    /**
+	*	\brief 返回 有效數據 實際大小
+	*/
+    inline std::size_t size()const
+    {
+        return _size;
+    }
+    /**
+	*	\brief 返回 有效數據 首字節 在流中的 位置
+	*/
+    inline k0::uint64_t position()const
+    {
+        return _position + _offset;
+    }
+    /**
+	*	\brief 設置 data() 首字節 在流中的 位置
+	*/
+    inline void position(const k0::uint64_t pos)
+    {
+        _position = pos;
+    }
+    /**
+	*	\brief 返回 空閒 容量
+	*/
+    inline std::size_t get_free()const
+    {
+        return _capacity - _offset - _size;
+    }
+
+    /**
+	*	\brief 在數據塊尾 寫入數據
+	*	\return	實際寫入大小
+	*/
+    inline std::size_t write(const byte_t* bytes,const std::size_t n)
+    {
+        std::size_t need = n;
+        std::size_t free = get_free();
+        if(need > free)
+        {
+            need = free;
+        }
+        memcpy(data() + _offset + _size,bytes,need);
+        _size += need;
+        return need;
+    }
+    /**
+	*	\brief 將 空閒區 前 n 字節 標記爲 有效數據 (n 不能大於 get_free())
+	*/
+    inline void commit(const std::size_t n)
+    {
+        _size += n;
+    }
+    /**
+	*	\brief 移除 頭部 n 字節 有效數據 (n 不能大於 size())
+	*/
+    inline void consume(const std::size_t n)
+    {
+        _size -= n;
+        _offset += n;
+    }
+    /**
+	*	\brief 從數據塊頭 讀取數據 被讀取的 數據 將被移除
+	*	\return	實際讀取大小
+	*/
+    inline std::size_t read(byte_t* bytes,const std::size_t n)
+    {
+        std::size_t need = n;
+        if(need > _size)
+        {
+            need = _size;
+        }
+        memcpy(bytes,data() + _offset,need);
+        _size -= need;
+        _offset += need;
+        return need;
+    }
+    /**
+	*	\brief 跳過 skip 字節後 拷貝數據 被拷貝的 數據 不會被移除
+	*	\return	實際拷貝大小
+	*/
+    inline std::size_t copy_to(const std::size_t skip,byte_t* bytes,const std::size_t n)const
+    {
+        if(skip >= _size)
+        {
+            return 0;
+        }
+        std::size_t need = _size - skip;
+        if(need > n)
+        {
+            need = n;
+        }
+        memcpy(bytes,data() + _offset + skip,need);
+        return need;
+    }
+};
+
+/**
+*	\brief 供 boost::intrusive_ptr 使用
+*/
+inline void intrusive_ptr_add_ref(chunk_t* c)
+{
+    c->add_ref();
+}
+/**
+*	\brief 供 boost::intrusive_ptr 使用
+*/
+inline void intrusive_ptr_release(chunk_t* c)
+{
+    chunk_t::release(c);
+}
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_CHUNK
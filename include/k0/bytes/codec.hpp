@@ -0,0 +1,581 @@
+//定長整數 和 varint 的 編碼/解碼
+#ifndef KING_LIB_HEADER_BYTES_CODEC
+#define KING_LIB_HEADER_BYTES_CODEC
+
+#include "type.hpp"
+#include "../cpu.hpp"
+
+#include <cstring>
+
+#include <boost/type_traits/make_unsigned.hpp>
+
+#if defined(KING_CPU_X86)
+#include <emmintrin.h>
+#endif
+
+/**
+*	\brief 主機 字節序 爲 小端時 定義
+*/
+#if !defined(KING_BYTES_LITTLE_ENDIAN) && !defined(KING_BYTES_BIG_ENDIAN)
+#if defined(KING_CPU_X86) || defined(_WIN32) || defined(__LITTLE_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define KING_BYTES_LITTLE_ENDIAN
+#else
+#define KING_BYTES_BIG_ENDIAN
+#endif
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+/**
+*	\brief varint 編碼 最大長度 (64 bit)
+*/
+const std::size_t varint_max_size = 10;
+/**
+*	\brief varint 超過 64 bit 時 解碼函數 返回的 錯誤
+*/
+const std::size_t varint_error = (std::size_t)-1;
+
+/**
+*	\brief 反轉 字節序
+*/
+inline k0::uint8_t byte_swap(const k0::uint8_t v)
+{
+    return v;
+}
+/**
+*	\brief 反轉 字節序
+*/
+inline k0::uint16_t byte_swap(const k0::uint16_t v)
+{
+    return (k0::uint16_t)((v >> 8) | (v << 8));
+}
+/**
+*	\brief 反轉 字節序
+*/
+inline k0::uint32_t byte_swap(const k0::uint32_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong(v);
+#elif defined(__GNUC__)
+    return __builtin_bswap32(v);
+#else
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+#endif
+}
+/**
+*	\brief 反轉 字節序
+*/
+inline k0::uint64_t byte_swap(const k0::uint64_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#elif defined(__GNUC__)
+    return __builtin_bswap64(v);
+#else
+    return ((k0::uint64_t)byte_swap((k0::uint32_t)v) << 32) | byte_swap((k0::uint32_t)(v >> 32));
+#endif
+}
+
+/**
+*	\brief 從 p 讀取 小端 整數 p 不需要 對齊
+*/
+template<typename T>
+inline T get_le(const k0::byte_t* p)
+{
+    typedef typename boost::make_unsigned<T>::type unsigned_t;
+    unsigned_t v;
+    memcpy(&v,p,sizeof(v));
+#if defined(KING_BYTES_BIG_ENDIAN)
+    v = byte_swap(v);
+#endif
+    return (T)v;
+}
+/**
+*	\brief 從 p 讀取 大端 整數 p 不需要 對齊
+*/
+template<typename T>
+inline T get_be(const k0::byte_t* p)
+{
+    typedef typename boost::make_unsigned<T>::type unsigned_t;
+    unsigned_t v;
+    memcpy(&v,p,sizeof(v));
+#if defined(KING_BYTES_LITTLE_ENDIAN)
+    v = byte_swap(v);
+#endif
+    return (T)v;
+}
+/**
+*	\brief 向 p 寫入 小端 整數 p 不需要 對齊
+*/
+template<typename T>
+inline void put_le(k0::byte_t* p,const T v)
+{
+    typedef typename boost::make_unsigned<T>::type unsigned_t;
+    unsigned_t u = (unsigned_t)v;
+#if defined(KING_BYTES_BIG_ENDIAN)
+    u = byte_swap(u);
+#endif
+    memcpy(p,&u,sizeof(u));
+}
+/**
+*	\brief 向 p 寫入 大端 整數 p 不需要 對齊
+*/
+template<typename T>
+inline void put_be(k0::byte_t* p,const T v)
+{
+    typedef typename boost::make_unsigned<T>::type unsigned_t;
+    unsigned_t u = (unsigned_t)v;
+#if defined(KING_BYTES_LITTLE_ENDIAN)
+    u = byte_swap(u);
+#endif
+    memcpy(p,&u,sizeof(u));
+}
+
+/**
+*	\brief 將 有符號整數 映射爲 無符號整數 使 絕對值小的 負數 也 編碼得短
+*/
+inline k0::uint64_t zigzag_encode(const k0::int64_t v)
+{
+    return ((k0::uint64_t)v << 1) ^ (k0::uint64_t)(v >> 63);
+}
+/**
+*	\brief zigzag_encode 的 逆運算
+*/
+inline k0::int64_t zigzag_decode(const k0::uint64_t v)
+{
+    return (k0::int64_t)(v >> 1) ^ -(k0::int64_t)(v & 1);
+}
+/**
+*	\brief 返回 v 的 LEB128 varint 編碼 長度
+*/
+inline std::size_t varint_size(k0::uint64_t v)
+{
+    std::size_t n = 1;
+    for(;v >= 0x80;v >>= 7)
+    {
+        ++n;
+    }
+    return n;
+}
+/**
+*	\brief 以 LEB128 varint 編碼 v 到 p  p 至少 需要 varint_size(v) 字節
+*	\return 寫入的 字節數
+*/
+inline std::size_t put_varint(k0::byte_t* p,k0::uint64_t v)
+{
+    std::size_t n = 0;
+    for(;v >= 0x80;v >>= 7)
+    {
+        p[n++] = (k0::byte_t)(v | 0x80);
+    }
+    p[n++] = (k0::byte_t)v;
+    return n;
+}
+/**
+*	\brief 從 [p,p+n) 解碼 一個 LEB128 varint
+*	\return 成功 返回 讀取的 字節數 數據不完整 返回 0 超過 64 bit 返回 varint_error
+*/
+inline std::size_t get_varint(const k0::byte_t* p,const std::size_t n,k0::uint64_t& v)
+{
+    k0::uint64_t x = 0;
+    for(std::size_t i=0;i<n;++i)
+    {
+        k0::byte_t b = p[i];
+        if(i == varint_max_size - 1 && b > 1)
+        {
+            return varint_error;
+        }
+        x |= (k0::uint64_t)(b & 0x7f) << (7 * i);
+        if(!(b & 0x80))
+        {
+            v = x;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+*	\brief 將 小端 載入的 最多 8 字節 varint 的 7 bit 分組 拼接爲 整數 (忽略 延續位)
+*/
+inline k0::uint64_t varint_compact(k0::uint64_t x)
+{
+    x &= 0x7f7f7f7f7f7f7f7fULL;
+    x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+    x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+    x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+    return x;
+}
+#if defined(KING_CPU_X86)
+/**
+*	\brief 如果 p 開始的 16 字節 都是 單字節 varint 將其 寫入 out 並返回 true
+*/
+KING_CPU_TARGET("sse2")
+inline bool varint_single16_sse2(const k0::byte_t* p,k0::uint64_t* out)
+{
+    if(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)))
+    {
+        return false;
+    }
+    for(std::size_t i=0;i<16;++i)
+    {
+        out[i] = p[i];
+    }
+    return true;
+}
+#endif
+/**
+*	\brief 從 [p,p+n) 批量 解碼 最多 count 個 varint 到 out
+*
+*	連續 16 個 單字節 varint 使用 sse2 一次 判斷\n
+*	剩餘 至少 8 字節 時 一次 載入 8 字節 由 延續位 計算 長度 並 並行 拼接 7 bit 分組\n
+*	其它情況 逐字節 解碼
+*
+*	\param used 輸出 已解碼的 字節數
+*	\return 解碼的 varint 數量 遇到 不完整 或 錯誤的 varint 時 停止
+*/
+inline std::size_t get_varints(const k0::byte_t* p,const std::size_t n,k0::uint64_t* out,const std::size_t count,std::size_t& used)
+{
+#if defined(KING_CPU_X86)
+    const bool sse2 = k0::cpu::features().sse2;
+#endif
+    std::size_t i = 0;
+    std::size_t offset = 0;
+    while(i < count)
+    {
+        std::size_t left = n - offset;
+#if defined(KING_CPU_X86)
+        if(sse2 && left >= 16 && count - i >= 16 && varint_single16_sse2(p + offset,out + i))
+        {
+            offset += 16;
+            i += 16;
+            continue;
+        }
+#endif
+        if(left >= 8)
+        {
+            k0::uint64_t x = get_le<k0::uint64_t>(p + offset);
+            k0::uint64_t stops = ~x & 0x8080808080808080ULL;
+            if(stops)
+            {
+                k0::uint32_t low = (k0::uint32_t)stops;
+                unsigned int bit = low ? k0::cpu::ctz(low) : 32 + k0::cpu::ctz((k0::uint32_t)(stops >> 32));
+                std::size_t len = bit / 8 + 1;
+                if(len < 8)
+                {
+                    x &= ((k0::uint64_t)1 << (len * 8)) - 1;
+                }
+                out[i++] = varint_compact(x);
+                offset += len;
+                continue;
+            }
+        }
+
+        k0::uint64_t v;
+        std::size_t len = get_varint(p + offset,left,v);
+        if(!len || len == varint_error)
+        {
+            break;
+        }
+        out[i++] = v;
+        offset += len;
+    }
+    used = offset;
+    return i;
+}
+
+/**
+*	\brief 向 流尾 寫入 小端 整數
+*	\param B buffer_t 或 mirror_ring_t
+*/
+template<typename T,typename B>
+inline bool write_le(B& buf,const T v)
+{
+    k0::byte_t b[sizeof(T)];
+    put_le(b,v);
+    return buf.write(b,sizeof(T)) == sizeof(T);
+}
+/**
+*	\brief 向 流尾 寫入 大端 整數
+*/
+template<typename T,typename B>
+inline bool write_be(B& buf,const T v)
+{
+    k0::byte_t b[sizeof(T)];
+    put_be(b,v);
+    return buf.write(b,sizeof(T)) == sizeof(T);
+}
+/**
+*	\brief 向 流尾 寫入 varint
+*/
+template<typename B>
+inline bool write_varint(B& buf,const k0::uint64_t v)
+{
+    k0::byte_t b[varint_max_size];
+    std::size_t n = put_varint(b,v);
+    return buf.write(b,n) == n;
+}
+/**
+*	\brief 忽略 前skip個字節 讀取 小端 整數 數據 不會被刪除
+*/
+template<typename T,typename B>
+inline bool peek_le(const B& buf,const std::size_t skip,T& v)
+{
+    k0::byte_t b[sizeof(T)];
+    if(buf.copy_to(skip,b,sizeof(T)) != sizeof(T))
+    {
+        return false;
+    }
+    v = get_le<T>(b);
+    return true;
+}
+/**
+*	\brief 忽略 前skip個字節 讀取 大端 整數 數據 不會被刪除
+*/
+template<typename T,typename B>
+inline bool peek_be(const B& buf,const std::size_t skip,T& v)
+{
+    k0::byte_t b[sizeof(T)];
+    if(buf.copy_to(skip,b,sizeof(T)) != sizeof(T))
+    {
+        return false;
+    }
+    v = get_be<T>(b);
+    return true;
+}
+/**
+*	\brief 忽略 前skip個字節 讀取 varint 數據 不會被刪除
+*	\return 同 get_varint
+*/
+template<typename B>
+inline std::size_t peek_varint(const B& buf,const std::size_t skip,k0::uint64_t& v)
+{
+    k0::byte_t b[varint_max_size];
+    std::size_t n = buf.copy_to(skip,b,varint_max_size);
+    return get_varint(b,n,v);
+}
+/**
+*	\brief 從 流頭 讀取 小端 整數 數據不足時 不會 刪除數據
+*/
+template<typename T,typename B>
+inline bool read_le(B& buf,T& v)
+{
+    if(!peek_le(buf,0,v))
+    {
+        return false;
+    }
+    buf.consume(sizeof(T));
+    return true;
+}
+/**
+*	\brief 從 流頭 讀取 大端 整數 數據不足時 不會 刪除數據
+*/
+template<typename T,typename B>
+inline bool read_be(B& buf,T& v)
+{
+    if(!peek_be(buf,0,v))
+    {
+        return false;
+    }
+    buf.consume(sizeof(T));
+    return true;
+}
+/**
+*	\brief 從 流頭 讀取 varint 只有 成功時 刪除數據
+*	\return 同 get_varint
+*/
+template<typename B>
+inline std::size_t read_varint(B& buf,k0::uint64_t& v)
+{
+    std::size_t n = peek_varint(buf,0,v);
+    if(n && n != varint_error)
+    {
+        buf.consume(n);
+    }
+    return n;
+}
+
+/**
+*	\brief 順序 向 一段內存 (如 bytes_t) 寫入 編碼數據
+*
+*	空間 不足時 寫入函數 返回 false 且 不寫入 任何數據
+*/
+class writer_t
+{
+protected:
+    typedef k0::byte_t byte_t;
+
+    byte_t* _data;
+    std::size_t _size;
+    std::size_t _offset;
+public:
+    writer_t(byte_t* data,const std::size_t size)
+        :_data(data),_size(size),_offset(0)
+    {
+    }
+    explicit writer_t(bytes_t& bytes)
+        :_data(bytes.get()),_size(bytes.size()),_offset(0)
+    {
+    }
+    /**
+	*	\brief 返回 已寫入的 字節數
+	*/
+    inline std::size_t offset()const
+    {
+        return _offset;
+    }
+    /**
+	*	\brief 返回 剩餘 可寫入的 字節數
+	*/
+    inline std::size_t get_free()const
+    {
+        return _size - _offset;
+    }
+    template<typename T>
+    inline bool put_le(const T v)
+    {
+        if(get_free() < sizeof(T))
+        {
+            return false;
+        }
+        k0::bytes::put_le(_data + _offset,v);
+        _offset += sizeof(T);
+        return true;
+    }
+    template<typename T>
+    inline bool put_be(const T v)
+    {
+        if(get_free() < sizeof(T))
+        {
+            return false;
+        }
+        k0::bytes::put_be(_data + _offset,v);
+        _offset += sizeof(T);
+        return true;
+    }
+    inline bool put_varint(const k0::uint64_t v)
+    {
+        if(get_free() < varint_size(v))
+        {
+            return false;
+        }
+        _offset += k0::bytes::put_varint(_data + _offset,v);
+        return true;
+    }
+    inline bool put(const byte_t* bytes,const std::size_t n)
+    {
+        if(get_free() < n)
+        {
+            return false;
+        }
+        memcpy(_data + _offset,bytes,n);
+        _offset += n;
+        return true;
+    }
+};
+/**
+*	\brief 順序 從 一段內存 (如 bytes_t) 讀取 編碼數據
+*
+*	數據 不足時 讀取函數 返回 false 且 不移動 讀取位置
+*/
+class reader_t
+{
+protected:
+    typedef k0::byte_t byte_t;
+
+    const byte_t* _data;
+    std::size_t _size;
+    std::size_t _offset;
+public:
+    reader_t(const byte_t* data,const std::size_t size)
+        :_data(data),_size(size),_offset(0)
+    {
+    }
+    explicit reader_t(const bytes_t& bytes)
+        :_data(bytes.get()),_size(bytes.size()),_offset(0)
+    {
+    }
+    /**
+	*	\brief 返回 已讀取的 字節數
+	*/
+    inline std::size_t offset()const
+    {
+        return _offset;
+    }
+    /**
+	*	\brief 返回 剩餘 未讀取的 字節數
+	*/
+    inline std::size_t size()const
+    {
+        return _size - _offset;
+    }
+    template<typename T>
+    inline bool get_le(T& v)
+    {
+        if(size() < sizeof(T))
+        {
+            return false;
+        }
+        v = k0::bytes::get_le<T>(_data + _offset);
+        _offset += sizeof(T);
+        return true;
+    }
+    template<typename T>
+    inline bool get_be(T& v)
+    {
+        if(size() < sizeof(T))
+        {
+            return false;
+        }
+        v = k0::bytes::get_be<T>(_data + _offset);
+        _offset += sizeof(T);
+        return true;
+    }
+    inline bool get_varint(k0::uint64_t& v)
+    {
+        std::size_t n = k0::bytes::get_varint(_data + _offset,size(),v);
+        if(!n || n == varint_error)
+        {
+            return false;
+        }
+        _offset += n;
+        return true;
+    }
+    /**
+	*	\brief 批量 讀取 最多 count 個 varint
+	*	\return 讀取的 數量
+	*/
+    inline std::size_t get_varints(k0::uint64_t* out,const std::size_t count)
+    {
+        std::size_t used;
+        std::size_t n = k0::bytes::get_varints(_data + _offset,size(),out,count,used);
+        _offset += used;
+        return n;
+    }
+    inline bool get(byte_t* bytes,const std::size_t n)
+    {
+        if(size() < n)
+        {
+            return false;
+        }
+        memcpy(bytes,_data + _offset,n);
+        _offset += n;
+        return true;
+    }
+    inline bool skip(const std::size_t n)
+    {
+        if(size() < n)
+        {
+            return false;
+        }
+        _offset += n;
+        return true;
+    }
+};
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_CODEC
@@ -0,0 +1,210 @@
+//crc32c (Castagnoli) 校驗
+#ifndef KING_LIB_HEADER_BYTES_CRC32C
+#define KING_LIB_HEADER_BYTES_CRC32C
+
+#include "codec.hpp"
+#include "../cpu.hpp"
+
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/thread/once.hpp>
+
+#if defined(KING_CPU_SSE42)
+#include <nmmintrin.h>
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+	/**
+	*	\brief crc32c 計算函數 crc 爲 未取反的 中間狀態
+	*/
+	typedef k0::uint32_t (*crc32c_ft)(k0::uint32_t,const k0::byte_t*,std::size_t);
+
+	/**
+	*	\brief 返回 slicing-by-8 使用的 查找表
+	*/
+	inline const k0::uint32_t (*crc32c_table())[256]
+	{
+		static k0::uint32_t table[8][256];
+		static boost::once_flag flag = BOOST_ONCE_INIT;
+		struct init_t
+		{
+			static void init()
+			{
+				for(k0::uint32_t i=0;i<256;++i)
+				{
+					k0::uint32_t c = i;
+					for(int j=0;j<8;++j)
+					{
+						c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+					}
+					table[0][i] = c;
+				}
+				for(std::size_t i=0;i<256;++i)
+				{
+					for(std::size_t k=1;k<8;++k)
+					{
+						table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+					}
+				}
+			}
+		};
+		boost::call_once(&init_t::init,flag);
+		return table;
+	}
+	/**
+	*	\brief slicing-by-8 實現 每次 查表 處理 8 字節
+	*/
+	inline k0::uint32_t crc32c_scalar(k0::uint32_t crc,const k0::byte_t* p,std::size_t n)
+	{
+		const k0::uint32_t (*t)[256] = crc32c_table();
+		for(;n >= 8;n -= 8,p += 8)
+		{
+			k0::uint32_t lo = get_le<k0::uint32_t>(p) ^ crc;
+			k0::uint32_t hi = get_le<k0::uint32_t>(p + 4);
+			crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+				^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+		}
+		for(;n;--n,++p)
+		{
+			crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+		}
+		return crc;
+	}
+#if defined(KING_CPU_SSE42)
+	/**
+	*	\brief 使用 sse4.2 crc32 指令 的實現
+	*/
+	KING_CPU_TARGET("sse4.2")
+	inline k0::uint32_t crc32c_sse42(k0::uint32_t crc,const k0::byte_t* p,std::size_t n)
+	{
+#if defined(__x86_64__) || defined(_M_X64)
+		k0::uint64_t c = crc;
+		for(;n >= 8;n -= 8,p += 8)
+		{
+			c = _mm_crc32_u64(c,get_le<k0::uint64_t>(p));
+		}
+		crc = (k0::uint32_t)c;
+#endif
+		for(;n >= 4;n -= 4,p += 4)
+		{
+			crc = _mm_crc32_u32(crc,get_le<k0::uint32_t>(p));
+		}
+		for(;n;--n,++p)
+		{
+			crc = _mm_crc32_u8(crc,*p);
+		}
+		return crc;
+	}
+#endif
+	/**
+	*	\brief 返回 當前 cpu 可用的 最快 crc32c 實現
+	*/
+	inline crc32c_ft crc32c_function()
+	{
+#if defined(KING_CPU_SSE42)
+		if(k0::cpu::features().sse42)
+		{
+			return crc32c_sse42;
+		}
+#endif
+		return crc32c_scalar;
+	}
+	/**
+	*	\brief 在 crc (之前數據的 crc32c) 之後 繼續 計算 [p,p+n) 的 crc32c
+	*/
+	inline k0::uint32_t crc32c_extend(const k0::uint32_t crc,const k0::byte_t* p,const std::size_t n)
+	{
+		static const crc32c_ft f = crc32c_function();
+		return ~f(~crc,p,n);
+	}
+	/**
+	*	\brief 返回 [p,p+n) 的 crc32c
+	*/
+	inline k0::uint32_t crc32c(const k0::byte_t* p,const std::size_t n)
+	{
+		return crc32c_extend(0,p,n);
+	}
+
+	/**
+	*	\brief 增量 計算 緩衝區 頭部 一段數據的 crc32c
+	*
+	*	每次 數據 寫入 緩衝區 後 調用 update 只計算 新到達的 字節\n
+	*	數據 還在 緩存中 時 完成 計算 校驗時 不需要 再 遍歷一次 消息
+	*/
+	class crc32c_stream_t
+	{
+	protected:
+		typedef std::vector<boost::asio::const_buffer> const_buffers_t;
+		/**
+		*	\brief 已計算 部分的 crc32c
+		*/
+		k0::uint32_t _crc;
+		/**
+		*	\brief 已計算的 字節數 (從 緩衝區頭 開始)
+		*/
+		std::size_t _hashed;
+		/**
+		*	\brief 重複使用的 buffer 序列
+		*/
+		const_buffers_t _buffers;
+	public:
+		crc32c_stream_t():_crc(0),_hashed(0)
+		{
+		}
+		/**
+		*	\brief 計算 緩衝區 [hashed(),end) 中 已到達的 字節
+		*	\param B buffer_t 或 mirror_ring_t
+		*	\param end 需要 計算到的 位置 超過 緩衝區大小 時 只計算 已有數據
+		*	\return 是否 已經 計算到 end
+		*/
+		template<typename B>
+		bool update(const B& buffer,const std::size_t end)
+		{
+			std::size_t size = buffer.size();
+			if(size > end)
+			{
+				size = end;
+			}
+			if(size > _hashed)
+			{
+				_buffers.clear();
+				buffer.data(_buffers,_hashed,size - _hashed);
+				for(const_buffers_t::const_iterator iter = _buffers.begin();iter != _buffers.end();++iter)
+				{
+					_crc = crc32c_extend(_crc,boost::asio::buffer_cast<const k0::byte_t*>(*iter),boost::asio::buffer_size(*iter));
+				}
+				_hashed = size;
+			}
+			return _hashed == end;
+		}
+		/**
+		*	\brief 返回 已計算 部分的 crc32c
+		*/
+		inline k0::uint32_t value()const
+		{
+			return _crc;
+		}
+		/**
+		*	\brief 返回 已計算的 字節數
+		*/
+		inline std::size_t hashed()const
+		{
+			return _hashed;
+		}
+		/**
+		*	\brief 開始 計算 下一段數據 (緩衝區頭 已被 讀取)
+		*/
+		inline void reset()
+		{
+			_crc = 0;
+			_hashed = 0;
+		}
+	};
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_CRC32C
@@ -0,0 +1,500 @@
+//虛擬內存 鏡像 環形緩衝區
+#ifndef KING_LIB_HEADER_BYTES_MIRROR
+#define KING_LIB_HEADER_BYTES_MIRROR
+
+#include "type.hpp"
+#include "slice.hpp"
+#include "search.hpp"
+
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/asio/buffer.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+
+/**
+*   \brief 虛擬內存 鏡像 環形緩衝區
+*
+*   將 同一段 物理內存 連續 映射兩次 環形區域 中 任意 可讀/可寫 窗口 都是 連續內存\n
+*   接口 與 buffer_t 相同 可以 代替 buffer_t 作爲 msg_server_t 的 消息緩衝區\n
+*   空間不足時 會 重新映射 一個 兩倍大小的 環形區域 並 拷貝 待讀數據
+*/
+class mirror_ring_t
+{
+public:
+	/**
+    *    \brief 字節定義
+    */
+    typedef k0::byte_t byte_t;
+	/**
+    *   \brief 可讀區域 的 const buffer 序列
+    */
+    typedef std::vector<boost::asio::const_buffer> const_buffers_t;
+	/**
+    *   \brief prepare 返回的 可寫區域 (只使用 第一個 buffer)
+    */
+    typedef boost::array<boost::asio::mutable_buffer,2> mutable_buffers_t;
+protected:
+#ifdef _WIN32
+    typedef HANDLE handle_t;
+#else
+    typedef int handle_t;
+#endif
+    /**
+    *   \brief 映射 起始地址 大小爲 _capacity * 2
+    */
+    byte_t* _base;
+    /**
+    *   \brief 環形區域 大小
+    */
+    std::size_t _capacity;
+    /**
+    *   \brief 首個 待讀字節 偏移
+    */
+    std::size_t _offset;
+    /**
+    *   \brief 待讀 字節數
+    */
+    std::size_t _size;
+    /**
+    *   \brief 映射 句柄 (只在 windows 使用)
+    */
+    handle_t _mapping;
+public:
+	/**
+    *   \brief 構造一個 鏡像 環形緩衝區
+    *   \param capacity 環形區域 參考大小 會被 擴展到 頁大小 的整數倍
+    */
+    explicit mirror_ring_t(std::size_t capacity = 1024 * 64)
+        :_base(NULL),_capacity(0),_offset(0),_size(0),_mapping(0)
+    {
+        map(capacity,_base,_capacity,_mapping);
+    }
+    ~mirror_ring_t()
+    {
+        unmap(_base,_capacity,_mapping);
+    }
+private:
+	mirror_ring_t& operator=(const mirror_ring_t&);
+    mirror_ring_t(const mirror_ring_t&);
+public:
+    /**
+    *   \brief 返回 映射 是否成功
+    */
+    inline operator bool()const
+    {
+        return _base != NULL;
+    }
+    /**
+    *   \brief 返回 環形區域 大小
+    */
+    inline std::size_t capacity()const
+    {
+        return _capacity;
+    }
+    /**
+    *   \brief 返回 流中 待讀字節數
+    */
+    inline std::size_t size()const
+    {
+        return _size;
+    }
+    /**
+    *   \brief 返回 連續的 待讀數據 起始地址
+    */
+    inline const byte_t* begin()const
+    {
+        return _base + _offset;
+    }
+    /**
+    *   \brief 清空流中的 數據
+    */
+    inline void reset(bool /*clearcache*/ = true)
+    {
+        _offset = _size = 0;
+    }
+
+    /**
+    *   \brief 向流中 寫入數據
+    *
+    *   如果 發生任何 錯誤 將 不寫入 數據 並返回 0
+    *   \return 實際寫入長度
+    */
+    std::size_t write(const byte_t* bytes,const std::size_t n)
+    {
+        if(!n || !reserve(n))
+        {
+            return 0;
+        }
+        memcpy(end(),bytes,n);
+        _size += n;
+        return n;
+    }
+    /**
+    *   \brief 將緩衝區 copy 到指定內存 返回實際 copy數據長 被copy的數據 不會從 緩衝區中 刪除
+    */
+    inline std::size_t copy_to(byte_t* bytes,std::size_t n)const
+    {
+        return copy_to(0,bytes,n);
+    }
+    /**
+    *   \brief 忽略 前skip個字節 將緩衝區 copy 到指定內存 返回實際 copy數據長
+    */
+    std::size_t copy_to(std::size_t skip,byte_t* bytes,std::size_t n)const
+    {
+        if(skip >= _size)
+        {
+            return 0;
+        }
+        if(n > _size - skip)
+        {
+            n = _size - skip;
+        }
+        memcpy(bytes,begin() + skip,n);
+        return n;
+    }
+    /**
+    *   \brief 查找 失敗時 返回的 位置
+    */
+    static const std::size_t npos = (std::size_t)-1;
+    /**
+    *   \brief 從 第 skip 個 待讀字節 開始 查找 字節 b
+    *   \return 返回 b 相對 流頭的 偏移 找不到 返回 npos
+    */
+    std::size_t find(const byte_t b,std::size_t skip = 0)const
+    {
+        if(skip >= _size)
+        {
+            return npos;
+        }
+        const byte_t* found = find_byte(begin() + skip,_size - skip,b);
+        return found ? (std::size_t)(found - begin()) : npos;
+    }
+    /**
+    *   \brief 從 第 skip 個 待讀字節 開始 查找 [pattern,pattern+m) 可讀區域 連續 所以 不需要 處理 邊界
+    *   \return 返回 模式 相對 流頭的 偏移 找不到 返回 npos
+    */
+    std::size_t find(const byte_t* pattern,const std::size_t m,std::size_t skip = 0)const
+    {
+        if(skip > _size)
+        {
+            return npos;
+        }
+        const byte_t* found = find_pattern(begin() + skip,_size - skip,pattern,m);
+        return found ? (std::size_t)(found - begin()) : npos;
+    }
+    /**
+    *   \brief 查找 以 0 結尾的 字符串 pattern
+    */
+    inline std::size_t find(const char* pattern,std::size_t skip = 0)const
+    {
+        return find((const byte_t*)pattern,strlen(pattern),skip);
+    }
+    /**
+    *   \brief 從流中 讀取數據 被讀取的數據 將被刪除
+    */
+    std::size_t read(byte_t* bytes,std::size_t n)
+    {
+        n = copy_to(0,bytes,n);
+        consume(n);
+        return n;
+    }
+    /**
+    *   \brief 從流中 讀取 n 字節 到 切片 被讀取的數據 將被刪除
+    *
+    *   切片 直接 引用 環形區域 不持有 數據 只在 下次 修改緩衝區 前有效\n
+    *   需要保存時 應該 調用 slice_t::to_bytes 拷貝
+    *
+    *   \return 成功返回 n 數據不足 返回 0
+    */
+    std::size_t read(std::size_t n,slice_t& slice)
+    {
+        if(!n || n > _size)
+        {
+            return 0;
+        }
+        slice = slice_t(NULL,begin(),n);
+        consume(n);
+        return n;
+    }
+    /**
+    *   \brief 將 可讀區域 前 n 字節 追加到 buffers 可讀區域 總是 連續的
+    */
+    std::size_t data(const_buffers_t& buffers,std::size_t n = (std::size_t)-1)const
+    {
+        if(n > _size)
+        {
+            n = _size;
+        }
+        if(n)
+        {
+            buffers.push_back(boost::asio::const_buffer(begin(),n));
+        }
+        return n;
+    }
+    /**
+    *   \brief 忽略 前skip個字節 將 可讀區域 n 字節 追加到 buffers
+    */
+    std::size_t data(const_buffers_t& buffers,std::size_t skip,std::size_t n)const
+    {
+        if(skip >= _size)
+        {
+            return 0;
+        }
+        if(n > _size - skip)
+        {
+            n = _size - skip;
+        }
+        if(n)
+        {
+            buffers.push_back(boost::asio::const_buffer(begin() + skip,n));
+        }
+        return n;
+    }
+    /**
+    *   \brief 從流中 刪除 前 n 字節 數據
+    */
+    std::size_t consume(std::size_t n)
+    {
+        if(n > _size)
+        {
+            n = _size;
+        }
+        _size -= n;
+        if(_size)
+        {
+            _offset = (_offset + n) % _capacity;
+        }
+        else
+        {
+            //空時 回到 起點
+            _offset = 0;
+        }
+        return n;
+    }
+    /**
+    *   \brief 返回 流尾 n 字節 連續的 可寫區域 數據 寫入後 調用 commit
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t prepare(std::size_t n,mutable_buffers_t& buffers)
+    {
+        if(!reserve(n))
+        {
+            return 0;
+        }
+        buffers[0] = boost::asio::mutable_buffer(end(),n);
+        buffers[1] = boost::asio::mutable_buffer();
+        return n;
+    }
+    /**
+    *   \brief 將 prepare 返回區域的 前 n 字節 加入 可讀區域
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t commit(std::size_t n)
+    {
+        if(n > _capacity - _size)
+        {
+            return 0;
+        }
+        _size += n;
+        return n;
+    }
+protected:
+    /**
+    *   \brief 返回 可寫區域 起始地址
+    */
+    inline byte_t* end()
+    {
+        return _base + _offset + _size;
+    }
+    /**
+    *   \brief 確保 至少 有 n 字節 可寫區域 必要時 擴大 環形區域
+    */
+    bool reserve(std::size_t n)
+    {
+        if(!_base)
+        {
+            return false;
+        }
+        if(_capacity - _size >= n)
+        {
+            return true;
+        }
+
+        std::size_t capacity = _capacity * 2;
+        if(capacity < _size + n)
+        {
+            capacity = _size + n;
+        }
+        byte_t* base = NULL;
+        handle_t mapping = 0;
+        if(!map(capacity,base,capacity,mapping))
+        {
+            return false;
+        }
+        memcpy(base,begin(),_size);
+        unmap(_base,_capacity,_mapping);
+        _mapping = mapping;
+        _base = base;
+        _capacity = capacity;
+        _offset = 0;
+        return true;
+    }
+#ifdef _WIN32
+    /**
+    *   \brief 映射 環形區域
+    */
+    static bool map(std::size_t capacity,byte_t*& base,std::size_t& size,handle_t& mapping)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        std::size_t granularity = info.dwAllocationGranularity;
+        capacity = (capacity + granularity - 1) / granularity * granularity;
+        if(!capacity)
+        {
+            capacity = granularity;
+        }
+
+        HANDLE h = CreateFileMapping(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE,(DWORD)((k0::uint64_t)capacity >> 32),(DWORD)capacity,NULL);
+        if(!h)
+        {
+            return false;
+        }
+        //找到 一段 空閒地址 後 釋放 再映射 兩次 其它線程 可能搶佔 所以 需要重試
+        for(int i=0;i<16;++i)
+        {
+            void* p = VirtualAlloc(NULL,capacity * 2,MEM_RESERVE,PAGE_NOACCESS);
+            if(!p)
+            {
+                break;
+            }
+            VirtualFree(p,0,MEM_RELEASE);
+
+            void* p0 = MapViewOfFileEx(h,FILE_MAP_ALL_ACCESS,0,0,capacity,p);
+            if(!p0)
+            {
+                continue;
+            }
+            void* p1 = MapViewOfFileEx(h,FILE_MAP_ALL_ACCESS,0,0,capacity,(byte_t*)p + capacity);
+            if(!p1)
+            {
+                UnmapViewOfFile(p0);
+                continue;
+            }
+            base = (byte_t*)p0;
+            size = capacity;
+            mapping = h;
+            return true;
+        }
+        CloseHandle(h);
+        return false;
+    }
+    /**
+    *   \brief 釋放 環形區域
+    */
+    static void unmap(byte_t* base,std::size_t capacity,handle_t mapping)
+    {
+        if(base)
+        {
+            UnmapViewOfFile(base);
+            UnmapViewOfFile(base + capacity);
+        }
+        if(mapping)
+        {
+            CloseHandle(mapping);
+        }
+    }
+#else
+    /**
+    *   \brief 創建 匿名的 共享內存 文件
+    */
+    static int create_file()
+    {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        int fd = memfd_create("k0_mirror_ring",MFD_CLOEXEC);
+        if(fd != -1)
+        {
+            return fd;
+        }
+#endif
+        char name[] = "/tmp/k0_mirror_ring_XXXXXX";
+        int fd0 = mkstemp(name);
+        if(fd0 != -1)
+        {
+            unlink(name);
+        }
+        return fd0;
+    }
+    /**
+    *   \brief 映射 環形區域
+    */
+    static bool map(std::size_t capacity,byte_t*& base,std::size_t& size,handle_t&)
+    {
+        std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+        capacity = (capacity + page - 1) / page * page;
+        if(!capacity)
+        {
+            capacity = page;
+        }
+
+        int fd = create_file();
+        if(fd == -1)
+        {
+            return false;
+        }
+        if(ftruncate(fd,(off_t)capacity))
+        {
+            close(fd);
+            return false;
+        }
+        //保留 兩倍 地址空間 再 將文件 映射 兩次 覆蓋
+        void* p = mmap(NULL,capacity * 2,PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+        if(p == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        if(mmap(p,capacity,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0) == MAP_FAILED
+            || mmap((byte_t*)p + capacity,capacity,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0) == MAP_FAILED)
+        {
+            munmap(p,capacity * 2);
+            close(fd);
+            return false;
+        }
+        //映射 會保持 文件 引用
+        close(fd);
+
+        base = (byte_t*)p;
+        size = capacity;
+        return true;
+    }
+    /**
+    *   \brief 釋放 環形區域
+    */
+    static void unmap(byte_t* base,std::size_t capacity,handle_t)
+    {
+        if(base)
+        {
+            munmap(base,capacity * 2);
+        }
+    }
+#endif
+};
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_MIRROR
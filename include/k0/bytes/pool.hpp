@@ -0,0 +1,489 @@
+//線程緩存的 分級 內存池
+#ifndef KING_LIB_HEADER_BYTES_POOL
+#define KING_LIB_HEADER_BYTES_POOL
+
+#include "../core.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/tss.hpp>
+
+/**
+*	\brief 最小 分級 (1<<4 = 16 字節)
+*/
+#ifndef KING_BYTES_POOL_MIN_SHIFT
+#define KING_BYTES_POOL_MIN_SHIFT   4
+#endif
+/**
+*	\brief 最大 分級 (1<<16 = 64k) 超過的 內存 直接向系統申請
+*/
+#ifndef KING_BYTES_POOL_MAX_SHIFT
+#define KING_BYTES_POOL_MAX_SHIFT   16
+#endif
+/**
+*	\brief 每次 向系統 申請的 slab 大小
+*/
+#ifndef KING_BYTES_POOL_SLAB
+#define KING_BYTES_POOL_SLAB    (1024 * 64)
+#endif
+/**
+*	\brief 線程緩存 與 全局緩存 之間 每次 搬運的 最大塊數
+*/
+#ifndef KING_BYTES_POOL_BATCH
+#define KING_BYTES_POOL_BATCH   64
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+/**
+*	\brief 內存池 統計
+*
+*	各線程的 計數 是批量 合併到全局的 所以 只是一個 近似值
+*/
+struct pool_stats_t
+{
+    /**
+    *   \brief 從 線程緩存 直接 分配的次數
+    */
+    k0::uint64_t hits;
+    /**
+    *   \brief 線程緩存 爲空 需要 從全局 補充的次數
+    */
+    k0::uint64_t misses;
+    /**
+    *   \brief 向系統 申請 slab 的次數
+    */
+    k0::uint64_t slabs;
+    /**
+    *   \brief 超過 最大分級 直接向系統 申請的次數
+    */
+    k0::uint64_t larges;
+
+    /**
+    *   \brief 返回 線程緩存 命中率
+    */
+    inline double hit_rate()const
+    {
+        k0::uint64_t sum = hits + misses;
+        if(!sum)
+        {
+            return 0;
+        }
+        return (double)hits / (double)sum;
+    }
+};
+
+/**
+*	\brief 線程緩存的 分級 內存池
+*
+*	將 [1<<KING_BYTES_POOL_MIN_SHIFT,1<<KING_BYTES_POOL_MAX_SHIFT] 按 2的冪 分級\n
+*	每個線程 爲每個分級 維護一個 空閒鏈表 分配和釋放 都不需要加鎖\n
+*	線程緩存 爲空時 從全局鏈表 批量補充 過多時 批量歸還 線程退出時 全部歸還\n
+*	釋放時 必須 傳入 申請時的大小
+*/
+class pool_t
+{
+public:
+    /**
+    *   \brief 分級 數量
+    */
+    static const std::size_t classes = KING_BYTES_POOL_MAX_SHIFT - KING_BYTES_POOL_MIN_SHIFT + 1;
+    /**
+    *   \brief 最大 分級 大小
+    */
+    static const std::size_t max_size = (std::size_t)1 << KING_BYTES_POOL_MAX_SHIFT;
+protected:
+    /**
+    *   \brief 空閒塊
+    */
+    struct block_t
+    {
+        block_t* next;
+    };
+    /**
+    *   \brief 全局 空閒鏈表
+    */
+    struct central_t
+    {
+        boost::mutex mutex;
+        block_t* head;
+        std::size_t count;
+        central_t():head(NULL),count(0)
+        {
+        }
+    };
+    /**
+    *   \brief 線程緩存
+    */
+    struct cache_t
+    {
+        block_t* heads[classes];
+        std::size_t counts[classes];
+
+        k0::uint64_t hits;
+        k0::uint64_t misses;
+        std::size_t ops;
+        cache_t():hits(0),misses(0),ops(0)
+        {
+            for(std::size_t i=0;i<classes;++i)
+            {
+                heads[i] = NULL;
+                counts[i] = 0;
+            }
+        }
+    };
+
+    /**
+    *   \brief 全局 空閒鏈表
+    */
+    central_t _centrals[classes];
+    /**
+    *   \brief 線程緩存
+    */
+    boost::thread_specific_ptr<cache_t> _caches;
+
+    boost::atomic<k0::uint64_t> _hits;
+    boost::atomic<k0::uint64_t> _misses;
+    boost::atomic<k0::uint64_t> _slabs;
+    boost::atomic<k0::uint64_t> _larges;
+
+    pool_t():_caches(&pool_t::cleanup),_hits(0),_misses(0),_slabs(0),_larges(0)
+    {
+    }
+private:
+    pool_t(const pool_t&);
+    pool_t& operator=(const pool_t&);
+
+    static pool_t*& single()
+    {
+        static pool_t* p = NULL;
+        return p;
+    }
+    static void create()
+    {
+        //永不釋放 避免 與線程緩存 的析構順序 問題
+        single() = new pool_t();
+    }
+    /**
+    *   \brief 線程退出 歸還 線程緩存
+    */
+    static void cleanup(cache_t* cache)
+    {
+        pool_t& pool = instance();
+        for(std::size_t i=0;i<classes;++i)
+        {
+            if(cache->counts[i])
+            {
+                pool.release(i,cache,cache->counts[i]);
+            }
+        }
+        pool.merge(cache);
+        delete cache;
+    }
+public:
+    /**
+    *   \brief 返回 進程 唯一的 內存池
+    */
+    static pool_t& instance()
+    {
+        static boost::once_flag flag = BOOST_ONCE_INIT;
+        boost::call_once(&pool_t::create,flag);
+        return *single();
+    }
+    /**
+    *   \brief 返回 大小 n 所在分級
+    */
+    static inline std::size_t index(std::size_t n)
+    {
+        std::size_t i = 0;
+        std::size_t size = (std::size_t)1 << KING_BYTES_POOL_MIN_SHIFT;
+        while(size < n)
+        {
+            size <<= 1;
+            ++i;
+        }
+        return i;
+    }
+    /**
+    *   \brief 返回 申請 n 字節時 實際 可用的大小
+    */
+    static inline std::size_t round(std::size_t n)
+    {
+        if(n > max_size)
+        {
+            return n;
+        }
+        return (std::size_t)1 << (index(n) + KING_BYTES_POOL_MIN_SHIFT);
+    }
+    /**
+    *   \brief 分配 n 字節 內存
+    *   \exception std::bad_alloc
+    */
+    void* malloc(std::size_t n)
+    {
+        if(n > max_size)
+        {
+            _larges.fetch_add(1,boost::memory_order_relaxed);
+            void* p = std::malloc(n);
+            if(!p)
+            {
+                throw std::bad_alloc();
+            }
+            return p;
+        }
+
+        std::size_t i = index(n);
+        cache_t* cache = get_cache();
+        block_t* b = cache->heads[i];
+        if(b)
+        {
+            ++cache->hits;
+        }
+        else
+        {
+            ++cache->misses;
+            fetch(i,cache);
+            b = cache->heads[i];
+        }
+        cache->heads[i] = b->next;
+        --cache->counts[i];
+
+        if(++cache->ops == 4096)
+        {
+            merge(cache);
+        }
+        return b;
+    }
+    /**
+    *   \brief 釋放 malloc 返回的內存
+    *   \param p malloc 返回的 指針
+    *   \param n 申請時的 大小
+    */
+    void free(void* p,std::size_t n)
+    {
+        if(!p)
+        {
+            return;
+        }
+        if(n > max_size)
+        {
+            std::free(p);
+            return;
+        }
+
+        std::size_t i = index(n);
+        cache_t* cache = get_cache();
+        block_t* b = (block_t*)p;
+        b->next = cache->heads[i];
+        cache->heads[i] = b;
+        if(++cache->counts[i] >= batch(i) * 2)
+        {
+            release(i,cache,batch(i));
+        }
+    }
+    /**
+    *   \brief 返回 統計 數據
+    */
+    pool_stats_t stats()
+    {
+        merge(get_cache());
+
+        pool_stats_t s;
+        s.hits = _hits.load(boost::memory_order_relaxed);
+        s.misses = _misses.load(boost::memory_order_relaxed);
+        s.slabs = _slabs.load(boost::memory_order_relaxed);
+        s.larges = _larges.load(boost::memory_order_relaxed);
+        return s;
+    }
+protected:
+    /**
+    *   \brief 返回 分級 i 每次搬運的 塊數
+    */
+    static inline std::size_t batch(std::size_t i)
+    {
+        std::size_t n = KING_BYTES_POOL_SLAB >> (i + KING_BYTES_POOL_MIN_SHIFT);
+        if(n > KING_BYTES_POOL_BATCH)
+        {
+            return KING_BYTES_POOL_BATCH;
+        }
+        return n ? n : 1;
+    }
+    /**
+    *   \brief 返回 當前線程 緩存
+    */
+    inline cache_t* get_cache()
+    {
+        cache_t* cache = _caches.get();
+        if(!cache)
+        {
+            cache = new cache_t();
+            _caches.reset(cache);
+        }
+        return cache;
+    }
+    /**
+    *   \brief 合併 線程 統計
+    */
+    void merge(cache_t* cache)
+    {
+        _hits.fetch_add(cache->hits,boost::memory_order_relaxed);
+        _misses.fetch_add(cache->misses,boost::memory_order_relaxed);
+        cache->hits = cache->misses = 0;
+        cache->ops = 0;
+    }
+    /**
+    *   \brief 從 全局鏈表 補充 線程緩存
+    */
+    void fetch(std::size_t i,cache_t* cache)
+    {
+        central_t& central = _centrals[i];
+        std::size_t n = batch(i);
+        {
+            boost::mutex::scoped_lock lock(central.mutex);
+            if(!central.head)
+            {
+                slab(i,central);
+            }
+            while(n && central.head)
+            {
+                block_t* b = central.head;
+                central.head = b->next;
+                --central.count;
+
+                b->next = cache->heads[i];
+                cache->heads[i] = b;
+                ++cache->counts[i];
+                --n;
+            }
+        }
+    }
+    /**
+    *   \brief 將 線程緩存 中的 n 個塊 歸還 全局鏈表
+    */
+    void release(std::size_t i,cache_t* cache,std::size_t n)
+    {
+        block_t* head = cache->heads[i];
+        block_t* tail = head;
+        for(std::size_t j=1;j<n;++j)
+        {
+            tail = tail->next;
+        }
+        cache->heads[i] = tail->next;
+        cache->counts[i] -= n;
+
+        central_t& central = _centrals[i];
+        boost::mutex::scoped_lock lock(central.mutex);
+        tail->next = central.head;
+        central.head = head;
+        central.count += n;
+    }
+    /**
+    *   \brief 向系統 申請一個 slab 切分後 放入 全局鏈表 (需要持有 central.mutex)
+    *   \exception std::bad_alloc
+    */
+    void slab(std::size_t i,central_t& central)
+    {
+        std::size_t size = (std::size_t)1 << (i + KING_BYTES_POOL_MIN_SHIFT);
+        std::size_t n = KING_BYTES_POOL_SLAB / size;
+        if(!n)
+        {
+            n = 1;
+        }
+        byte_t* p = (byte_t*)std::malloc(size * n);
+        if(!p)
+        {
+            throw std::bad_alloc();
+        }
+        _slabs.fetch_add(1,boost::memory_order_relaxed);
+
+        for(std::size_t j=0;j<n;++j)
+        {
+            block_t* b = (block_t*)(p + j * size);
+            b->next = central.head;
+            central.head = b;
+        }
+        central.count += n;
+    }
+};
+
+/**
+*	\brief 從 pool_t 分配內存的 分配器
+*
+*	可用於 boost::allocate_shared 使 智能指針 的控制塊 也從 內存池 分配
+*/
+template<typename T>
+class pool_allocator_t
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef pool_allocator_t<U> other;
+    };
+
+    pool_allocator_t()
+    {
+    }
+    template<typename U>
+    pool_allocator_t(const pool_allocator_t<U>&)
+    {
+    }
+
+    inline pointer address(reference r)const
+    {
+        return &r;
+    }
+    inline const_pointer address(const_reference r)const
+    {
+        return &r;
+    }
+    inline pointer allocate(size_type n,const void* = 0)
+    {
+        return (pointer)pool_t::instance().malloc(n * sizeof(T));
+    }
+    inline void deallocate(pointer p,size_type n)
+    {
+        pool_t::instance().free(p,n * sizeof(T));
+    }
+    inline size_type max_size()const
+    {
+        return ((size_type)-1) / sizeof(T);
+    }
+    inline void construct(pointer p,const T& v)
+    {
+        new((void*)p) T(v);
+    }
+    inline void destroy(pointer p)
+    {
+        p->~T();
+    }
+};
+template<typename T,typename U>
+inline bool operator==(const pool_allocator_t<T>&,const pool_allocator_t<U>&)
+{
+    return true;
+}
+template<typename T,typename U>
+inline bool operator!=(const pool_allocator_t<T>&,const pool_allocator_t<U>&)
+{
+    return false;
+}
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_POOL
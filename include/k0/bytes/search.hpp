@@ -0,0 +1,272 @@
+//字節 和 模式 查找
+#ifndef KING_LIB_HEADER_BYTES_SEARCH
+#define KING_LIB_HEADER_BYTES_SEARCH
+
+#include "../core.hpp"
+#include "../cpu.hpp"
+
+#include <cstring>
+
+#if defined(KING_CPU_X86)
+#include <emmintrin.h>
+#if defined(KING_CPU_AVX2)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+	/**
+	*	\brief 字節 查找函數
+	*/
+	typedef const k0::byte_t* (*find_byte_ft)(const k0::byte_t*,std::size_t,k0::byte_t);
+	/**
+	*	\brief 模式 查找函數
+	*/
+	typedef const k0::byte_t* (*find_pattern_ft)(const k0::byte_t*,std::size_t,const k0::byte_t*,std::size_t);
+
+	/**
+	*	\brief 在 [p,p+n) 中 查找 b
+	*	\return 返回 首個 b 的地址 找不到 返回 NULL
+	*/
+	inline const k0::byte_t* find_byte_scalar(const k0::byte_t* p,std::size_t n,k0::byte_t b)
+	{
+		return (const k0::byte_t*)memchr(p,b,n);
+	}
+	/**
+	*	\brief 在 [p,p+n) 中 查找 [pattern,pattern+m)
+	*	\return 返回 首個 匹配的地址 找不到 返回 NULL
+	*/
+	inline const k0::byte_t* find_pattern_scalar(const k0::byte_t* p,std::size_t n,const k0::byte_t* pattern,std::size_t m)
+	{
+		if(!m)
+		{
+			return p;
+		}
+		if(m > n)
+		{
+			return NULL;
+		}
+		const k0::byte_t* last = p + n - m;
+		while(p <= last)
+		{
+			p = (const k0::byte_t*)memchr(p,pattern[0],last - p + 1);
+			if(!p)
+			{
+				return NULL;
+			}
+			if(!memcmp(p,pattern,m))
+			{
+				return p;
+			}
+			++p;
+		}
+		return NULL;
+	}
+
+#if defined(KING_CPU_X86)
+	/**
+	*	\brief find_byte_scalar 的 sse2 實現
+	*/
+	KING_CPU_TARGET("sse2")
+	inline const k0::byte_t* find_byte_sse2(const k0::byte_t* p,std::size_t n,k0::byte_t b)
+	{
+		const k0::byte_t* end = p + n;
+		const __m128i v = _mm_set1_epi8((char)b);
+		for(;end - p >= 64;p += 64)
+		{
+			__m128i x0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p),v);
+			__m128i x1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 16)),v);
+			__m128i x2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 32)),v);
+			__m128i x3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 48)),v);
+			if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(x0,x1),_mm_or_si128(x2,x3))))
+			{
+				break;
+			}
+		}
+		for(;end - p >= 16;p += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)p);
+			k0::uint32_t mask = (k0::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x,v));
+			if(mask)
+			{
+				return p + k0::cpu::ctz(mask);
+			}
+		}
+		return find_byte_scalar(p,end - p,b);
+	}
+	/**
+	*	\brief find_pattern_scalar 的 sse2 實現
+	*
+	*	同時 比較 模式的 首字節 和 尾字節 只對 兩者 都匹配的 位置 調用 memcmp
+	*/
+	KING_CPU_TARGET("sse2")
+	inline const k0::byte_t* find_pattern_sse2(const k0::byte_t* p,std::size_t n,const k0::byte_t* pattern,std::size_t m)
+	{
+		if(m < 2)
+		{
+			return m ? find_byte_sse2(p,n,pattern[0]) : p;
+		}
+		if(m > n)
+		{
+			return NULL;
+		}
+		const __m128i first = _mm_set1_epi8((char)pattern[0]);
+		const __m128i last = _mm_set1_epi8((char)pattern[m - 1]);
+		std::size_t i = 0;
+		for(;i + m - 1 + 16 <= n;i += 16)
+		{
+			__m128i bf = _mm_loadu_si128((const __m128i*)(p + i));
+			__m128i bl = _mm_loadu_si128((const __m128i*)(p + i + m - 1));
+			k0::uint32_t mask = (k0::uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf,first),_mm_cmpeq_epi8(bl,last)));
+			while(mask)
+			{
+				unsigned int bit = k0::cpu::ctz(mask);
+				if(!memcmp(p + i + bit + 1,pattern + 1,m - 2))
+				{
+					return p + i + bit;
+				}
+				mask &= mask - 1;
+			}
+		}
+		return find_pattern_scalar(p + i,n - i,pattern,m);
+	}
+#endif
+
+#if defined(KING_CPU_AVX2)
+	/**
+	*	\brief find_byte_scalar 的 avx2 實現
+	*/
+	KING_CPU_TARGET("avx2")
+	inline const k0::byte_t* find_byte_avx2(const k0::byte_t* p,std::size_t n,k0::byte_t b)
+	{
+		const k0::byte_t* end = p + n;
+		const __m256i v = _mm256_set1_epi8((char)b);
+		//每次 檢查 128 字節 找到後 再 確定 位置
+		for(;end - p >= 128;p += 128)
+		{
+			__m256i x0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p),v);
+			__m256i x1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 32)),v);
+			__m256i x2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 64)),v);
+			__m256i x3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 96)),v);
+			if(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(x0,x1),_mm256_or_si256(x2,x3))))
+			{
+				break;
+			}
+		}
+		for(;end - p >= 32;p += 32)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i*)p);
+			k0::uint32_t mask = (k0::uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,v));
+			if(mask)
+			{
+				return p + k0::cpu::ctz(mask);
+			}
+		}
+		return find_byte_sse2(p,end - p,b);
+	}
+	/**
+	*	\brief find_pattern_scalar 的 avx2 實現
+	*/
+	KING_CPU_TARGET("avx2")
+	inline const k0::byte_t* find_pattern_avx2(const k0::byte_t* p,std::size_t n,const k0::byte_t* pattern,std::size_t m)
+	{
+		if(m < 2)
+		{
+			return m ? find_byte_avx2(p,n,pattern[0]) : p;
+		}
+		if(m > n)
+		{
+			return NULL;
+		}
+		const __m256i first = _mm256_set1_epi8((char)pattern[0]);
+		const __m256i last = _mm256_set1_epi8((char)pattern[m - 1]);
+		std::size_t i = 0;
+		for(;i + m - 1 + 32 <= n;i += 32)
+		{
+			__m256i bf = _mm256_loadu_si256((const __m256i*)(p + i));
+			__m256i bl = _mm256_loadu_si256((const __m256i*)(p + i + m - 1));
+			k0::uint32_t mask = (k0::uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(bf,first),_mm256_cmpeq_epi8(bl,last)));
+			while(mask)
+			{
+				unsigned int bit = k0::cpu::ctz(mask);
+				if(!memcmp(p + i + bit + 1,pattern + 1,m - 2))
+				{
+					return p + i + bit;
+				}
+				mask &= mask - 1;
+			}
+		}
+		return find_pattern_sse2(p + i,n - i,pattern,m);
+	}
+#endif
+
+	/**
+	*	\brief 返回 當前 cpu 可用的 最快 字節查找函數
+	*/
+	inline find_byte_ft find_byte_function()
+	{
+#if defined(__GLIBC__)
+		//glibc 的 memchr 已經 在運行時 選擇 simd 實現 且 更快 (見 test/bytes/bench_search 的 BM_ByteKernel)
+		//find_byte_sse2 find_byte_avx2 仍被 模式 內核 和 其它 c 庫 使用
+		return find_byte_scalar;
+#else
+#if defined(KING_CPU_AVX2)
+		if(k0::cpu::features().avx2)
+		{
+			return find_byte_avx2;
+		}
+#endif
+#if defined(KING_CPU_X86)
+		if(k0::cpu::features().sse2)
+		{
+			return find_byte_sse2;
+		}
+#endif
+		return find_byte_scalar;
+#endif
+	}
+	/**
+	*	\brief 返回 當前 cpu 可用的 最快 模式查找函數
+	*/
+	inline find_pattern_ft find_pattern_function()
+	{
+#if defined(KING_CPU_AVX2)
+		if(k0::cpu::features().avx2)
+		{
+			return find_pattern_avx2;
+		}
+#endif
+#if defined(KING_CPU_X86)
+		if(k0::cpu::features().sse2)
+		{
+			return find_pattern_sse2;
+		}
+#endif
+		return find_pattern_scalar;
+	}
+
+	/**
+	*	\brief 在 [p,p+n) 中 查找 b 運行時 選擇 avx2/sse2/標量 實現
+	*	\return 返回 首個 b 的地址 找不到 返回 NULL
+	*/
+	inline const k0::byte_t* find_byte(const k0::byte_t* p,std::size_t n,k0::byte_t b)
+	{
+		static const find_byte_ft f = find_byte_function();
+		return f(p,n,b);
+	}
+	/**
+	*	\brief 在 [p,p+n) 中 查找 [pattern,pattern+m) 運行時 選擇 avx2/sse2/標量 實現
+	*	\return 返回 首個 匹配的地址 找不到 返回 NULL
+	*/
+	inline const k0::byte_t* find_pattern(const k0::byte_t* p,std::size_t n,const k0::byte_t* pattern,std::size_t m)
+	{
+		static const find_pattern_ft f = find_pattern_function();
+		return f(p,n,pattern,m);
+	}
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_SEARCH
@@ -0,0 +1,120 @@
+//共享 數據塊 的 數據切片
+#ifndef KING_LIB_HEADER_BYTES_SLICE
+#define KING_LIB_HEADER_BYTES_SLICE
+
+#include "type.hpp"
+#include "chunk.hpp"
+
+#include <boost/intrusive_ptr.hpp>
+namespace k0
+{
+namespace bytes
+{
+
+/**
+*	\brief 數據切片
+*
+*	引用 chunk_t 中 的一段數據 並 共享 chunk_t 的所有權\n
+*	切片 可以 複製 和 跨線程 傳遞 數據 在 最後一個 切片 釋放前 一直有效\n
+*	不持有 數據塊的 切片 (如 mirror_ring_t 產生的) 只是 一個視圖 需要保存時 應調用 to_bytes
+*/
+class slice_t
+{
+protected:
+    typedef k0::byte_t byte_t;
+
+    /**
+	*	\brief 共享的 數據塊
+	*/
+    boost::intrusive_ptr<chunk_t> _chunk;
+    /**
+	*	\brief 數據 起始地址
+	*/
+    const byte_t* _data;
+    /**
+	*	\brief 數據 大小
+	*/
+    std::size_t _size;
+public:
+    /**
+	*	\brief 構造一個 空切片
+	*/
+    slice_t():_data(NULL),_size(0)
+    {
+    }
+    /**
+	*	\brief 構造一個 引用 c 中 [data,data+size) 的切片
+	*	\param add_ref 爲 false 時 接管 調用者 持有的 引用
+	*/
+    slice_t(chunk_t* c,const byte_t* data,const std::size_t size,bool add_ref = true)
+        :_chunk(c,add_ref),_data(data),_size(size)
+    {
+    }
+
+    /**
+	*	\brief 返回 切片 是否不為 空
+	*/
+    inline operator bool()const
+    {
+        return _size != 0;
+    }
+    /**
+	*	\brief 返回 切片 是否為 空
+	*/
+    inline bool empty()const
+    {
+        return _size == 0;
+    }
+    /**
+	*	\brief 返回 切片 是否 持有 數據塊
+	*/
+    inline bool owned()const
+    {
+        return _chunk.get() != NULL;
+    }
+    /**
+	*	\brief 返回 數據 起始地址
+	*/
+    inline const byte_t* get()const
+    {
+        return _data;
+    }
+    /**
+	*	\brief 返回 數據 大小
+	*/
+    inline std::size_t size()const
+    {
+        return _size;
+    }
+    /**
+	*	\brief 釋放 引用 此後 切片爲空
+	*/
+    inline void reset()
+    {
+        _chunk.reset();
+        _data = NULL;
+        _size = 0;
+    }
+    /**
+	*	\brief 將 切片 拷貝到 新的 字節數組
+	*	\exception std::bad_alloc
+	*/
+    bytes_spt to_bytes()const
+    {
+        bytes_spt b = make_bytes(_size);
+        if(_size)
+        {
+            if(b->size() != _size)
+            {
+                throw std::bad_alloc();
+            }
+            memcpy(b->get(),_data,_size);
+        }
+        return b;
+    }
+};
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_SLICE
@@ -0,0 +1,414 @@
+//緩衝區 溢出到 磁盤的 臨時文件
+#ifndef KING_LIB_HEADER_BYTES_SPILL
+#define KING_LIB_HEADER_BYTES_SPILL
+
+#include "../core.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+*	\brief 溢出文件 每次 最少 擴大的 字節數 不超過此大小的 文件 讀空後 會被保留 以便 重複利用
+*/
+#ifndef KING_BYTES_SPILL_GROW
+#define KING_BYTES_SPILL_GROW (1024 * 1024)
+#endif
+
+namespace k0
+{
+namespace bytes
+{
+
+/**
+*   \brief 只追加的 臨時文件 映射到 內存 讀取
+*
+*   數據 總是 寫入 文件尾 從 文件頭 讀取 文件 被讀空後 從頭 重新寫入\n
+*   文件尾 空間不足 而 已讀的 前綴 不小於 待讀數據 時 將 待讀數據 移到 文件頭 持續 有 積壓 時 文件 大小 也 有界\n
+*   文件 在 第一次 寫入時 創建 創建後 立刻 刪除 (windows 下 關閉時 刪除) 進程 退出後 不會 殘留\n
+*   begin/prepare 返回的 地址 在 下次 寫入 前有效
+*/
+class spill_file_t
+{
+public:
+	/**
+    *    \brief 字節定義
+    */
+    typedef k0::byte_t byte_t;
+protected:
+#ifdef _WIN32
+    typedef HANDLE handle_t;
+#else
+    typedef int handle_t;
+#endif
+    /**
+    *   \brief 臨時文件 所在 目錄
+    */
+    std::string _dir;
+    /**
+    *   \brief 文件 句柄
+    */
+    handle_t _file;
+#ifdef _WIN32
+    /**
+    *   \brief 映射 句柄
+    */
+    handle_t _mapping;
+#endif
+    /**
+    *   \brief 映射 起始地址
+    */
+    byte_t* _base;
+    /**
+    *   \brief 文件 和 映射 大小
+    */
+    std::size_t _capacity;
+    /**
+    *   \brief 首個 待讀字節 偏移
+    */
+    std::size_t _begin;
+    /**
+    *   \brief 寫入 偏移
+    */
+    std::size_t _end;
+public:
+    /**
+    *   \brief 構造一個 溢出文件
+    *   \param dir 臨時文件 所在目錄 應該 在 磁盤上 (而非 tmpfs) 爲 NULL 時 使用 系統臨時目錄
+    */
+    explicit spill_file_t(const char* dir = NULL)
+        :_dir(dir ? dir : ""),_base(NULL),_capacity(0),_begin(0),_end(0)
+    {
+#ifdef _WIN32
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = NULL;
+#else
+        _file = -1;
+#endif
+    }
+    ~spill_file_t()
+    {
+        close();
+    }
+private:
+	spill_file_t& operator=(const spill_file_t&);
+    spill_file_t(const spill_file_t&);
+public:
+    /**
+    *   \brief 返回 待讀 字節數
+    */
+    inline std::size_t size()const
+    {
+        return _end - _begin;
+    }
+    /**
+    *   \brief 返回 文件 大小
+    */
+    inline std::size_t capacity()const
+    {
+        return _capacity;
+    }
+    /**
+    *   \brief 返回 連續的 待讀數據 起始地址
+    */
+    inline const byte_t* begin()const
+    {
+        return _base + _begin;
+    }
+    /**
+    *   \brief 在 文件尾 寫入數據
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t write(const byte_t* bytes,const std::size_t n)
+    {
+        byte_t* p = prepare(n);
+        if(!p)
+        {
+            return 0;
+        }
+        memcpy(p,bytes,n);
+        _end += n;
+        return n;
+    }
+    /**
+    *   \brief 返回 文件尾 n 字節 連續的 可寫區域 數據 寫入後 調用 commit
+    *   \return 失敗返回 NULL
+    */
+    byte_t* prepare(const std::size_t n)
+    {
+        if(!n || !reserve(n))
+        {
+            return NULL;
+        }
+        return _base + _end;
+    }
+    /**
+    *   \brief 將 prepare 返回區域的 前 n 字節 加入 可讀區域
+    *   \return 成功返回 n 失敗返回 0
+    */
+    std::size_t commit(const std::size_t n)
+    {
+        if(n > _capacity - _end)
+        {
+            return 0;
+        }
+        _end += n;
+        return n;
+    }
+    /**
+    *   \brief 忽略 前skip個字節 拷貝數據 被拷貝的 數據 不會被刪除
+    *   \return 實際拷貝大小
+    */
+    std::size_t copy_to(const std::size_t skip,byte_t* bytes,std::size_t n)const
+    {
+        if(skip >= size())
+        {
+            return 0;
+        }
+        if(n > size() - skip)
+        {
+            n = size() - skip;
+        }
+        memcpy(bytes,begin() + skip,n);
+        return n;
+    }
+    /**
+    *   \brief 讀取數據 被讀取的數據 將被刪除
+    *   \return 實際讀取大小
+    */
+    std::size_t read(byte_t* bytes,std::size_t n)
+    {
+        n = copy_to(0,bytes,n);
+        consume(n);
+        return n;
+    }
+    /**
+    *   \brief 刪除 前 n 字節 數據
+    *
+    *   讀空後 從頭 寫入 超過 KING_BYTES_SPILL_GROW 的文件 會被 刪除 以 歸還 磁盤空間
+    *
+    *   \return 實際 刪除 長度
+    */
+    std::size_t consume(std::size_t n)
+    {
+        if(n > size())
+        {
+            n = size();
+        }
+        _begin += n;
+        if(_begin == _end)
+        {
+            if(_capacity > KING_BYTES_SPILL_GROW)
+            {
+                close();
+            }
+            _begin = _end = 0;
+        }
+        return n;
+    }
+    /**
+    *   \brief 刪除 所有數據 並 關閉 文件
+    */
+    void reset()
+    {
+        close();
+    }
+protected:
+    /**
+    *   \brief 確保 文件尾 至少 有 n 字節 可寫區域 必要時 壓縮 或 擴大 文件
+    *
+    *   只在 已讀前綴 不小於 待讀數據 時 壓縮 每個 字節 被 移動的 次數 均攤 不超過 1 次
+    */
+    bool reserve(const std::size_t n)
+    {
+        if(_capacity - _end >= n)
+        {
+            return true;
+        }
+        std::size_t size = _end - _begin;
+        if(_begin && _begin >= size && _capacity - size >= n)
+        {
+            memmove(_base,_base + _begin,size);
+            _begin = 0;
+            _end = size;
+            return true;
+        }
+        if(!open())
+        {
+            return false;
+        }
+        std::size_t capacity = _capacity * 2;
+        if(capacity < _end + n)
+        {
+            capacity = _end + n;
+        }
+        if(capacity < KING_BYTES_SPILL_GROW)
+        {
+            capacity = KING_BYTES_SPILL_GROW;
+        }
+        return remap(capacity);
+    }
+#ifdef _WIN32
+    /**
+    *   \brief 創建 臨時文件
+    */
+    bool open()
+    {
+        if(_file != INVALID_HANDLE_VALUE)
+        {
+            return true;
+        }
+        char dir[MAX_PATH];
+        if(_dir.empty())
+        {
+            DWORD n = GetTempPathA(MAX_PATH,dir);
+            if(!n || n > MAX_PATH)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            strncpy(dir,_dir.c_str(),MAX_PATH - 1);
+            dir[MAX_PATH - 1] = 0;
+        }
+        char name[MAX_PATH];
+        if(!GetTempFileNameA(dir,"k0s",0,name))
+        {
+            return false;
+        }
+        _file = CreateFileA(name,GENERIC_READ | GENERIC_WRITE,0,NULL,CREATE_ALWAYS,FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,NULL);
+        return _file != INVALID_HANDLE_VALUE;
+    }
+    /**
+    *   \brief 擴大 文件 並 重新映射 數據 在文件中 不需要 拷貝
+    */
+    bool remap(const std::size_t capacity)
+    {
+        HANDLE mapping = CreateFileMapping(_file,NULL,PAGE_READWRITE,(DWORD)((k0::uint64_t)capacity >> 32),(DWORD)capacity,NULL);
+        if(!mapping)
+        {
+            return false;
+        }
+        void* p = MapViewOfFile(mapping,FILE_MAP_ALL_ACCESS,0,0,capacity);
+        if(!p)
+        {
+            CloseHandle(mapping);
+            return false;
+        }
+        if(_base)
+        {
+            UnmapViewOfFile(_base);
+        }
+        if(_mapping)
+        {
+            CloseHandle(_mapping);
+        }
+        _mapping = mapping;
+        _base = (byte_t*)p;
+        _capacity = capacity;
+        return true;
+    }
+    /**
+    *   \brief 關閉 文件
+    */
+    void close()
+    {
+        if(_base)
+        {
+            UnmapViewOfFile(_base);
+            _base = NULL;
+        }
+        if(_mapping)
+        {
+            CloseHandle(_mapping);
+            _mapping = NULL;
+        }
+        if(_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(_file);
+            _file = INVALID_HANDLE_VALUE;
+        }
+        _capacity = _begin = _end = 0;
+    }
+#else
+    /**
+    *   \brief 創建 臨時文件
+    */
+    bool open()
+    {
+        if(_file != -1)
+        {
+            return true;
+        }
+        std::string name = _dir;
+        if(name.empty())
+        {
+            const char* dir = getenv("TMPDIR");
+            //tmpfs 在 內存中 默認 使用 /var/tmp
+            name = dir && dir[0] ? dir : "/var/tmp";
+        }
+        name += "/k0_spill_XXXXXX";
+        _file = mkstemp(&name[0]);
+        if(_file == -1)
+        {
+            return false;
+        }
+        unlink(name.c_str());
+        return true;
+    }
+    /**
+    *   \brief 擴大 文件 並 重新映射 數據 在文件中 不需要 拷貝
+    */
+    bool remap(const std::size_t capacity)
+    {
+        if(ftruncate(_file,(off_t)capacity))
+        {
+            return false;
+        }
+        void* p = mmap(NULL,capacity,PROT_READ | PROT_WRITE,MAP_SHARED,_file,0);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        if(_base)
+        {
+            munmap(_base,_capacity);
+        }
+        _base = (byte_t*)p;
+        _capacity = capacity;
+        return true;
+    }
+    /**
+    *   \brief 關閉 文件
+    */
+    void close()
+    {
+        if(_base)
+        {
+            munmap(_base,_capacity);
+            _base = NULL;
+        }
+        if(_file != -1)
+        {
+            ::close(_file);
+            _file = -1;
+        }
+        _capacity = _begin = _end = 0;
+    }
+#endif
+};
+
+};
+};
+
+#endif // KING_LIB_HEADER_BYTES_SPILL
@@ -3,7 +3,18 @@
 #define KING_LIB_HEADER_BYTES_TYPE
 
 #include "../core.hpp"
+#include "pool.hpp"
+
+#include <cstring>
 #include <boost/smart_ptr.hpp>
+
+/**
+*	\brief make_bytes 使用 內聯存儲 的 最大 數組大小
+*/
+#ifndef KING_BYTES_SMALL_SIZE
+#define KING_BYTES_SMALL_SIZE 64
+#endif
+
 namespace k0
 {
 
@@ -16,7 +27,8 @@ namespace bytes
 *	\brief 字節數組
 *
 *	k0::byte_t 的字節數組\n
-*	保存類數組 長度
+*	保存類數組 長度\n
+*	數組 從 pool_t 分配
 */
 class bytes_t
 {
@@ -29,47 +41,94 @@ public:
 	*	\param size 數組大小
 	*/
     explicit bytes_t(const std::size_t size)//no throw
+		:_bytes(NULL),_size(0),_owned(true)
     {
+		if(!size)
+		{
+			return;
+		}
 		try
 		{
-			_bytes = new byte_t[size];
+			_bytes = (byte_t*)pool_t::instance().malloc(size);
 			_size = size;
 		}
 		catch(const std::bad_alloc&)
 		{
-			_size = 0;
 		}
     }
     /**
 	*	\brief move 語義
+	*
+	*	m 的數據 在 內聯存儲 中時 (small_bytes_t) 無法轉移 會 拷貝到 新分配的 數組
 	*/
     bytes_t(bytes_t&& m)
+		:_bytes(NULL),_size(0),_owned(true)
     {
-        _bytes = m._bytes;
-        _size = m._size;
-
-        m._bytes = NULL;
-        m._size = 0;
+        move(m);
     }
     /**
 	*	\brief move 語義
 	*/
     bytes_t& operator=(bytes_t&& m)
     {
-        if(_bytes)
+        if(this != &m)
         {
-            delete[] _bytes;
+            reset();
+            move(m);
         }
-
-        _bytes = m._bytes;
-        _size = m._size;
-
-        m._bytes = NULL;
-        m._size = 0;
-
         return *this;
     }
+protected:
+    /**
+	*	\brief 供 small_bytes_t 使用 size 不超過 capacity 時 使用 bytes 指向的 內聯存儲
+	*/
+    bytes_t(byte_t* bytes,const std::size_t capacity,const std::size_t size)//no throw
+		:_bytes(NULL),_size(0),_owned(true)
+    {
+		if(!size)
+		{
+			return;
+		}
+		if(size <= capacity)
+		{
+			_bytes = bytes;
+			_size = size;
+			_owned = false;
+			return;
+		}
+		try
+		{
+			_bytes = (byte_t*)pool_t::instance().malloc(size);
+			_size = size;
+		}
+		catch(const std::bad_alloc&)
+		{
+		}
+    }
 private:
+    void move(bytes_t& m)
+    {
+        if(m._owned)
+        {
+            _bytes = m._bytes;
+            _size = m._size;
+        }
+        else if(m._size)
+        {
+            try
+            {
+                _bytes = (byte_t*)pool_t::instance().malloc(m._size);
+                memcpy(_bytes,m._bytes,m._size);
+                _size = m._size;
+            }
+            catch(const std::bad_alloc&)
+            {
+            }
+        }
+        m._bytes = NULL;
+        m._size = 0;
+        m._owned = true;
+    }
     bytes_t& operator=(const bytes_t&);
     bytes_t(const bytes_t&);
 public:
@@ -78,9 +137,9 @@ public:
 	*/
 	virtual ~bytes_t()
     {
-        if(_bytes)
+        if(_bytes && _owned)
         {
-            delete[] _bytes;
+            pool_t::instance().free(_bytes,_size);
         }
     }
     /**
@@ -136,16 +195,88 @@ public:
     {
         if(_bytes)
         {
-            delete[] _bytes;
+            if(_owned)
+            {
+                pool_t::instance().free(_bytes,_size);
+            }
             _bytes = NULL;
             _size = 0;
+            _owned = true;
         }
     }
 private:
     byte_t* _bytes;
     std::size_t _size;
+    /**
+	*	\brief _bytes 是否 由 pool_t 分配 (否則 指向 派生類的 內聯存儲)
+	*/
+    bool _owned;
+};
+
+/**
+*	\brief 帶 內聯存儲的 字節數組
+*
+*	大小 不超過 S 時 數據 保存在 對象內部 不需要 另外分配\n
+*	超過 S 時 與 bytes_t 相同 從 pool_t 分配
+*
+*	\param S 內聯存儲 大小
+*/
+template<std::size_t S = KING_BYTES_SMALL_SIZE>
+class small_bytes_t:public bytes_t
+{
+public:
+    /**
+	*	\brief 構造一個 字節數組
+	*
+	*	\param size 數組大小
+	*/
+    explicit small_bytes_t(const std::size_t size)//no throw
+        :bytes_t(_storage,S,size)
+    {
+    }
+private:
+    small_bytes_t& operator=(const small_bytes_t&);
+    small_bytes_t(const small_bytes_t&);
+
+    byte_t _storage[S];
 };
 
+/**
+*	\brief 字節數組 智能指針
+*/
+typedef boost::shared_ptr<bytes_t> bytes_spt;
+
+/**
+*	\brief 創建一個 使用 S 字節 內聯存儲的 字節數組
+*
+*	size 不超過 S 時 數組 和 智能指針的 控制塊 只需要 一次 從 pool_t 分配
+*
+*	\param size 數組大小
+*	\exception std::bad_alloc
+*/
+template<std::size_t S>
+inline bytes_spt make_small_bytes(const std::size_t size)
+{
+	return boost::allocate_shared<small_bytes_t<S> >(pool_allocator_t<small_bytes_t<S> >(),size);
+}
+/**
+*	\brief 創建一個 字節數組
+*
+*	數組 和 智能指針的 控制塊 都從 pool_t 分配\n
+*	size 不超過 KING_BYTES_SMALL_SIZE 時 使用 small_bytes_t 只需要 一次分配
+*
+*	\param size 數組大小
+*	\exception std::bad_alloc
+*/
+inline bytes_spt make_bytes(const std::size_t size)
+{
+	if(size && size <= KING_BYTES_SMALL_SIZE)
+	{
+		return make_small_bytes<KING_BYTES_SMALL_SIZE>(size);
+	}
+	return boost::allocate_shared<bytes_t>(pool_allocator_t<bytes_t>(),size);
+}
+
 
 
 /**
@@ -189,7 +320,7 @@ public:
     {
 		try
 		{
-		   _array = boost::make_shared<bytes_t>(size);
+		   _array = make_bytes(size);
 		   _capacity = size;
 		}
 		catch(const std::bad_alloc&)
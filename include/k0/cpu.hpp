@@ -0,0 +1,113 @@
+//cpu 特性 檢測
+#ifndef KING_LIB_HEADER_CPU
+#define KING_LIB_HEADER_CPU
+
+#include "core.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+*	\brief 編譯目標 爲 x86/x64 時 定義
+*/
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KING_CPU_X86
+#endif
+
+/**
+*	\brief 編譯器 支持 在運行時 選擇 avx2 指令 時 定義
+*/
+#if defined(KING_CPU_X86) && !defined(KING_CPU_NO_AVX2)
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800)
+#define KING_CPU_AVX2
+#endif
+#endif
+
+/**
+*	\brief 編譯器 支持 在運行時 選擇 sse4.2 指令 時 定義
+*/
+#if defined(KING_CPU_X86) && !defined(KING_CPU_NO_SSE42)
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__) || defined(_MSC_VER)
+#define KING_CPU_SSE42
+#endif
+#endif
+
+/**
+*	\brief 標記 函數 使用 指定指令集 編譯 (msvc 不需要)
+*/
+#if defined(__GNUC__) || defined(__clang__)
+#define KING_CPU_TARGET(x) __attribute__((target(x)))
+#else
+#define KING_CPU_TARGET(x)
+#endif
+
+namespace k0
+{
+/**
+*	\brief cpu 相關
+*/
+namespace cpu
+{
+	/**
+	*	\brief cpu 支持的 指令集
+	*/
+	struct features_t
+	{
+		bool sse2;
+		bool sse42;
+		bool avx2;
+
+		features_t():sse2(false),sse42(false),avx2(false)
+		{
+#if defined(KING_CPU_X86)
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info,0);
+			int ids = info[0];
+			__cpuid(info,1);
+			sse2 = (info[3] & (1 << 26)) != 0;
+			sse42 = (info[2] & (1 << 20)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			if(ids >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+			{
+				__cpuidex(info,7,0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			sse2 = __builtin_cpu_supports("sse2") != 0;
+			sse42 = __builtin_cpu_supports("sse4.2") != 0;
+			avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+		}
+	};
+
+	/**
+	*	\brief 返回 當前 cpu 支持的 指令集
+	*/
+	inline const features_t& features()
+	{
+		static const features_t f;
+		return f;
+	}
+
+	/**
+	*	\brief 返回 x 最低位 1 的 索引 (x 不能爲0)
+	*/
+	inline unsigned int ctz(k0::uint32_t x)
+	{
+#if defined(_MSC_VER)
+		unsigned long i;
+		_BitScanForward(&i,x);
+		return (unsigned int)i;
+#else
+		return (unsigned int)__builtin_ctz(x);
+#endif
+	}
+};
+};
+
+#endif // KING_LIB_HEADER_CPU
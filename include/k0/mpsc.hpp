@@ -0,0 +1,122 @@
+//無鎖 多生產者 單消費者 侵入式 隊列
+#ifndef KING_LIB_HEADER_MPSC
+#define KING_LIB_HEADER_MPSC
+
+#include "core.hpp"
+
+#include <boost/atomic.hpp>
+
+namespace k0
+{
+	/**
+	*	\brief mpsc_queue_t 的 節點 元素 需要 派生自此 class
+	*/
+	class mpsc_node_t
+	{
+	public:
+		/**
+		*	\brief 下一個 節點 (不要操作此屬性)
+		*/
+		boost::atomic<mpsc_node_t*> _next;
+
+		mpsc_node_t():_next((mpsc_node_t*)NULL)
+		{
+		}
+	private:
+		mpsc_node_t(const mpsc_node_t&);
+		mpsc_node_t& operator=(const mpsc_node_t&);
+	};
+
+	/**
+	*	\brief 侵入式 多生產者 單消費者 隊列 (Vyukov)
+	*
+	*	push 可以 在 任意 線程 併發調用 只需要 一次 原子交換 不會 分配內存\n
+	*	pop 同一時刻 只能 有一個 線程 調用\n
+	*	某個 push 執行到一半 (已交換 尾部 還未 鏈接) 時 pop 會 返回 NULL 即使 其後 還有 已完成的 push
+	*	此時 消費者 應該 稍後 重試\n
+	*	隊列 不擁有 節點 析構前 應該 pop 出 所有節點 自行釋放
+	*
+	*	\param T 節點 型別 派生自 mpsc_node_t
+	*/
+	template<typename T>
+	class mpsc_queue_t
+	{
+	protected:
+		/**
+		*	\brief 最後 push 的 節點 (生產者 使用)
+		*/
+		boost::atomic<mpsc_node_t*> _head;
+		/**
+		*	\brief 下一個 pop 的 節點 (消費者 使用)
+		*/
+		mpsc_node_t* _tail;
+		/**
+		*	\brief 哨兵 節點 隊列 總是 至少 有一個 節點
+		*/
+		mpsc_node_t _stub;
+	public:
+		mpsc_queue_t():_head(&_stub),_tail(&_stub)
+		{
+		}
+	private:
+		mpsc_queue_t(const mpsc_queue_t&);
+		mpsc_queue_t& operator=(const mpsc_queue_t&);
+	public:
+		/**
+		*	\brief 在 隊列尾 加入 節點 (線程安全)
+		*/
+		void push(T* node)
+		{
+			push_node(node);
+		}
+		/**
+		*	\brief 從 隊列頭 取出 節點 (只能由 單個 消費者 調用)
+		*	\return 隊列 爲空 或 下個節點 還未鏈接 時 返回 NULL
+		*/
+		T* pop()
+		{
+			mpsc_node_t* tail = _tail;
+			mpsc_node_t* next = tail->_next.load(boost::memory_order_acquire);
+			if(tail == &_stub)
+			{
+				if(!next)
+				{
+					return NULL;
+				}
+				_tail = next;
+				tail = next;
+				next = next->_next.load(boost::memory_order_acquire);
+			}
+			if(next)
+			{
+				_tail = next;
+				return static_cast<T*>(tail);
+			}
+
+			if(tail != _head.load(boost::memory_order_acquire))
+			{
+				//生產者 還未 完成 鏈接
+				return NULL;
+			}
+
+			//tail 是 最後一個 節點 放回 哨兵 以便 取出 tail
+			push_node(&_stub);
+			next = tail->_next.load(boost::memory_order_acquire);
+			if(next)
+			{
+				_tail = next;
+				return static_cast<T*>(tail);
+			}
+			return NULL;
+		}
+	protected:
+		void push_node(mpsc_node_t* node)
+		{
+			node->_next.store(NULL,boost::memory_order_relaxed);
+			mpsc_node_t* prev = _head.exchange(node,boost::memory_order_acq_rel);
+			prev->_next.store(node,boost::memory_order_release);
+		}
+	};
+};
+
+#endif // KING_LIB_HEADER_MPSC
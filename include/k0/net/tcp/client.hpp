@@ -3,10 +3,14 @@
 
 #include "type.hpp"
 #include "exception.hpp"
+#include "thread_config.hpp"
+#include "io_pool.hpp"
+#include "timer_heap.hpp"
 
 
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 
 
 
@@ -18,6 +22,10 @@ namespace tcp
 {
 	/**
 	*	\brief 使用 boost asio 完成的一個 客戶端
+	*
+	*	默認 擁有 自己的 io_service 和 工作線程\n
+	*	也可以 附加到 外部的 io_pool_t 大量 client 共享 少數 線程 回調 不變
+	*
 	*	\param T 與 socket 綁定 的一個 自定義結構
 	*	\param N recv 緩衝區大小
 	*/
@@ -28,17 +36,20 @@ namespace tcp
     	/**
 		*	\brief socket 定義
 		*/
-        typedef socket_t<T> socket_t;
+        typedef tcp::socket_t<T> socket_t;
 		/**
 		*	\brief socket 智能指針
 		*/
         typedef boost::shared_ptr<socket_t> socket_spt;
 	protected:
-		
+		/**
+		*	\brief 自己 擁有的 asio 服務 附加到 io_pool_t 時 爲空
+		*/
+		boost::scoped_ptr<io_service_t> _owned;
         /**
 		*	\brief asio 服務
 		*/
-        io_service_t _io_s;
+        io_service_t& _io_s;
 		
 		/**
 		*	\brief 與服務器的連接 socket
@@ -49,9 +60,27 @@ namespace tcp
 		*	\brief 工作 線程
 		*/
         boost::thread_group _threads;
+		/**
+		*	\brief 工作線程 配置
+		*/
+		thread_config_t _config;
+		/**
+		*	\brief 已投遞 還未 返回的 異步回調 數量 附加到 io_pool_t 時 析構 需要 等待 其歸0
+		*/
+		boost::atomic<std::size_t> _handlers;
+		/**
+		*	\brief 已經 開始 析構 回調 不再 通知 用戶
+		*/
+		boost::atomic<bool> _closed;
+		/**
+		*	\brief schedule_after schedule_every 的 定時器
+		*/
+		timer_heap_t _timers;
+
 	private:
-        void work_thread()
+        void work_thread(const std::size_t i)
         {
+			_config.apply(i);
             _io_s.run();
         }
     public:
@@ -66,10 +95,47 @@ namespace tcp
 		/**
 		*	\brief 構造 client 並連接到指定 地址
 		*	\param addr 形如 dns:port 的服務器 地址
+		*	\param config 工作線程 配置 默認 一個 線程
+		*	\param start 是否 立刻 開始 recv 子類 覆蓋 on_recv 時 應該 傳入 false 並在 構造 完成後 調用 start 否則 回調 可能 在 子類 構造 完成 前 執行
+		*	\return throw k0::net::bad_address k0::net::tcp::exception
+		*/
+        explicit client_t(const std::string& addr,const thread_config_t& config=thread_config_t(),bool start=true)
+			:_owned(new io_service_t()),_io_s(*_owned),_config(config),_handlers(0),_closed(false),_timers(_io_s)
+        {
+			connect(addr);
+			if(start)
+			{
+				client_t::start();
+			}
+        }
+		/**
+		*	\brief 構造 client 並連接到指定 地址 使用 pool 中的 一個 事件循環 不創建 線程
+		*
+		*	pool 必須 比 client 後 停止 和 銷毀\n
+		*	析構 會 等待 已投遞的 回調 返回 所以 不能在 pool 的 線程中 (例如 回調中) 銷毀 client
+		*
+		*	\param addr 形如 dns:port 的服務器 地址
+		*	\param pool 事件循環 池 輪詢 選擇 其中 一個
+		*	\param start 同 上
 		*	\return throw k0::net::bad_address k0::net::tcp::exception
 		*/
-        explicit client_t(const std::string& addr)
+        client_t(const std::string& addr,io_pool_t& pool,bool start=true)
+			:_io_s(pool.next()),_handlers(0),_closed(false),_timers(_io_s)
         {
+			connect(addr);
+			if(start)
+			{
+				client_t::start();
+			}
+        }
+	private:
+        client_t& operator=(const client_t&);
+        client_t(const client_t&);
+		/**
+		*	\brief 連接 服務器
+		*/
+		void connect(const std::string& addr)
+		{
 			//驗證 地址
 			std::string::size_type find = addr.find_last_of(':');
 			if(find == std::string::npos)
@@ -111,45 +177,58 @@ namespace tcp
 			{
 				KING_NET_TCP_THROW(e);
 			}
-			
+            _socket = s;
+		}
+	public:
+		/**
+		*	\brief 投遞 第一個 recv 擁有 io_service 時 並 啓動 工作線程
+		*
+		*	回調 可能 立刻 在 其它線程 執行 所以 必須 在 對象 完整構造 之後 調用 只能 調用一次\n
+		*	構造 時 start 爲 false 的 子類 在 自己的 構造函數 最後 調用
+		*
+		*	\return throw k0::net::tcp::exception
+		*/
+		void start()
+		{
             //創建 recv 緩衝區
             bytes_spt buf;
 			try
 			{
-			   buf = boost::make_shared<k0::bytes::bytes_t>(N);
+			   buf = k0::bytes::make_bytes(N);
 			}
 			catch(const std::bad_alloc& e)
 			{
 				KING_NET_TCP_THROW(e);
 			}
-            _socket = s;
 
-			
             //異步 recv
 			post_recv(buf);
 
-
+			if(!_owned)
+			{
+				return;
+			}
 			//啓動工作線程
 			try
 			{
-				_threads.add_thread(new boost::thread(boost::bind(&client_t::work_thread,this)));
+				std::size_t count = _config.count(1);
+				for(std::size_t i=0;i<count;++i)
+				{
+					_threads.add_thread(new boost::thread(boost::bind(&client_t::work_thread,this,i)));
+				}
 			}
 			catch(const std::bad_alloc& e)
 			{
 				KING_NET_TCP_THROW(e);
 			}
-        }
-	private:
-        client_t& operator=(const client_t&);
-        client_t(const client_t&);
+		}
 	public:
 		/**
 		*	\brief 析構 關閉連接 釋放資源
 		*/
         virtual ~client_t()
         {
-            _io_s.stop();
-            _threads.join_all();
+			release();
         }
 		/**
 		*	\brief 子類實現 當和服務器斷開前回調
@@ -180,6 +259,7 @@ namespace tcp
 		*/
         inline void post_recv(bytes_spt buffer)
         {
+			_handlers.fetch_add(1,boost::memory_order_relaxed);
             _socket->socket().async_read_some(boost::asio::buffer(buffer->get(),buffer->size()),
                 boost::bind(&client_t::post_recv_handler,
                 this,
@@ -193,18 +273,15 @@ namespace tcp
 		*/
         void post_recv_handler(const boost::system::error_code& e,bytes_spt buffer,std::size_t n)
         {
+			handler_guard_t guard(_handlers);
+			if(_closed)
+			{
+				return;
+			}
 			if(e)
 			{
-                //通知 用戶
-                on_close();
-                
-
                 //錯誤 斷開 連接
-                if(_socket->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    _socket->socket().close(e0);
-                }
+				post_recv_close();
                 return;
             }
 		    
@@ -212,22 +289,31 @@ namespace tcp
 			if(!on_recv(buffer->get(),n))
 			{
 				//協議錯誤 直接斷開連接
-
-				//通知 用戶
-                on_close();
-
-				//錯誤 斷開
-                if(_socket->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    _socket->socket().close(e0);
-                }
+				post_recv_close();
 				return;
 			}
 			
             //投遞 新的 recv
             post_recv(buffer);
         }
+		/**
+		*	\brief recv 失敗 通知用戶 並 斷開連接
+		*
+		*	socket 只在 recv 處理器 關閉 多個 工作線程 時 send 處理器 可能 同時 在 其它線程 使用 socket
+		*/
+		void post_recv_close()
+		{
+			if(!_socket->mark_closed())
+			{
+				return;
+			}
+
+			//通知 用戶
+			on_close();
+
+			boost::system::error_code e0;
+			_socket->socket().close(e0);
+		}
     public:
   
 		/**
@@ -237,6 +323,30 @@ namespace tcp
         {
             return _threads.size();
         }
+		/**
+		*	\brief 在 delay 毫秒 之後 於 工作線程 中 執行 fn
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_after(const std::size_t delay,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers.schedule(delay,0,fn);
+		}
+		/**
+		*	\brief 每 period 毫秒 於 工作線程 中 執行一次 fn 直到 cancel_timer 或 client 析構
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_every(const std::size_t period,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers.schedule(period,period,fn);
+		}
+		/**
+		*	\brief 取消 schedule_after schedule_every 創建的 定時器
+		*	\return 定時器 不存在 或 已經 執行 返回 false
+		*/
+		bool cancel_timer(const timer_id_t id)
+		{
+			return _timers.cancel(id);
+		}
 		/**
 		*	\brief 等待 線程 停止 工作
 		*/
@@ -250,7 +360,7 @@ namespace tcp
 		*/
         bool push_send(const byte_t* bytes,std::size_t n)
         {
-            if(!_socket->socket().is_open())
+            if(_socket->closed())
             {
                 return false;
             }
@@ -259,14 +369,19 @@ namespace tcp
             bytes_spt buffer;
             try
             {
-                buffer = boost::make_shared<k0::bytes::bytes_t>(n);
+                buffer = k0::bytes::make_bytes(n);
             }
             catch(const std::bad_alloc&)
             {
                 //創建 失敗
                 return false;
             }
-            //copy 待write 數據
+            if(buffer->size() != n)
+            {
+                //數組 分配 失敗
+                return false;
+            }
+            //copy 待write 數據 小數據 保存在 small_bytes_t 的 內聯存儲 中
             std::copy(bytes,bytes+n,buffer->get());
 
             return push_send(buffer);
@@ -277,106 +392,155 @@ namespace tcp
         bool push_send(bytes_spt buffer)
         {
 			socket_spt& s = _socket;
-            if(!s->socket().is_open())
+            if(s->closed())
             {
                 return false;
             }
 
-            boost::mutex::scoped_lock lock(s->_mutex);
-            std::list<bytes_spt>& datas = s->_datas;
-            bool& wait = s->_wait;
-
-            //等待 上次 write 完成 直接 push
-            if(wait)
-            {
-                datas.push_back(buffer);
-                return true;
-            }
-            else
+            try
             {
-                //需要 發送 數據
-
-                if(datas.empty())
-                {
-                    //直接 write
-                    post_send(buffer);
-                    wait = true;
-                    return true;
-                }
-                else
+                if(s->push_send(buffer))
                 {
-                    try
-                    {
-                        //寫入 隊列
-                        datas.push_back(buffer);
-
-                        //發送 隊列 首數據
-                        buffer = datas.front();
-                        datas.pop_front();
-                        post_send(buffer);
-                        wait = true;
-                        return true;
-                    }
-                    catch(const std::bad_alloc&)
-                    {
-                        return false;
-                    }
-
+                    //沒有 write 在進行 由 當前線程 開始 write
+                    send_next();
                 }
-
             }
-            return false;
+            catch(const std::bad_alloc&)
+            {
+                return false;
+            }
+            return true;
         }
     protected:
 		/**
-		*	\brief 異步發送數據
+		*	\brief 異步 發送 s->_batch 中 還未 寫出的 數據
+		*
+		*	多條 數據 合併爲 一個 buffer 序列 一次 gather write\n
+		*	可能 在 用戶線程 調用 socket 已經 關閉 時 停止 write
 		*/
-        inline void post_send(bytes_spt buffer)
+        inline void post_send()
         {
-            _socket->socket().async_write_some(boost::asio::buffer(buffer->get(),buffer->size()),
+			socket_spt& s = _socket;
+			if(!s->enter_open())
+			{
+				return;
+			}
+			_handlers.fetch_add(1,boost::memory_order_relaxed);
+            s->socket().async_write_some(s->send_buffers(),
                 boost::bind(&client_t::post_send_handler,
                 this,
                 boost::asio::placeholders::error,
-                buffer
+                boost::asio::placeholders::bytes_transferred
                 )
             );
+			s->leave_open();
         }
-		/**
-		*	\brief 發送處理器
+        /**
+		*	\brief 發送 處理器
 		*/
-        void post_send_handler(const boost::system::error_code& e,bytes_spt buffer)
+		void post_send_handler(const boost::system::error_code& e,std::size_t n)
         {
+			handler_guard_t guard(_handlers);
 			socket_spt& s = _socket;
+            if(_closed)
+            {
+				return;
+            }
             if(e)
             {
-                //send 錯誤 直接 關閉
-                if(s->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    s->socket().close(e0);
-                }
+                //send 錯誤 只 shutdown 正在進行的 recv 收到 錯誤 後 由 recv 處理器 關閉
+				if(s->enter_open())
+				{
+					boost::system::error_code e0;
+					s->socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both,e0);
+					s->leave_open();
+				}
                 return;
             }
 
-            //通知 客戶
-            on_send(buffer);
+			if(!s->written(n))
+			{
+				//只寫出了 部分 數據 繼續 寫出 剩餘部分
+				post_send();
+				return;
+			}
 
+			//通知 客戶 每條 數據 調用一次 on_send
+			std::vector<bytes_spt>& batch = s->_batch;
+			n = batch.size();
+			for(std::size_t i=0;i<n;++i)
+			{
+				on_send(batch[i]);
+			}
+			batch.clear();
 
-            boost::mutex::scoped_lock lock(s->_mutex);
-            std::list<bytes_spt>& datas = s->_datas;
-            if(datas.empty())
+            if(s->sent(n))
             {
-                //可以接受 發送 數據 
-                s->_wait = false;
-                return;
+                //繼續 發送 數據
+                send_next();
             }
-            //繼續 發送 數據
-            buffer = datas.front();
-            datas.pop_front();
-            post_send(buffer);
-
         }
-		
+		/**
+		*	\brief 取出 隊列中 已有的 數據 (受 KING_NET_TCP_SEND_BUFFERS 和 KING_NET_TCP_SEND_BUDGET 限制) 並 write
+		*
+		*	只在 負責 write 時 調用 有 生產者 還未 完成 入隊 時 投遞到 io 線程 稍後 重試
+		*/
+		void send_next()
+		{
+			socket_spt& s = _socket;
+			if(s->pop_sends())
+			{
+				post_send();
+				return;
+			}
+			_handlers.fetch_add(1,boost::memory_order_relaxed);
+			s->io_service().post(boost::bind(&client_t::send_next_handler,this));
+		}
+		void send_next_handler()
+		{
+			handler_guard_t guard(_handlers);
+			if(!_closed)
+			{
+				send_next();
+			}
+		}
+		void close_handler()
+		{
+			handler_guard_t guard(_handlers);
+			if(_socket && _socket->mark_closed())
+			{
+				boost::system::error_code e;
+				_socket->socket().close(e);
+			}
+		}
+		/**
+		*	\brief 停止 回調 可以 重複調用 子類 析構時 應該 先 調用
+		*
+		*	擁有 io_service 時 停止 並 等待 工作線程\n
+		*	附加到 io_pool_t 時 在 事件循環 中 關閉 socket 並 等待 已投遞的 回調 返回
+		*/
+		void release()
+		{
+			if(_closed.exchange(true))
+			{
+				return;
+			}
+			if(_owned)
+			{
+				_io_s.stop();
+				_threads.join_all();
+				return;
+			}
+			//等待 正在執行的 定時器 回調
+			_timers.close();
+			_handlers.fetch_add(1,boost::memory_order_relaxed);
+			_io_s.post(boost::bind(&client_t::close_handler,this));
+			while(_handlers.load(boost::memory_order_acquire))
+			{
+				boost::this_thread::yield();
+			}
+		}
+
     };
 
 
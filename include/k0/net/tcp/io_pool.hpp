@@ -0,0 +1,157 @@
+//每個 核心 一個 io_service 的 事件循環 池
+#ifndef KING_LIB_HEADER_NET_TCP_IO_POOL
+#define KING_LIB_HEADER_NET_TCP_IO_POOL
+
+#include "type.hpp"
+#include "thread_config.hpp"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+namespace k0
+{
+namespace net
+{
+namespace tcp
+{
+	/**
+	*	\brief 多個 獨立的 事件循環
+	*
+	*	每個 io_service 只由 一個 線程 運行 線程 按 thread_config_t 配置 (默認 綁定到 一個 cpu)\n
+	*	綁定到 某個 io_service 的 socket 其所有 回調 都在 同一個 線程 執行 不會 跨線程 切換\n
+	*	沒有 異步操作 時 線程 也不會 退出 直到 stop
+	*/
+	class io_pool_t
+	{
+	protected:
+		/**
+		*	\brief 事件循環
+		*/
+		std::vector<io_service_t*> _services;
+		/**
+		*	\brief 保持 io_service 在 沒有 異步操作 時 繼續 運行
+		*/
+		std::vector<io_service_t::work*> _works;
+		/**
+		*	\brief 每個 事件循環 一個 線程
+		*/
+		boost::thread_group _threads;
+		/**
+		*	\brief 輪詢 分配 下標
+		*/
+		boost::atomic<std::size_t> _next;
+		/**
+		*	\brief 線程 配置
+		*/
+		thread_config_t _config;
+	public:
+		/**
+		*	\brief 創建 config.threads 個 事件循環 並 啓動 線程
+		*	\param config 線程 配置 threads 爲0 時 使用 cpu 核心數
+		*	\exception std::bad_alloc boost::thread_resource_error
+		*/
+		explicit io_pool_t(const thread_config_t& config = thread_config_t::pinned())
+			:_next(0),_config(config)
+		{
+			std::size_t n = config.count(boost::thread::hardware_concurrency());
+			if(!n)
+			{
+				n = 1;
+			}
+			try
+			{
+				_services.reserve(n);
+				_works.reserve(n);
+				for(std::size_t i=0;i<n;++i)
+				{
+					_services.push_back(new io_service_t(1));
+					_works.push_back(new io_service_t::work(*_services.back()));
+				}
+				for(std::size_t i=0;i<n;++i)
+				{
+					_threads.add_thread(new boost::thread(boost::bind(&io_pool_t::work_thread,this,i)));
+				}
+			}
+			catch(...)
+			{
+				release();
+				throw;
+			}
+		}
+		/**
+		*	\brief 停止 所有 事件循環 並 等待 線程 退出
+		*/
+		virtual ~io_pool_t()
+		{
+			release();
+		}
+	private:
+		io_pool_t(const io_pool_t&);
+		io_pool_t& operator=(const io_pool_t&);
+	public:
+		/**
+		*	\brief 返回 事件循環 數量
+		*/
+		inline std::size_t size()const
+		{
+			return _services.size();
+		}
+		/**
+		*	\brief 返回 第 i 個 事件循環
+		*/
+		inline io_service_t& get(const std::size_t i)
+		{
+			return *_services[i];
+		}
+		/**
+		*	\brief 輪詢 返回 下一個 事件循環
+		*/
+		inline io_service_t& next()
+		{
+			return *_services[_next.fetch_add(1,boost::memory_order_relaxed) % _services.size()];
+		}
+		/**
+		*	\brief 停止 所有 事件循環
+		*/
+		void stop()
+		{
+			for(std::size_t i=0;i<_services.size();++i)
+			{
+				_services[i]->stop();
+			}
+		}
+		/**
+		*	\brief 等待 線程 退出
+		*/
+		inline void join()
+		{
+			_threads.join_all();
+		}
+	protected:
+		void work_thread(const std::size_t i)
+		{
+			_config.apply(i);
+			_services[i]->run();
+		}
+		void release()
+		{
+			stop();
+			join();
+			for(std::size_t i=0;i<_works.size();++i)
+			{
+				delete _works[i];
+			}
+			_works.clear();
+			for(std::size_t i=0;i<_services.size();++i)
+			{
+				delete _services[i];
+			}
+			_services.clear();
+		}
+	};
+};
+};
+};
+
+#endif // KING_LIB_HEADER_NET_TCP_IO_POOL
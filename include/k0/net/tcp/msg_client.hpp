@@ -6,6 +6,9 @@
 #include "msg_reader.hpp"
 #include "client.hpp"
 
+#include <k0/bytes/codec.hpp>
+#include <k0/bytes/crc32c.hpp>
+
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
@@ -44,6 +47,18 @@ namespace tcp
 		*	\brief 消息頭 緩存
 		*/
 		byte_t* _header;
+		/**
+		*	\brief 消息後 是否 帶有 crc32c 校驗 可以 在 任意線程 修改
+		*/
+		boost::atomic<bool> _checksum;
+		/**
+		*	\brief 當前消息 是否 帶有 crc32c 校驗 在 消息 開始 時 確定
+		*/
+		bool _msg_checksum;
+		/**
+		*	\brief 當前消息 已到達部分的 crc32c
+		*/
+		k0::bytes::crc32c_stream_t _crc;
 
 		/**
 		*	\brief 包頭解析函數
@@ -52,14 +67,14 @@ namespace tcp
 		*/
         typedef boost::function<std::size_t(const byte_t*,std::size_t)> reader_header_bft;
 		/**
-		*	\brief 默認 包頭解析函數
+		*	\brief 默認 包頭解析函數 包頭 爲 4 字節 小端 消息長度
 		*	\param b 消息頭 緩衝區
 		*	\param n 緩衝區大小
 		*	\return	成功返回 消息長度 失敗返回 KING_NET_TCP_ERROR_MSG
 		*/
 		static std::size_t reader_header(const byte_t* b,std::size_t n)
 		{
-			std::size_t size = (std::size_t)(*(k0::uint32_t*)b);
+			std::size_t size = (std::size_t)k0::bytes::get_le<k0::uint32_t>(b);
 			if(size > KING_NET_TCP_MAX_MSG_SIZE)
 			{
 				return KING_NET_TCP_ERROR_MSG;
@@ -74,10 +89,12 @@ namespace tcp
 		/**
 		*	\brief 構造 client 並連接到指定 地址
 		*	\param addr 形如 dns:port 的服務器 地址
+		*	\param config 工作線程 配置 見 client_t::client_t
+		*	\param start 是否 立刻 開始 recv 子類 覆蓋 on_msg 時 應該 傳入 false 並在 構造 完成後 調用 start
 		*	\return throw k0::net::bad_address k0::net::tcp::exception
 		*/
-        explicit msg_client_t(const std::string& addr,std::size_t header_size=4,reader_header_bft reader_header_bf=boost::bind(&msg_client_t::reader_header,_1,_2))
-			:client_t(addr),_header_size(header_size),_reader_header_bf(reader_header_bf),_buffer(N),_size(KING_NET_TCP_WAIT_MSG_HEADER),_header(NULL)
+        explicit msg_client_t(const std::string& addr,std::size_t header_size=4,reader_header_bft reader_header_bf=boost::bind(&msg_client_t::reader_header,_1,_2),const thread_config_t& config=thread_config_t(),bool start=true)
+			:client_t<T,N>(addr,config,false),_header_size(header_size),_reader_header_bf(reader_header_bf),_buffer(N),_size(KING_NET_TCP_WAIT_MSG_HEADER),_header(NULL),_checksum(false),_msg_checksum(false)
         {
 			try
 			{
@@ -87,21 +104,95 @@ namespace tcp
 			{
 				KING_NET_TCP_THROW(e);
 			}
+			//解包 狀態 就緒 之後 才 開始 recv
+			if(start)
+			{
+				this->start();
+			}
         }
 		virtual ~msg_client_t()
 		{
-			_io_s.stop();
-            _threads.join_all();
+			this->release();
 
 			if(_header)
 			{
-				delete _header;
+				delete[] _header;
 			}
 		}
+		/**
+		*	\brief 構造 client 並連接到指定 地址 附加到 pool 見 client_t::client_t
+		*	\param addr 形如 dns:port 的服務器 地址
+		*	\param pool 事件循環 池
+		*	\param start 同 上
+		*	\return throw k0::net::bad_address k0::net::tcp::exception
+		*/
+        msg_client_t(const std::string& addr,io_pool_t& pool,std::size_t header_size=4,reader_header_bft reader_header_bf=boost::bind(&msg_client_t::reader_header,_1,_2),bool start=true)
+			:client_t<T,N>(addr,pool,false),_header_size(header_size),_reader_header_bf(reader_header_bf),_buffer(N),_size(KING_NET_TCP_WAIT_MSG_HEADER),_header(NULL),_checksum(false),_msg_checksum(false)
+        {
+			try
+			{
+				_header = new byte_t[header_size];
+			}
+			catch(const std::bad_alloc& e)
+			{
+				KING_NET_TCP_THROW(e);
+			}
+			//解包 狀態 就緒 之後 才 開始 recv
+			if(start)
+			{
+				this->start();
+			}
+        }
 	private:
         msg_client_t& operator=(const msg_client_t&);
         msg_client_t(const msg_client_t&);
 	public:
+		/**
+		*	\brief 設置 每個消息後 是否 帶有 4 字節 小端 crc32c 校驗 格式 同 msg_server_t::checksum
+		*
+		*	可以 在 任意線程 調用 從 下一個 開始 到達的 消息 生效
+		*/
+		void checksum(bool ok)
+		{
+			_checksum.store(ok,boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 向 服務器 發送 一個 完整消息 (header + body) 開啓 checksum 時 追加 crc32c 校驗
+		*	\return 同 push_send
+		*/
+		bool push_msg(const byte_t* msg,std::size_t n)
+		{
+			return push_msg(msg,n,NULL,0);
+		}
+		/**
+		*	\brief 向 服務器 發送 分開 存放的 消息頭 和 消息體 開啓 checksum 時 追加 crc32c 校驗
+		*	\return 同 push_send
+		*/
+		bool push_msg(const byte_t* header,std::size_t header_size,const byte_t* body,std::size_t body_size)
+		{
+			bytes_spt buffer;
+			try
+			{
+				buffer = make_msg(header,header_size,body,body_size,_checksum.load(boost::memory_order_relaxed));
+			}
+			catch(const std::bad_alloc&)
+			{
+				return false;
+			}
+			return this->push_send(buffer);
+		}
+		/**
+		*	\brief 向 服務器 發送 一個 完整消息 沒有 開啓 checksum 時 直接 發送 msg 不會 複製
+		*	\return 同 push_send
+		*/
+		bool push_msg(bytes_spt msg)
+		{
+			if(!_checksum.load(boost::memory_order_relaxed))
+			{
+				return this->push_send(msg);
+			}
+			return push_msg(msg->get(),msg->size(),NULL,0);
+		}
 		/**
 		*	\brief 子類實現 當接收到 1個完整消息 時回調
 		*	\param msg 數據緩衝區
@@ -134,6 +225,15 @@ namespace tcp
 				//解析消息頭
 				if(KING_NET_TCP_WAIT_MSG_HEADER == _size)
 				{
+					//還沒有 計算 當前消息 時 確定 是否 帶有 校驗 之後 整個消息 不變
+					if(!_crc.hashed())
+					{
+						_msg_checksum = _checksum.load(boost::memory_order_relaxed);
+					}
+					if(_msg_checksum)
+					{
+						_crc.update(_buffer,_header_size);
+					}
 					if(size < _header_size)
 					{
 						//等待消息頭
@@ -157,14 +257,29 @@ namespace tcp
 				}
 
 				//獲取 body
-				if(_size < size)
+				std::size_t frame = _size;
+				if(_msg_checksum)
+				{
+					//計算 新到達的 字節
+					_crc.update(_buffer,_size);
+					frame += sizeof(k0::uint32_t);
+				}
+				if(size < frame)
 				{
 					//等待 body
 					return true;
 				}
+				if(_msg_checksum)
+				{
+					k0::uint32_t crc;
+					if(!k0::bytes::peek_le(_buffer,_size,crc) || crc != _crc.value())
+					{
+						return false;
+					}
+				}
 				try
 				{
-					bytes_spt buffer = boost::make_shared<k0::bytes::bytes_t>(_size);
+					bytes_spt buffer = k0::bytes::make_bytes(_size);
 					if(buffer->size() != _size)
 					{
 						return false;
@@ -179,6 +294,11 @@ namespace tcp
 					{
 						return false;
 					}
+					if(_msg_checksum)
+					{
+						_buffer.consume(sizeof(k0::uint32_t));
+						_crc.reset();
+					}
 					_size = KING_NET_TCP_WAIT_MSG_HEADER;
 				}
 				catch(const std::bad_alloc&)
@@ -3,8 +3,12 @@
 #define KING_LIB_HEADER_NET_TCP_MSG_READER
 
 #include <k0/bytes/buffer.hpp>
+#include <k0/bytes/codec.hpp>
+#include <k0/bytes/crc32c.hpp>
 #include <boost/function.hpp>
 
+#include <cstring>
+
 
 namespace k0
 {
@@ -84,6 +88,49 @@ namespace tcp
 
     };
 
+	/**
+	*	\brief 將 消息頭 和 消息體 複製到 一個 新的 發送緩衝區 checksum 爲 true 時 在後面 追加 4 字節 小端 crc32c
+	*
+	*	消息頭 中的 長度 不包含 校驗 格式 同 msg_server_t::checksum\n
+	*	crc 先 計算 消息頭 再 以 crc32c_extend 接着 計算 消息體 兩段 不需要 先 拼接
+	*
+	*	\exception std::bad_alloc
+	*/
+	inline k0::bytes::bytes_spt make_msg(const byte_t* header,const std::size_t header_size,const byte_t* body,const std::size_t body_size,const bool checksum)
+	{
+		std::size_t n = header_size + body_size;
+		std::size_t size = checksum ? n + sizeof(k0::uint32_t) : n;
+		k0::bytes::bytes_spt buffer = k0::bytes::make_bytes(size);
+		if(buffer->size() != size)
+		{
+			throw std::bad_alloc();
+		}
+		byte_t* p = buffer->get();
+		if(header_size)
+		{
+			memcpy(p,header,header_size);
+		}
+		if(body_size)
+		{
+			memcpy(p + header_size,body,body_size);
+		}
+		if(checksum)
+		{
+			k0::uint32_t crc = k0::bytes::crc32c(header,header_size);
+			crc = k0::bytes::crc32c_extend(crc,body,body_size);
+			k0::bytes::put_le<k0::uint32_t>(p + n,crc);
+		}
+		return buffer;
+	}
+	/**
+	*	\brief 將 一個 完整消息 (header + body) 複製到 新的 發送緩衝區 見 make_msg
+	*	\exception std::bad_alloc
+	*/
+	inline k0::bytes::bytes_spt make_msg(const byte_t* msg,const std::size_t n,const bool checksum)
+	{
+		return make_msg(msg,n,NULL,0,checksum);
+	}
+
 	/*
 	//解析器 分片大小
     template<typename T,std::size_t N>
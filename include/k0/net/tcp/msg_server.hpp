@@ -6,6 +6,10 @@
 #include "msg_reader.hpp"
 #include "server.hpp"
 
+#include <k0/bytes/mirror.hpp>
+#include <k0/bytes/codec.hpp>
+#include <k0/bytes/crc32c.hpp>
+
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
@@ -20,11 +24,13 @@ namespace tcp
 {
 	/**
 	*	\brief 使用 消息解析狀態 只在內部使用
+	*	\param B 消息緩衝區 k0::bytes::buffer_t 或 k0::bytes::mirror_ring_t
 	*/
-	class msg_buffer_t
+	template<typename B>
+	class basic_msg_buffer_t
 	{
 	public:
-		typedef k0::bytes::buffer_t buffer_t;
+		typedef B buffer_t;
 		/**
 		*	\brief 緩衝區
 		*/
@@ -33,20 +39,80 @@ namespace tcp
 		*	\brief 當前讀取狀態
 		*/
 		std::size_t size;
-		msg_buffer_t(std::size_t capacity):size(KING_NET_TCP_WAIT_MSG_HEADER),buffer(capacity)
+		/**
+		*	\brief 當前消息 已到達部分的 crc32c
+		*/
+		k0::bytes::crc32c_stream_t crc;
+		/**
+		*	\brief 當前消息 是否 帶有 crc32c 校驗 在 消息 開始 時 確定
+		*/
+		bool checksum;
+		basic_msg_buffer_t(std::size_t capacity):size(KING_NET_TCP_WAIT_MSG_HEADER),buffer(capacity),checksum(false)
 		{
 		}
 	};
+	typedef basic_msg_buffer_t<k0::bytes::buffer_t> msg_buffer_t;
 	typedef boost::shared_ptr<msg_buffer_t> msg_buffer_spt;
 	/**
+	*	\brief 使用 鏡像環形緩衝區 的 消息解析狀態
+	*
+	*	作爲 msg_server_t 的 TP 參數 時 消息 總是 連續的 on_slice 收到的 切片 只在 回調期間有效
+	*/
+	typedef basic_msg_buffer_t<k0::bytes::mirror_ring_t> mirror_msg_buffer_t;
+	typedef boost::shared_ptr<mirror_msg_buffer_t> mirror_msg_buffer_spt;
+	/**
+	*	\brief 爲 消息緩衝區 啓用 溢出模式
+	*/
+	inline void spill_msg_buffer(k0::bytes::buffer_t& buffer,std::size_t threshold)
+	{
+		buffer.spill(threshold);
+	}
+	/**
+	*	\brief 鏡像環形緩衝區 不支持 溢出
+	*/
+	inline void spill_msg_buffer(k0::bytes::mirror_ring_t&,std::size_t)
+	{
+	}
+	/**
+	*	\brief 釋放 消息緩衝區 緩存的 空閒數據塊 和 prepare 的 數據塊 緩衝區 必須 已經 讀空
+	*/
+	inline void release_msg_buffer(k0::bytes::buffer_t& buffer)
+	{
+		buffer.reset_cache();
+	}
+	/**
+	*	\brief 鏡像環形緩衝區 大小 固定 不釋放
+	*/
+	inline void release_msg_buffer(k0::bytes::mirror_ring_t&)
+	{
+	}
+	/**
 	*	\brief 使用 boost asio 完成的一個 自動解包 客戶端
 	*	\param T 與 socket 綁定 的一個 自定義結構
 	*	\param N recv 緩衝區大小
+	*	\param TP 消息解析狀態 msg_buffer_spt 或 mirror_msg_buffer_spt
 	*/
     template<typename T,std::size_t N=1024*4,typename TP=msg_buffer_spt>
     class msg_server_t:public server_t<T,N,TP>
     {
+	public:
+		/**
+		*	\brief 基類 定義
+		*/
+		typedef server_t<T,N,TP> server_bt;
+		/**
+		*	\brief socket 智能指針
+		*/
+		typedef typename server_bt::socket_spt socket_spt;
+		/**
+		*	\brief recv 直接 讀入的 緩衝區 序列
+		*/
+		typedef typename server_bt::mutable_buffers_t mutable_buffers_t;
 	protected:
+		/**
+		*	\brief 消息解析狀態
+		*/
+		typedef typename TP::element_type msg_buffer_type;
 		/**
 		*	\brief 消息緩衝區 定義
 		*/
@@ -63,14 +129,14 @@ namespace tcp
 		*/
         typedef boost::function<std::size_t(const byte_t*,std::size_t)> reader_header_bft;
 		/**
-		*	\brief 默認 包頭解析函數
+		*	\brief 默認 包頭解析函數 包頭 爲 4 字節 小端 消息長度
 		*	\param b 消息頭 緩衝區
 		*	\param n 緩衝區大小
 		*	\return	成功返回 消息長度 失敗返回 KING_NET_TCP_ERROR_MSG
 		*/
 		static std::size_t reader_header(const byte_t* b,std::size_t n)
 		{
-			std::size_t size = (std::size_t)(*(k0::uint32_t*)b);
+			std::size_t size = (std::size_t)k0::bytes::get_le<k0::uint32_t>(b);
 			if(size > KING_NET_TCP_MAX_MSG_SIZE)
 			{
 				return KING_NET_TCP_ERROR_MSG;
@@ -81,14 +147,24 @@ namespace tcp
 		*	\brief 包頭解析函數
 		*/
 		reader_header_bft _reader_header_bf;
+		/**
+		*	\brief 消息緩衝區 開始 溢出到 磁盤的 待讀字節數 0 不溢出 可以 在 任意線程 修改
+		*/
+		boost::atomic<std::size_t> _spill;
+		/**
+		*	\brief 消息後 是否 帶有 crc32c 校驗 可以 在 任意線程 修改
+		*/
+		boost::atomic<bool> _checksum;
 	public:
 		/**
 		*	\brief 構造 client 並連接到指定 地址
 		*	\param addr 形如 dns:port 的服務器 地址
+		*	\param shards 事件循環 數量 見 server_t::server_t
+		*	\param config 工作線程 配置 見 server_t::server_t
 		*	\return throw k0::net::bad_address k0::net::tcp::exception
 		*/
-        explicit msg_server_t(const std::string& addr,const std::size_t conns=1024,std::size_t header_size=4,reader_header_bft reader_header_bf=boost::bind(&msg_server_t::reader_header,_1,_2))
-			:server_t(addr,conns),_header_size(header_size),_reader_header_bf(reader_header_bf)
+        explicit msg_server_t(const std::string& addr,const std::size_t conns=1024,std::size_t header_size=4,reader_header_bft reader_header_bf=boost::bind(&msg_server_t::reader_header,_1,_2),const std::size_t shards=0,const thread_config_t& config=thread_config_t())
+			:server_t<T,N,TP>(addr,conns,shards,config),_header_size(header_size),_reader_header_bf(reader_header_bf),_spill(0),_checksum(false)
         {
 			
         }
@@ -99,6 +175,70 @@ namespace tcp
         msg_server_t& operator=(const msg_server_t&);
         msg_server_t(const msg_server_t&);
 	public:
+		/**
+		*	\brief 設置 之後創建的 消息緩衝區 待讀數據 超過 threshold 時 溢出到 臨時文件
+		*
+		*	對端 發送 過快 或 處理 停滯時 積壓的 數據 降級到 磁盤速度 而不是 耗盡內存\n
+		*	只對 k0::bytes::buffer_t 有效 mirror_msg_buffer_spt 忽略此設置\n
+		*	可以 在 任意線程 調用 已經 創建的 消息緩衝區 不受影響
+		*/
+		void spill(std::size_t threshold)
+		{
+			_spill.store(threshold,boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 設置 每個消息後 是否 帶有 4 字節 小端 crc32c 校驗
+		*
+		*	校驗 覆蓋 包頭 和 包體 (消息頭 中的 長度 不包含 校驗) 校驗失敗 斷開連接\n
+		*	開啓 後 使用 push_msg 發送的 消息 自動 追加 校驗 push_send 發送的 數據 原樣 發送\n
+		*	crc 在 每次 數據到達 時 增量計算 不需要 再 遍歷一次 消息\n
+		*	可以 在 任意線程 調用 每個 連接 從 下一個 開始 到達的 消息 生效 正在 接收的 消息 不受影響
+		*/
+		void checksum(bool ok)
+		{
+			_checksum.store(ok,boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 向 客戶端 發送 一個 完整消息 (header + body) 開啓 checksum 時 追加 crc32c 校驗
+		*	\return 同 push_send
+		*/
+		bool push_msg(socket_spt s,const byte_t* msg,std::size_t n)
+		{
+			return push_msg(s,msg,n,NULL,0);
+		}
+		/**
+		*	\brief 向 客戶端 發送 分開 存放的 消息頭 和 消息體 開啓 checksum 時 追加 crc32c 校驗
+		*	\return 同 push_send
+		*/
+		bool push_msg(socket_spt s,const byte_t* header,std::size_t header_size,const byte_t* body,std::size_t body_size)
+		{
+			if(s->closed())
+			{
+				return false;
+			}
+			bytes_spt buffer;
+			try
+			{
+				buffer = make_msg(header,header_size,body,body_size,_checksum.load(boost::memory_order_relaxed));
+			}
+			catch(const std::bad_alloc&)
+			{
+				return false;
+			}
+			return this->push_send(s,buffer);
+		}
+		/**
+		*	\brief 向 客戶端 發送 一個 完整消息 沒有 開啓 checksum 時 直接 發送 msg 不會 複製
+		*	\return 同 push_send
+		*/
+		bool push_msg(socket_spt s,bytes_spt msg)
+		{
+			if(!_checksum.load(boost::memory_order_relaxed))
+			{
+				return this->push_send(s,msg);
+			}
+			return push_msg(s,msg->get(),msg->size(),NULL,0);
+		}
 		/**
 		*	\brief 子類實現 當接收到 1個完整消息 時回調
 		*	\param s 接受到消息的 socket
@@ -109,6 +249,21 @@ namespace tcp
 		{
 			return true;
 		}
+		/**
+		*	\brief 子類實現 當接收到 1個完整消息 時回調
+		*
+		*	消息 在同一個數據塊 中時 msg 直接共享 消息緩衝區 不會拷貝\n
+		*	默認實現 將消息 拷貝到 bytes_t 後 調用 on_msg
+		*
+		*	\param s 接受到消息的 socket
+		*	\param msg 消息 切片
+		*	\return	true 數據處理完畢 false 數據錯誤 斷開連接
+		*/
+		virtual bool on_slice(socket_spt& s,k0::bytes::slice_t& msg)
+		{
+			bytes_spt b = msg.to_bytes();
+			return on_msg(s,b);
+		}
 
 		/**
 		*	\brief 不要重載此函數
@@ -117,91 +272,188 @@ namespace tcp
 		{
 			try
 			{
-				//創建 消息 緩衝區
-				msg_buffer_spt tp = s->_tp;
-				if(!tp)
-				{
-					tp = boost::make_shared<msg_buffer_t>(N);
-					s->_tp = tp;
-				}
-				msg_buffer_t::buffer_t& buffer = tp->buffer;
-				std::size_t& size = tp->size;
+				TP tp = get_msg_buffer(s);
 
 				//寫入緩存 失敗
-				if( n != buffer.write(b,n))
+				if( n != tp->buffer.write(b,n))
 				{
 					//返回false 斷開連接
 					return false;
 				}
+				return unpack_partial(s,*tp);
+			}
+			catch(const std::bad_alloc&)
+			{
+			}
+			return false;
+		}
+		/**
+		*	\brief 不要重載此函數 直接 將數據 讀入 消息緩衝區
+		*/
+		virtual bool on_prepare(socket_spt& s,mutable_buffers_t& buffers)
+		{
+			try
+			{
+				TP tp = get_msg_buffer(s);
+				return tp->buffer.prepare(N,buffers) == N;
+			}
+			catch(const std::bad_alloc&)
+			{
+			}
+			//使用 on_recv
+			return false;
+		}
+		/**
+		*	\brief 不要重載此函數
+		*/
+		virtual bool on_commit(socket_spt& s,std::size_t n)
+		{
+			try
+			{
+				TP tp = get_msg_buffer(s);
+				if(n != tp->buffer.commit(n))
+				{
+					return false;
+				}
+				return unpack_partial(s,*tp);
+			}
+			catch(const std::bad_alloc&)
+			{
+			}
+			return false;
+		}
+	protected:
+		/**
+		*	\brief 返回 socket 的 消息緩衝區 不存在則 創建
+		*	\exception std::bad_alloc
+		*/
+		TP get_msg_buffer(socket_spt& s)
+		{
+			TP tp = s->_tp;
+			if(!tp)
+			{
+				tp = boost::make_shared<msg_buffer_type>(N);
+				std::size_t threshold = _spill.load(boost::memory_order_relaxed);
+				if(threshold)
+				{
+					spill_msg_buffer(tp->buffer,threshold);
+				}
+				s->_tp = tp;
+			}
+			return tp;
+		}
+		/**
+		*	\brief unpack 並 記錄 是否 有 未完成的 消息
+		*
+		*	read 超時 只在 第一個 消息 到達前 和 消息 只到達 一部分 時 生效 消息之間 的 空閒 由 idle 超時 處理\n
+		*	reactive 連接 讀空 後 釋放 緩衝區 持有的 空閒數據塊 空閒連接 不佔用 recv 內存
+		*/
+		bool unpack_partial(socket_spt& s,msg_buffer_type& tp)
+		{
+			bool ok = unpack(s,tp);
+			s->_partial = tp.buffer.size() != 0;
+			if(!s->_partial && s->_reactive)
+			{
+				release_msg_buffer(tp.buffer);
+			}
+			return ok;
+		}
+		/**
+		*	\brief 從 消息緩衝區 解析出 所有完整消息 並通知用戶
+		*	\return	false 協議錯誤 斷開連接
+		*	\exception std::bad_alloc
+		*/
+		bool unpack(socket_spt& s,msg_buffer_type& tp)
+		{
+			typename msg_buffer_type::buffer_t& buffer = tp.buffer;
+			std::size_t& size = tp.size;
 
-				//解析 消息
-				//解析消息
-				while(true)
+			//解析消息
+			while(true)
+			{
+				std::size_t size_buffer = buffer.size();
+				if(!size_buffer)
+				{
+					break;
+				}
+				//解析消息頭
+				if(KING_NET_TCP_WAIT_MSG_HEADER == size)
 				{
-					std::size_t size_buffer = buffer.size();
-					if(!size_buffer)
+					//還沒有 計算 當前消息 時 確定 是否 帶有 校驗 之後 整個消息 不變
+					if(!tp.crc.hashed())
 					{
-						break;
+						tp.checksum = _checksum.load(boost::memory_order_relaxed);
 					}
-					//解析消息頭
-					if(KING_NET_TCP_WAIT_MSG_HEADER == size)
+					if(tp.checksum)
 					{
-						if(size_buffer < _header_size)
-						{
-							//等待消息頭
-							return true;
-						}
-						else
-						{
-							
-							boost::shared_array<byte_t> header(new byte_t[_header_size]);
-							//讀取消息頭
-							if(_header_size != buffer.copy_to(header.get(),_header_size))
-							{
-								return false;
-							}
-							
-							//解析 消息頭
-							size = _reader_header_bf(header.get(),_header_size);
-							if(size == KING_NET_TCP_ERROR_MSG || size < _header_size)
-							{
-								return false;
-							}
-						}
+						tp.crc.update(buffer,_header_size);
 					}
-					
-
-					//獲取 body
-					if(size_buffer < size)
+					if(size_buffer < _header_size)
 					{
-						//等待 body
+						//等待消息頭
 						return true;
 					}
-					
-					//獲取 消息
-					bytes_spt msg = boost::make_shared<k0::bytes::bytes_t>(size);
-					if(msg->size() != size)
+					else
 					{
-						return false;
-					}
-					if(size != buffer.read(msg->get(),size))
-					{
-						return false;
+						
+						boost::shared_array<byte_t> header(new byte_t[_header_size]);
+						//讀取消息頭
+						if(_header_size != buffer.copy_to(header.get(),_header_size))
+						{
+							return false;
+						}
+						
+						//解析 消息頭
+						size = _reader_header_bf(header.get(),_header_size);
+						if(size == KING_NET_TCP_ERROR_MSG || size < _header_size)
+						{
+							return false;
+						}
 					}
+				}
+				
 
-					//通知用戶
-					if(!on_msg(s,msg))
+				//獲取 body
+				std::size_t frame = size;
+				if(tp.checksum)
+				{
+					//計算 新到達的 字節
+					tp.crc.update(buffer,size);
+					frame += sizeof(k0::uint32_t);
+				}
+				if(size_buffer < frame)
+				{
+					//等待 body
+					return true;
+				}
+				if(tp.checksum)
+				{
+					k0::uint32_t crc;
+					if(!k0::bytes::peek_le(buffer,size,crc) || crc != tp.crc.value())
 					{
 						return false;
 					}
-					size = KING_NET_TCP_WAIT_MSG_HEADER;
 				}
-			}
-			catch(const std::bad_alloc&)
-			{
-				return false;
-			}
+				
+				//獲取 消息
+				k0::bytes::slice_t msg;
+				if(size != buffer.read(size,msg))
+				{
+					return false;
+				}
 
+				//通知用戶
+				if(!on_slice(s,msg))
+				{
+					return false;
+				}
+				if(tp.checksum)
+				{
+					buffer.consume(sizeof(k0::uint32_t));
+					tp.crc.reset();
+				}
+				size = KING_NET_TCP_WAIT_MSG_HEADER;
+			}
 			return true;
 		}
     };
@@ -3,11 +3,17 @@
 #define KING_LIB_HEADER_NET_TCP_SERVER
 
 #include "type.hpp"
+#include "io_pool.hpp"
+#include "timer_heap.hpp"
 
 
 #include <iostream>
 
+#include <boost/array.hpp>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <vector>
 
 
 namespace k0
@@ -28,11 +34,15 @@ namespace tcp
 		/**
 		*	\brief socket 定義
 		*/
-        typedef socket_t<T,TP> socket_t;
+        typedef tcp::socket_t<T,TP> socket_t;
 		/**
 		*	\brief socket 智能指針
 		*/
         typedef std::shared_ptr<socket_t> socket_spt;
+		/**
+		*	\brief 直接 recv 使用的 可寫區域
+		*/
+		typedef boost::array<boost::asio::mutable_buffer,2> mutable_buffers_t;
 	protected:
 		/**
 		*	\brief asio 服務
@@ -40,29 +50,64 @@ namespace tcp
         io_service_t _io_s;
 
 		/**
-		*	\brief 運行的最大連接數量
+		*	\brief 運行的最大連接數量 可以 在 任意線程 修改 爲0 時 不限制
 		*/
-		std::size_t _max;
+		boost::atomic<std::size_t> _max;
 
 		/**
-		*	\brief 線程數
+		*	\brief 同時 等待中的 accept 數量 (平分到 每個 接受器)
 		*/
 		std::size_t _count;
 
 		/**
 		*	\brief 成功連接數量
 		*/
-		std::size_t _conns;
+		boost::atomic<std::size_t> _conns;
 
 		/**
 		*	\brief 待連接數量
 		*/
-		std::size_t _accepts;
-		
+		boost::atomic<std::size_t> _accepts;
+		/**
+		*	\brief 每個 接受器 的 待連接數量 與 _acceptors 一一對應
+		*/
+		boost::atomic<std::size_t>* _accepting;
+		/**
+		*	\brief 因 超過 最大連接 在 accept 後 被關閉的 連接數量
+		*/
+		boost::atomic<k0::uint64_t> _rejected;
+		/**
+		*	\brief 因 達到 最大連接 暫不 投遞的 accept 次數
+		*/
+		boost::atomic<k0::uint64_t> _deferred;
+		/**
+		*	\brief 每個 事件循環 一個 時間輪 與 事件循環 一一對應
+		*/
+		std::vector<timing_wheel_t*> _wheels;
+		/**
+		*	\brief 驅動 時間輪 的 定時器
+		*/
+		std::vector<steady_timer_t*> _tickers;
+		/**
+		*	\brief 時間輪 每個 tick 的 毫秒數 爲0 時 沒有 啓動 啓動後 不變
+		*/
+		boost::atomic<std::size_t> _tick;
 		/**
-		*	\brief recv 同步對象
+		*	\brief idle 超時 毫秒 爲0 時 不超時
 		*/
-		boost::mutex _mutex;
+		boost::atomic<std::size_t> _idle;
+		/**
+		*	\brief read 超時 毫秒 爲0 時 不超時
+		*/
+		boost::atomic<std::size_t> _read;
+		/**
+		*	\brief 每個 事件循環 一個 定時器 集合 供 schedule_after schedule_every 使用
+		*/
+		std::vector<timer_heap_t*> _timers;
+		/**
+		*	\brief 不指定 socket 時 輪詢 選擇 事件循環
+		*/
+		boost::atomic<std::size_t> _next_timer;
 
 		/**
 		*	\brief recv 緩衝區 大小
@@ -71,30 +116,71 @@ namespace tcp
 
 		/**
 		*	\brief 連接 接受器
+		*
+		*	分片模式 下 每個 事件循環 一個 (SO_REUSEPORT) 系統 不支持時 只有一個
+		*/
+        std::vector<acceptor_t*> _acceptors;
+
+		/**
+		*	\brief 分片模式 的 事件循環 默認模式 爲 NULL
 		*/
-        acceptor_t* _acceptor;
+		io_pool_t* _pool;
 
         /**
 		*	\brief 工作 線程
 		*/
         boost::thread_group _threads;
+		/**
+		*	\brief 工作線程 配置
+		*/
+		thread_config_t _config;
+		/**
+		*	\brief 之後 接受的 連接 是否 等待 可讀 後 才 準備 recv 緩衝區 可以 在 任意線程 修改
+		*/
+		boost::atomic<bool> _reactive;
+		/**
+		*	\brief reactive 模式下 每個 線程 一個 借出的 recv 緩衝區
+		*/
+		boost::thread_specific_ptr<k0::bytes::bytes_t> _recv_buffers;
+		/**
+		*	\brief 每個 連接 發送隊列 的 水位 可以 在 任意線程 修改
+		*/
+		atomic_watermark_t _marks;
 	private:
-        void work_thread()
+        void work_thread(const std::size_t i)
         {
+			_config.apply(i);
             _io_s.run();
         }
     public:
 		/**
 		*	\brief 構造 server_t 並監聽指定 地址
+		*
+		*	shards 爲0 時 所有連接 共享 一個 io_service 由 config.threads 個 線程 運行 默認 (cpu核心數+1)*2\n
+		*	shards 不爲0 時 使用 shards 個 事件循環 每個 事件循環 使用 SO_REUSEPORT 監聽 同一地址
+		*	連接 在 接受它的 事件循環 上 度過 整個 生命週期 config.affinity 爲空 時 第 i 個 事件循環 綁定到 第 i 個 cpu\n
+		*	系統 不支持 SO_REUSEPORT 時 只創建 一個 接受器 新連接 輪詢 分配到 各個 事件循環
+		*
 		*	\param addr 形如 dns:port 的服務器 地址
 		*	\param conns 最大的連接數量
+		*	\param shards 事件循環 數量
+		*	\param config 工作線程 配置 分片模式 忽略 config.threads
 		*	\return throw k0::net::bad_address k0::net::tcp::exception
 		*/
-        explicit server_t(const std::string& addr,const std::size_t conns=1024)
-			:_acceptor(NULL),
-			_max(conns),
+        explicit server_t(const std::string& addr,const std::size_t conns=1024,const std::size_t shards=0,const thread_config_t& config=thread_config_t())
+			:_max(conns),
 			_conns(0),
-			_accepts(0)
+			_accepts(0),
+			_accepting(NULL),
+			_rejected(0),
+			_deferred(0),
+			_tick(0),
+			_idle(0),
+			_read(0),
+			_next_timer(0),
+			_pool(NULL),
+			_config(config),
+			_reactive(false)
         {
 			//驗證 地址
 			std::string::size_type find = addr.find_last_of(':');
@@ -122,40 +208,68 @@ namespace tcp
 			//監聽服務器
 			try
 			{
-				if("" == dns)
+				boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(),port);
+				if("" != dns)
+				{
+					endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(dns),port);
+				}
+
+				if(shards)
 				{
-					_acceptor = new acceptor_t(_io_s,boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(),port));
+					thread_config_t pool = config;
+					pool.threads = shards;
+					pool.pin = true;
+					_pool = new io_pool_t(pool);
+					_count = _pool->size() * 2;
+					listen_shards(endpoint);
 				}
 				else
 				{
-					_acceptor = new acceptor_t(
-						_io_s,
-						boost::asio::ip::tcp::endpoint(
-							boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(dns),port)
-						)
-					);
+					_acceptors.push_back(NULL);
+					_acceptors.back() = new acceptor_t(_io_s,endpoint);
+
+					//線程數
+					_count = config.count((boost::thread::hardware_concurrency() + 1 ) * 2);
+				}
+				//每個 事件循環 一個 時間輪 timeouts 設置 超時 後 才 啓動
+				std::size_t loops = _pool ? _pool->size() : 1;
+				for(std::size_t i=0;i<loops;++i)
+				{
+					_wheels.push_back(NULL);
+					_wheels.back() = new timing_wheel_t();
+					_tickers.push_back(NULL);
+					_tickers.back() = new steady_timer_t(_pool ? _pool->get(i) : _io_s);
+					_timers.push_back(NULL);
+					_timers.back() = new timer_heap_t(_pool ? _pool->get(i) : _io_s,i);
 				}
 
-				//線程數
-				_count = (boost::thread::hardware_concurrency() + 1 ) * 2; 
-				
+				_accepting = new boost::atomic<std::size_t>[_acceptors.size()];
+				for(std::size_t i=0;i<_acceptors.size();++i)
+				{
+					_accepting[i].store(0);
+				}
 				
 				//異步 接受 連接
 				post_accepts();
 				
 
 				//啓動工作線程
-				for(std::size_t i = 0 ; i < _count ; ++i)
+				if(!_pool)
 				{
-					_threads.add_thread(new boost::thread(boost::bind(&server_t::work_thread,this)));
+					for(std::size_t i = 0 ; i < _count ; ++i)
+					{
+						_threads.add_thread(new boost::thread(boost::bind(&server_t::work_thread,this,i)));
+					}
 				}
 			}
 			catch(const std::bad_alloc& e)
 			{
+				release();
 				KING_NET_TCP_THROW(e);
 			}
 			catch(const boost::system::system_error& e)
 			{
+				release();
 				KING_NET_TCP_THROW(e);
 			}
         }
@@ -168,13 +282,7 @@ namespace tcp
 		*/
 		virtual ~server_t()
         {
-            _io_s.stop();
-            _threads.join_all();
-
-			if(_acceptor)
-			{
-				delete _acceptor;
-			}
+			release();
         }
 		/**
 		*	\brief 子類實現 當和客戶端成功連接後回調
@@ -208,121 +316,523 @@ namespace tcp
 		virtual void on_send(socket_spt& s,bytes_spt& buffer)
 		{
 		}
+		/**
+		*	\brief 子類實現 在每次 recv 前 提供 直接接收數據的 內存
+		*
+		*	返回 true 時 數據 直接 讀入 buffers 並以 on_commit 代替 on_recv 通知\n
+		*	返回 false 時 使用 N 字節的 recv 緩衝區 並以 on_recv 通知
+		*
+		*	\param s 要 recv 的 socket
+		*	\param buffers 可寫區域
+		*/
+		virtual bool on_prepare(socket_spt& s,mutable_buffers_t& buffers)
+		{
+			return false;
+		}
+		/**
+		*	\brief 子類實現 當數據 已直接 讀入 on_prepare 提供的內存 時回調
+		*	\param s 收到數據的 socket
+		*	\param n 數據長度
+		*	\return	true 數據處理完畢 false 數據錯誤 斷開連接
+		*/
+		virtual bool on_commit(socket_spt& s,std::size_t n)
+		{
+			return true;
+		}
+		/**
+		*	\brief 子類實現 try_send 返回 send_would_block 後 發送隊列 降到 低水位 時 回調 每次 拒絕 之後 回調一次
+		*	\param s 可以 繼續 發送的 socket
+		*/
+		virtual void on_writable(socket_spt& s)
+		{
+		}
+		/**
+		*	\brief 子類實現 發送隊列 超過 高水位 watermark_t::deadline 毫秒 仍未 降到 低水位 時 回調
+		*	\param s 慢速的 socket
+		*	\return true 斷開連接 false 再等待 deadline 毫秒
+		*/
+		virtual bool on_slow(socket_spt& s)
+		{
+			return true;
+		}
+		/**
+		*	\brief 子類實現 連接 超時 時 回調
+		*	\param s 超時的 socket
+		*	\param t 超時 類型
+		*	\return true 斷開連接 false 重新 計時
+		*/
+		virtual bool on_timeout(socket_spt& s,timeout_t t)
+		{
+			return true;
+		}
 	public:
 		/**
 		*	\brief 返回 最大 接受連接數
 		*/
 		inline std::size_t max()const
 		{
-			return _max;
+			return _max.load(boost::memory_order_relaxed);
 		}
 		/**
 		*	\brief 設置 最大 接受連接數
+		*
+		*	達到 最大連接 時 不再 投遞 accept 新連接 留在 系統 backlog 中 有連接 斷開 後 恢復
 		*/
 		inline void max(const std::size_t n)
 		{
-			_max = n;
+			_max.store(n,boost::memory_order_relaxed);
+			//增大時 立刻 恢復 accept
+			post_accepts();
+		}
+		/**
+		*	\brief 返回 當前 連接數量
+		*/
+		inline std::size_t conns()const
+		{
+			return _conns;
+		}
+		/**
+		*	\brief 返回 accept 後 因 超過 最大連接 被關閉的 連接數量
+		*
+		*	只在 競爭 或 減小 max 時 出現 達到 最大連接 時 不會 投遞 accept
+		*/
+		inline k0::uint64_t rejected()const
+		{
+			return _rejected;
+		}
+		/**
+		*	\brief 返回 因 達到 最大連接 暫不 投遞 accept 的 次數
+		*/
+		inline k0::uint64_t deferred()const
+		{
+			return _deferred;
+		}
+		/**
+		*	\brief 設置 之後 接受的 連接 的 超時 毫秒 爲0 時 不超時
+		*
+		*	idle 超時 沒有 recv 也沒有 send 完成 read 超時 沒有 recv (msg_server_t 只在 等待 消息 到達 時)\n
+		*	超時 時 回調 on_timeout 默認 斷開連接\n
+		*	每個 事件循環 一個 時間輪 精度 爲 tick 毫秒 只在 第一次 設置 時 生效
+		*
+		*	\param idle idle 超時
+		*	\param read read 超時
+		*	\param tick 時間輪 精度
+		*/
+		void timeouts(const std::size_t idle,const std::size_t read,const std::size_t tick = 100)
+		{
+			_idle.store(idle,boost::memory_order_relaxed);
+			_read.store(read,boost::memory_order_relaxed);
+			if(!(idle || read))
+			{
+				return;
+			}
+			//只有 第一次 設置 的 線程 啓動 時間輪
+			std::size_t zero = 0;
+			if(!_tick.compare_exchange_strong(zero,tick ? tick : 1))
+			{
+				return;
+			}
+			for(std::size_t i=0;i<_tickers.size();++i)
+			{
+				start_tick(i);
+			}
+		}
+		/**
+		*	\brief 返回 idle 超時 毫秒
+		*/
+		inline std::size_t idle_timeout()const
+		{
+			return _idle.load(boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 返回 read 超時 毫秒
+		*/
+		inline std::size_t read_timeout()const
+		{
+			return _read.load(boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 在 delay 毫秒 之後 於 事件循環 的 線程中 執行 fn 分片模式 下 輪詢 選擇 事件循環
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_after(const std::size_t delay,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers[_next_timer.fetch_add(1,boost::memory_order_relaxed) % _timers.size()]->schedule(delay,0,fn);
+		}
+		/**
+		*	\brief 在 delay 毫秒 之後 於 s 所屬 事件循環 的 線程中 執行 fn
+		*
+		*	分片模式 下 fn 與 s 的 回調 在 同一 線程 執行 不需要 加鎖
+		*
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_after(socket_spt& s,const std::size_t delay,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers[loop_of(s->io_service())]->schedule(delay,0,fn);
+		}
+		/**
+		*	\brief 每 period 毫秒 於 事件循環 的 線程中 執行一次 fn 直到 cancel_timer
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_every(const std::size_t period,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers[_next_timer.fetch_add(1,boost::memory_order_relaxed) % _timers.size()]->schedule(period,period,fn);
+		}
+		/**
+		*	\brief 每 period 毫秒 於 s 所屬 事件循環 的 線程中 執行一次 fn 直到 cancel_timer
+		*
+		*	fn 通常 綁定 s 連接 斷開 後 需要 cancel_timer 釋放
+		*
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule_every(socket_spt& s,const std::size_t period,const timer_heap_t::callback_ft& fn)
+		{
+			return _timers[loop_of(s->io_service())]->schedule(period,period,fn);
+		}
+		/**
+		*	\brief 取消 schedule_after schedule_every 創建的 定時器
+		*	\return 定時器 不存在 或 已經 執行 返回 false
+		*/
+		bool cancel_timer(const timer_id_t id)
+		{
+			std::size_t i = timer_heap_t::index_of(id);
+			return i < _timers.size() ? _timers[i]->cancel(id) : false;
+		}
+		/**
+		*	\brief 返回 是否 使用 reactive recv
+		*/
+		inline bool reactive()const
+		{
+			return _reactive.load(boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 設置 之後 接受的 連接 是否 使用 reactive recv
+		*
+		*	默認 每個 連接 持有 一個 N 字節 recv 緩衝區 (或 on_prepare 提供的 內存) 直到 斷開\n
+		*	reactive 時 以 null_buffers 等待 可讀 之後 才 調用 on_prepare 或 借用 當前線程 的 recv 緩衝區 非阻塞 讀取\n
+		*	數據 處理完後 歸還 空閒連接 不佔用 recv 內存 適合 大量 空閒 連接 每次 可讀 多一次 系統調用
+		*/
+		inline void reactive(bool ok)
+		{
+			_reactive.store(ok,boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 返回 發送隊列 水位
+		*/
+		inline watermark_t watermark()const
+		{
+			return _marks.load();
+		}
+		/**
+		*	\brief 設置 每個 連接 發送隊列 的 水位 可以 在 運行時 從 任意線程 調用
+		*
+		*	隊列 達到 高水位 後 try_send 返回 send_would_block push_send 返回 false 降到 低水位 時 回調 on_writable\n
+		*	marks.pause 時 超過 高水位 的 連接 暫停 recv 直到 降到 低水位\n
+		*	從 拒絕 發送 或 暫停 recv 開始 marks.deadline 毫秒 後 仍未 降到 低水位 回調 on_slow
+		*/
+		inline void watermark(const watermark_t& marks)
+		{
+			_marks.store(marks);
 		}
 	protected:
 		/**
-		*	\brief 異步接受連接
+		*	\brief 停止 工作 並 釋放 接受器 和 事件循環
+		*/
+		void release()
+		{
+			_io_s.stop();
+			if(_pool)
+			{
+				_pool->stop();
+			}
+			_threads.join_all();
+			if(_pool)
+			{
+				_pool->join();
+			}
+
+			//定時器 接受器 和 時間輪 持有的 socket 引用 事件循環 需要 先釋放
+			for(std::size_t i=0;i<_tickers.size();++i)
+			{
+				delete _tickers[i];
+			}
+			_tickers.clear();
+			for(std::size_t i=0;i<_timers.size();++i)
+			{
+				delete _timers[i];
+			}
+			_timers.clear();
+			for(std::size_t i=0;i<_wheels.size();++i)
+			{
+				delete _wheels[i];
+			}
+			_wheels.clear();
+			for(std::size_t i=0;i<_acceptors.size();++i)
+			{
+				delete _acceptors[i];
+			}
+			_acceptors.clear();
+			if(_accepting)
+			{
+				delete[] _accepting;
+				_accepting = NULL;
+			}
+			if(_pool)
+			{
+				delete _pool;
+				_pool = NULL;
+			}
+		}
+		/**
+		*	\brief 分片模式 在 每個 事件循環 上 使用 SO_REUSEPORT 監聽 endpoint 系統不支持 或 定義了 KING_NET_TCP_NO_REUSEPORT 時 只監聽一次
+		*	\exception boost::system::system_error std::bad_alloc
+		*/
+		void listen_shards(const boost::asio::ip::tcp::endpoint& endpoint)
+		{
+#if defined(SO_REUSEPORT) && !defined(KING_NET_TCP_NO_REUSEPORT)
+			typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,SO_REUSEPORT> reuse_port_t;
+			for(std::size_t i=0;i<_pool->size();++i)
+			{
+				_acceptors.push_back(NULL);
+				acceptor_t* acceptor = new acceptor_t(_pool->get(i));
+				_acceptors.back() = acceptor;
+
+				acceptor->open(endpoint.protocol());
+				acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+				boost::system::error_code e;
+				acceptor->set_option(reuse_port_t(true),e);
+				if(e)
+				{
+					//不支持 SO_REUSEPORT
+					for(std::size_t j=0;j<_acceptors.size();++j)
+					{
+						delete _acceptors[j];
+					}
+					_acceptors.clear();
+					break;
+				}
+				acceptor->bind(endpoint);
+				acceptor->listen();
+			}
+			if(!_acceptors.empty())
+			{
+				return;
+			}
+#endif
+			_acceptors.push_back(NULL);
+			_acceptors.back() = new acceptor_t(_pool->get(0),endpoint);
+		}
+		/**
+		*	\brief 返回 第 i 個 接受器 接受的 連接 應該 綁定的 事件循環
+		*/
+		io_service_t& accept_service(const std::size_t i)
+		{
+			if(!_pool)
+			{
+				return _io_s;
+			}
+			if(_acceptors.size() == _pool->size())
+			{
+				//SO_REUSEPORT 留在 接受 連接的 事件循環
+				return _pool->get(i);
+			}
+			//只有一個 接受器 輪詢 分配
+			return _pool->next();
+		}
+		/**
+		*	\brief 異步接受連接 使每個 接受器 都有 足夠的 待連接
+		*
+		*	不加鎖 多個線程 同時 調用時 以 cas 預留 名額 待連接 不會 超過 count
 		*/
 		void post_accepts()
         {
-			boost::mutex::scoped_lock lock(_mutex);
-			std::size_t count = _count;
-			if(_accepts >= count)
+			std::size_t n = _acceptors.size();
+			std::size_t count = n ? _count / n : 0;
+			if(!count)
 			{
-				return;
+				count = 1;
 			}
-			count -= _accepts;
 
 			//異步 接受連接
-			for(std::size_t i = 0 ; i < count ; ++i)
+			for(std::size_t i = 0 ; i < n ; ++i)
 			{
-					post_accept();
+				while(true)
+				{
+					//先 佔用 連接 名額 再 佔用 接受器 名額 後者 失敗 時 接受器 上 有 count 個 待連接 完成時 會 再次 投遞
+					if(!admit_accept())
+					{
+						//達到 最大連接 有連接 斷開 時 再 投遞
+						_deferred.fetch_add(1,boost::memory_order_relaxed);
+						return;
+					}
+					if(!reserve_accept(i,count))
+					{
+						_accepts.fetch_sub(1,boost::memory_order_relaxed);
+						break;
+					}
+					if(!post_accept(i))
+					{
+						//歸還 名額 等 之後的 post_accepts 重試
+						_accepting[i].fetch_sub(1,boost::memory_order_relaxed);
+						_accepts.fetch_sub(1,boost::memory_order_relaxed);
+						break;
+					}
+				}
 			}
-			
         }
 		/**
-		*	\brief 異步接受連接
+		*	\brief 第 i 個 接受器 的 待連接 少於 count 時 預留 一個 名額
+		*/
+		bool reserve_accept(const std::size_t i,const std::size_t count)
+		{
+			std::size_t accepting = _accepting[i].load(boost::memory_order_relaxed);
+			while(accepting < count)
+			{
+				if(_accepting[i].compare_exchange_weak(accepting,accepting + 1,boost::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		/**
+		*	\brief 連接數 加上 待連接數 小於 最大連接 時 增加 待連接數
+		*
+		*	accept 完成時 先 增加 _conns 再 減少 _accepts 兩者之和 不會 暫時 變小
+		*/
+		bool admit_accept()
+		{
+			std::size_t accepts = _accepts.load(boost::memory_order_relaxed);
+			std::size_t limit = _max.load(boost::memory_order_relaxed);
+			while(!limit || _conns.load(boost::memory_order_relaxed) + accepts < limit)
+			{
+				if(_accepts.compare_exchange_weak(accepts,accepts + 1,boost::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		/**
+		*	\brief 在 第 i 個 接受器 上 異步接受連接 (需要 先 reserve_accept 和 admit_accept)
 		*/
-        void post_accept()
+        bool post_accept(const std::size_t i)
         {
 			try
 			{
-				socket_spt s = std::make_shared<socket_t>(_io_s);
-				_acceptor->async_accept(s->socket(),
+				socket_spt s = std::make_shared<socket_t>(accept_service(i));
+				_acceptors[i]->async_accept(s->socket(),
 					boost::bind(&server_t::post_accept_handler,
 					this,
 					boost::asio::placeholders::error,
-					s)
+					s,
+					i)
 				);
-				++_accepts;
+				return true;
 			}
 			catch(const std::bad_alloc& e)
 			{
 				std::cout<<"post_accept error : "<<e.what()<<"\n";
 			}
+			return false;
         }
 		/**
 		*	\brief 連接處理器
 		*/
-        void post_accept_handler(const boost::system::error_code& e,socket_spt s)
+        void post_accept_handler(const boost::system::error_code& e,socket_spt s,std::size_t i)
         {
-			//減少 _accepts 計數
-			_mutex.lock();
-			--_accepts;
-			_mutex.unlock();
+			//先 增加 coons 計數 再 減少 _accepts 計數
+			std::size_t conns = 0;
+			if(!e)
+			{
+				conns = _conns.fetch_add(1,boost::memory_order_relaxed);
+			}
+			_accepts.fetch_sub(1,boost::memory_order_relaxed);
+			_accepting[i].fetch_sub(1,boost::memory_order_relaxed);
+
+			//超過 最大連接 (max 被減小) 關閉 連接 釋放資源
+			std::size_t limit = _max.load(boost::memory_order_relaxed);
+			bool reject = !e && limit && conns >= limit;
+			if(reject)
+			{
+				_conns.fetch_sub(1,boost::memory_order_relaxed);
+				_rejected.fetch_add(1,boost::memory_order_relaxed);
+				boost::system::error_code e0;
+                s->socket().close(e0);
+			}
 
-            //投遞 新的 接受 操作
+            //投遞 新的 接受 操作 達到 最大連接 時 不會 投遞
             post_accepts();
 
             //連接錯誤 直接返回
-            if(e)
+            if(e || reject)
             {
                 return;
             }
 
-            //創建 recv 緩衝區
-            bytes_spt buffer;
-            try
-            {
-                buffer = boost::make_shared<k0::bytes::bytes_t>(N);
-            }
-            catch(const std::bad_alloc&)
-            {
-                //創建 recv 緩衝區失敗 直接 斷開連接
-                return;
-            }
-			
-			//超過 最大連接 不再 接受新連接
-			if(_max && _conns >= _max)
+			s->_reactive = _reactive.load(boost::memory_order_relaxed);
+			if(s->_reactive)
 			{
-				//關閉 連接 釋放資源
+				//可讀 通知 可能 是 虛假的 讀取 不能 阻塞
 				boost::system::error_code e0;
-                s->socket().close(e0);
-				return;
+				s->socket().non_blocking(true,e0);
 			}
 
-			//增加 coons 計數
-			_mutex.lock();
-			++_conns;
-			_mutex.unlock();
-
             //通知 用戶
 			on_accept(s);
+
+			//開始 計時
+			arm_timeout(s);
             
 
-            //投遞 異步 recv
-            post_recv(s,buffer);
+            //投遞 異步 recv recv 緩衝區 在 post_recv 中 按需創建
+            post_recv(s,bytes_spt());
         }
 		
 		/**
 		*	\brief 異步讀取數據
+		*	\param buffer recv 緩衝區 爲空時 先嘗試 on_prepare 再 創建
 		*/
-		inline void post_recv(socket_spt s,bytes_spt buffer)
+		void post_recv(socket_spt s,bytes_spt buffer)
         {
+			if(_marks.pause.load(boost::memory_order_relaxed) && over_high(s) && pause_recv(s))
+			{
+				//發送隊列 降到 低水位 時 重新 投遞 recv
+				return;
+			}
+			if(!buffer && s->_reactive)
+			{
+				post_wait(s);
+				return;
+			}
+			if(!buffer)
+			{
+				try
+				{
+					//直接 讀入 子類 提供的 內存
+					mutable_buffers_t buffers;
+					if(on_prepare(s,buffers))
+					{
+						s->socket().async_read_some(buffers,
+							boost::bind(&server_t::post_commit_handler,
+							this,
+							boost::asio::placeholders::error,
+							s,
+							boost::asio::placeholders::bytes_transferred)
+						);
+						return;
+					}
+
+					//創建 recv 緩衝區
+					buffer = k0::bytes::make_bytes(N);
+				}
+				catch(const std::bad_alloc&)
+				{
+					//創建 recv 緩衝區失敗 直接 斷開連接
+					post_recv_close(s);
+					return;
+				}
+			}
             s->socket().async_read_some(boost::asio::buffer(buffer->get(),buffer->size()),
                 boost::bind(&server_t::post_recv_handler,
                 this,
@@ -339,46 +849,17 @@ namespace tcp
         {
             if(e)
             {
-                //通知 用戶
-                on_close(s);
-
-                //錯誤 斷開 連接
-                if(s->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    s->socket().close(e0);
-                }
-
-				//減少 conns 計數
-				_mutex.lock();
-				--_conns;
-				_mutex.unlock();
-
-				post_accepts();
+				//錯誤 斷開 連接
+				post_recv_close(s);
                 return;
             }
+			touch_recv(s);
 			
             //通知 用戶
 			if(!on_recv(s,buffer->get(),n))
 			{
 				//協議錯誤 直接斷開連接
-
-				//通知 用戶
-                on_close(s);
-
-				//錯誤 斷開
-                if(s->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    s->socket().close(e0);
-                }
-
-				//減少 conns 計數
-				_mutex.lock();
-				--_conns;
-				_mutex.unlock();
-
-				post_accepts();
+				post_recv_close(s);
 				return;
 			}
          
@@ -386,22 +867,416 @@ namespace tcp
             //投遞 新的 recv
             post_recv(s,buffer);
         }
-    
-	public:
         /**
-		*	\brief 返回 工作 線程 數量
+		*	\brief 直接讀取 處理器
 		*/
-        inline std::size_t work_threads()const
+		void post_commit_handler(const boost::system::error_code& e,socket_spt s,std::size_t n)
         {
-            return _threads.size();
-        }
-
+			if(!e)
+			{
+				touch_recv(s);
+			}
+			if(e || !on_commit(s,n))
+			{
+				//錯誤 斷開 連接
+				post_recv_close(s);
+				return;
+			}
+
+            //投遞 新的 recv
+            post_recv(s,bytes_spt());
+        }
+		/**
+		*	\brief 異步 等待 可讀
+		*/
+		void post_wait(socket_spt s)
+		{
+			s->socket().async_read_some(boost::asio::null_buffers(),
+				boost::bind(&server_t::post_wait_handler,
+				this,
+				boost::asio::placeholders::error,
+				s)
+			);
+		}
+		/**
+		*	\brief 可讀 處理器 在 這裏 準備 recv 內存 並 非阻塞 讀取
+		*/
+		void post_wait_handler(const boost::system::error_code& e,socket_spt s)
+		{
+			if(e)
+			{
+				//錯誤 斷開 連接
+				post_recv_close(s);
+				return;
+			}
+
+			//有 數據 時 直接 讀入 子類 提供的 內存
+			boost::system::error_code e0;
+			std::size_t available = s->socket().available(e0);
+			try
+			{
+				mutable_buffers_t buffers;
+				if(!e0 && available && on_prepare(s,buffers))
+				{
+					std::size_t n = s->socket().read_some(buffers,e0);
+					if(!e0 && n)
+					{
+						//只有 讀到 數據 才 重新 計時 虛假的 可讀 通知 不影響 idle 超時
+						touch_recv(s);
+					}
+					if(e0 || !on_commit(s,n))
+					{
+						post_recv_close(s);
+						return;
+					}
+					post_recv(s,bytes_spt());
+					return;
+				}
+			}
+			catch(const std::bad_alloc&)
+			{
+				post_recv_close(s);
+				return;
+			}
+
+			//借用 當前線程 的 recv 緩衝區
+			k0::bytes::bytes_t* buffer = borrow_recv_buffer();
+			if(!buffer)
+			{
+				post_recv_close(s);
+				return;
+			}
+			std::size_t n = s->socket().read_some(boost::asio::buffer(buffer->get(),buffer->size()),e0);
+			if(e0 == boost::asio::error::would_block || e0 == boost::asio::error::try_again)
+			{
+				//虛假的 可讀 通知
+				return_recv_buffer(buffer);
+				post_wait(s);
+				return;
+			}
+			if(!e0 && n)
+			{
+				touch_recv(s);
+			}
+			bool ok = !e0 && on_recv(s,buffer->get(),n);
+			return_recv_buffer(buffer);
+			if(!ok)
+			{
+				post_recv_close(s);
+				return;
+			}
+			post_recv(s,bytes_spt());
+		}
+		/**
+		*	\brief 從 當前線程 借出 recv 緩衝區 沒有 則 創建
+		*	\return 失敗 返回 NULL
+		*/
+		k0::bytes::bytes_t* borrow_recv_buffer()
+		{
+			k0::bytes::bytes_t* buffer = _recv_buffers.release();
+			if(buffer)
+			{
+				return buffer;
+			}
+			try
+			{
+				buffer = new k0::bytes::bytes_t(N);
+			}
+			catch(const std::bad_alloc&)
+			{
+				return NULL;
+			}
+			if(buffer->size() != N)
+			{
+				delete buffer;
+				return NULL;
+			}
+			return buffer;
+		}
+		/**
+		*	\brief 歸還 recv 緩衝區 (on_recv 中 又 借出了 緩衝區 時 直接 釋放)
+		*/
+		void return_recv_buffer(k0::bytes::bytes_t* buffer)
+		{
+			if(_recv_buffers.get())
+			{
+				delete buffer;
+				return;
+			}
+			_recv_buffers.reset(buffer);
+		}
+		/**
+		*	\brief recv 失敗 通知用戶 並 斷開連接
+		*
+		*	socket 只在 這裏 關閉 其它線程 通過 enter_open 使用 socket 時 等待 它們 離開
+		*/
+		void post_recv_close(socket_spt s)
+		{
+			if(!s->mark_closed())
+			{
+				return;
+			}
+
+			//通知 用戶
+			on_close(s);
+
+			//斷開 連接
+			boost::system::error_code e0;
+			s->socket().close(e0);
+
+			//停止 計時 釋放 時間輪 持有的 引用
+			if(s->_wheel)
+			{
+				s->_wheel->close(s->_timer);
+			}
+
+			//減少 conns 計數
+			_conns.fetch_sub(1,boost::memory_order_relaxed);
+
+			post_accepts();
+		}
+		/**
+		*	\brief 主動 斷開 連接 可以 在 任意線程 調用
+		*
+		*	只 shutdown socket 正在進行的 recv 收到 錯誤 後 由 recv 處理器 關閉\n
+		*	recv 暫停 時 沒有 recv 處理器 投遞 post_recv_close 到 socket 所屬的 io_service
+		*/
+		void post_close(socket_spt& s)
+		{
+			if(s->enter_open())
+			{
+				boost::system::error_code e0;
+				s->socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both,e0);
+				s->leave_open();
+			}
+			if(s->_paused.exchange(false))
+			{
+				s->io_service().post(boost::bind(&server_t::post_recv_close,this,s));
+			}
+		}
+		/**
+		*	\brief 記錄 recv 時間
+		*/
+		inline void touch_recv(socket_spt& s)
+		{
+			if(s->_wheel)
+			{
+				s->_recv_tick.store(s->_wheel->now(),boost::memory_order_relaxed);
+			}
+		}
+		/**
+		*	\brief 毫秒 轉爲 tick 向上 取整
+		*/
+		inline k0::uint64_t to_ticks(const std::size_t ms)const
+		{
+			std::size_t tick = _tick.load(boost::memory_order_relaxed);
+			return (ms + tick - 1) / tick;
+		}
+		/**
+		*	\brief 計算 下一次 需要 檢查 超時 的 tick
+		*
+		*	recv send 只 更新 時間 不 移動 定時器 到期時 再 檢查 是否 真的 超時\n
+		*	read 超時 不生效 (沒有 未完成的 消息) 時 每 read 毫秒 檢查一次
+		*
+		*	\param which 輸出 最早的 超時 類型
+		*	\return 沒有 設置 超時 返回 false
+		*/
+		bool next_timeout(socket_spt& s,k0::uint64_t& expire,timeout_t& which)
+		{
+			bool ok = false;
+			std::size_t read = _read.load(boost::memory_order_relaxed);
+			std::size_t idle_ms = _idle.load(boost::memory_order_relaxed);
+			if(read)
+			{
+				which = timeout_read;
+				expire = s->_partial ? s->_recv_tick + to_ticks(read) : s->_wheel->now() + to_ticks(read);
+				ok = true;
+			}
+			if(idle_ms)
+			{
+				k0::uint64_t recv = s->_recv_tick;
+				k0::uint64_t send = s->_send_tick;
+				k0::uint64_t idle = (recv > send ? recv : send) + to_ticks(idle_ms);
+				if(!ok || idle < expire)
+				{
+					which = timeout_idle;
+					expire = idle;
+					ok = true;
+				}
+			}
+			return ok;
+		}
+		/**
+		*	\brief 返回 事件循環 的 序號 共享模式 下 只有 一個 事件循環
+		*/
+		std::size_t loop_of(io_service_t& io_s)
+		{
+			if(_pool)
+			{
+				for(std::size_t i=0;i<_pool->size();++i)
+				{
+					if(&_pool->get(i) == &io_s)
+					{
+						return i;
+					}
+				}
+			}
+			return 0;
+		}
+		/**
+		*	\brief 新連接 開始 計時
+		*/
+		void arm_timeout(socket_spt& s)
+		{
+			if(!_tick.load(boost::memory_order_relaxed)
+				|| !(_idle.load(boost::memory_order_relaxed) || _read.load(boost::memory_order_relaxed)))
+			{
+				return;
+			}
+			if(_wheels.empty())
+			{
+				return;
+			}
+			s->_wheel = _wheels[loop_of(s->io_service())];
+			k0::uint64_t now = s->_wheel->now();
+			s->_recv_tick = now;
+			s->_send_tick = now;
+			k0::uint64_t expire;
+			timeout_t which;
+			if(next_timeout(s,expire,which))
+			{
+				s->_wheel->arm(s->_timer,s,expire > now ? expire - now : 1);
+			}
+		}
+		/**
+		*	\brief 從 現在 開始 等待 第 i 個 時間輪 的 第一個 tick
+		*/
+		void start_tick(const std::size_t i)
+		{
+			_tickers[i]->expires_from_now(boost::chrono::milliseconds(_tick.load(boost::memory_order_relaxed)));
+			post_tick(i);
+		}
+		/**
+		*	\brief 異步 等待 第 i 個 時間輪 的 下一個 tick
+		*/
+		void post_tick(const std::size_t i)
+		{
+			_tickers[i]->async_wait(boost::bind(&server_t::post_tick_handler,
+				this,
+				boost::asio::placeholders::error,
+				i)
+			);
+		}
+		/**
+		*	\brief 前進 時間輪 並 檢查 到期的 連接
+		*/
+		void post_tick_handler(const boost::system::error_code& e,const std::size_t i)
+		{
+			if(e)
+			{
+				return;
+			}
+			//從 上次 到期時間 計算 下一個 tick 不累積 處理器 延遲 落後 時 每個 錯過的 tick 前進一次
+			steady_timer_t* ticker = _tickers[i];
+			boost::chrono::milliseconds tick(_tick.load(boost::memory_order_relaxed));
+			steady_timer_t::time_point next = ticker->expires_at() + tick;
+			steady_timer_t::time_point now = steady_clock_t::now();
+			std::size_t ticks = 1;
+			while(next <= now)
+			{
+				next += tick;
+				++ticks;
+			}
+			std::vector<std::shared_ptr<void> > expired;
+			try
+			{
+				for(std::size_t j=0;j<ticks;++j)
+				{
+					_wheels[i]->advance(expired);
+				}
+			}
+			catch(const std::bad_alloc&)
+			{
+			}
+			for(std::size_t j=0;j<expired.size();++j)
+			{
+				socket_spt s = std::static_pointer_cast<socket_t>(expired[j]);
+				expire_timeout(s);
+			}
+			ticker->expires_at(next);
+			post_tick(i);
+		}
+		/**
+		*	\brief 定時器 到期 真的 超時 並且 on_timeout 返回 true 時 斷開連接
+		*
+		*	在 時間輪 的 線程 執行 期間 enter_open 持有 socket recv 處理器 不會 關閉 socket\n
+		*	連接 已經 關閉 時 不回調 on_timeout 保證 on_timeout 不會 在 on_close 之後
+		*/
+		void expire_timeout(socket_spt& s)
+		{
+			if(s->_wheel->closed(s->_timer) || !s->enter_open())
+			{
+				return;
+			}
+			if(check_timeout(s))
+			{
+				post_close(s);
+			}
+			s->leave_open();
+		}
+		/**
+		*	\brief 真的 超時 時 回調 on_timeout 否則 重新 計時
+		*	\return true 需要 斷開連接
+		*/
+		bool check_timeout(socket_spt& s)
+		{
+			timing_wheel_t* wheel = s->_wheel;
+			k0::uint64_t now = wheel->now();
+			k0::uint64_t expire;
+			timeout_t which;
+			if(!next_timeout(s,expire,which))
+			{
+				return false;
+			}
+			if(expire > now)
+			{
+				//期間 有 recv send
+				wheel->arm(s->_timer,s,expire - now);
+				return false;
+			}
+			if(!on_timeout(s,which))
+			{
+				//重新 計時
+				s->_recv_tick = now;
+				s->_send_tick = now;
+				if(next_timeout(s,expire,which))
+				{
+					wheel->arm(s->_timer,s,expire > now ? expire - now : 1);
+				}
+				return false;
+			}
+			return true;
+		}
+    
+	public:
+        /**
+		*	\brief 返回 工作 線程 數量
+		*/
+        inline std::size_t work_threads()const
+        {
+            return _pool ? _pool->size() : _threads.size();
+        }
+
         /**
 		*	\brief 等待 線程 停止 工作
 		*/
         virtual void join()
         {
             _threads.join_all();
+			if(_pool)
+			{
+				_pool->join();
+			}
         }
 		/**
 		*	\brief 停止 工作
@@ -409,13 +1284,18 @@ namespace tcp
         virtual void stop()
         {
             _io_s.stop();
+			if(_pool)
+			{
+				_pool->stop();
+			}
         }
 		/**
 		*	\brief 向 客戶端 發送 隊列 寫入一條 發送 數據
+		*	\return 同 push_send(socket_spt,bytes_spt) 超過 高水位 時 也 返回 false
 		*/
         bool push_send(socket_spt s,const byte_t* bytes,std::size_t n)
         {
-            if(!s->socket().is_open())
+            if(s->closed())
             {
                 return false;
             }
@@ -424,120 +1304,321 @@ namespace tcp
             bytes_spt buffer;
             try
             {
-                buffer = boost::make_shared<k0::bytes::bytes_t>(n);
+                buffer = k0::bytes::make_bytes(n);
             }
             catch(const std::bad_alloc&)
             {
                 //創建 失敗
                 return false;
             }
-            //copy 待write 數據
+            if(buffer->size() != n)
+            {
+                //數組 分配 失敗
+                return false;
+            }
+            //copy 待write 數據 小數據 保存在 small_bytes_t 的 內聯存儲 中
             std::copy(bytes,bytes+n,buffer->get());
 
             return push_send(s,buffer);
         }
         /**
 		*	\brief 向 客戶端 發送 隊列 寫入一條 發送 數據
+		*
+		*	設置了 水位 時 超過 高水位 也 返回 false 此時 數據 沒有 加入隊列 應該 等待 on_writable 而不是 斷開連接\n
+		*	需要 區分 連接 已關閉 和 超過 高水位 時 使用 try_send
+		*	\return false 連接 已關閉 內存 不足 或 超過 高水位
 		*/
 		bool push_send(socket_spt s,bytes_spt buffer)
         {
-            if(!s->socket().is_open())
+			return try_send(s,buffer) == send_ok;
+        }
+		/**
+		*	\brief 向 客戶端 發送 隊列 寫入一條 發送 數據
+		*	\return 返回 send_would_block 時 數據 沒有 加入隊列 應該 等待 on_writable
+		*/
+		send_status_t try_send(socket_spt s,bytes_spt buffer)
+        {
+            if(s->closed())
             {
-                return false;
+                return send_closed;
             }
+			if(over_high(s) && block_send(s))
+			{
+				return send_would_block;
+			}
 
-            boost::mutex::scoped_lock lock(s->_mutex);
-            std::list<bytes_spt>& datas = s->_datas;
-            bool& wait = s->_wait;
-
-            //等待 上次 write 完成 直接 push
-            if(wait)
-            {
-                datas.push_back(buffer);
-                return true;
-            }
-            else
+            try
             {
-                //需要 發送 數據
-
-                if(datas.empty())
+                if(s->push_send(buffer))
                 {
-                    //直接 write
-                    post_send(s,buffer);
-                    wait = true;
-                    return true;
+                    //沒有 write 在進行 由 當前線程 開始 write
+                    send_next(s);
                 }
-                else
-                {
-                    try
-                    {
-                        //寫入 隊列
-                        datas.push_back(buffer);
-
-                        //發送 隊列 首數據
-                        buffer = datas.front();
-                        datas.pop_front();
-                        post_send(s,buffer);
-                        wait = true;
-                        return true;
-                    }
-                    catch(const std::bad_alloc&)
-                    {
-                        return false;
-                    }
-
-                }
-
             }
-            return false;
+            catch(const std::bad_alloc&)
+            {
+                return send_error;
+            }
+            return send_ok;
         }
     protected:
 		/**
-		*	\brief 異步 發送 數據
+		*	\brief 異步 發送 s->_batch 中 還未 寫出的 數據
+		*
+		*	多條 數據 合併爲 一個 buffer 序列 一次 gather write\n
+		*	可能 在 用戶線程 調用 socket 已經 關閉 時 停止 write
 		*/
-        inline void post_send(socket_spt s,bytes_spt buffer)
+        inline void post_send(socket_spt s)
         {
-            s->socket().async_write_some(boost::asio::buffer(buffer->get(),buffer->size()),
+			if(!s->enter_open())
+			{
+				return;
+			}
+            s->socket().async_write_some(s->send_buffers(),
                 boost::bind(&server_t::post_send_handler,
                 this,
                 boost::asio::placeholders::error,
-                s,
-                buffer
+                boost::asio::placeholders::bytes_transferred,
+                s
                 )
             );
+			s->leave_open();
         }
         /**
 		*	\brief 發送 處理器
 		*/
-		void post_send_handler(const boost::system::error_code& e,socket_spt s,bytes_spt buffer)
+		void post_send_handler(const boost::system::error_code& e,std::size_t n,socket_spt s)
         {
             if(e)
             {
-                //send 錯誤 直接 關閉
-                if(s->socket().is_open())
-                {
-                    boost::system::error_code e0;
-                    s->socket().close(e0);
-                }
+                //send 錯誤 斷開 連接
+				post_close(s);
                 return;
             }
 
-			//通知 客戶
-            on_send(s,buffer);
-			
-            boost::mutex::scoped_lock lock(s->_mutex);
-			std::list<bytes_spt>& datas = s->_datas;
-            if(datas.empty())
+			if(!s->written(n))
+			{
+				//只寫出了 部分 數據 繼續 寫出 剩餘部分
+				post_send(s);
+				return;
+			}
+
+			//通知 客戶 每條 數據 調用一次 on_send
+			std::vector<bytes_spt>& batch = s->_batch;
+			n = batch.size();
+			for(std::size_t i=0;i<n;++i)
+			{
+				on_send(s,batch[i]);
+			}
+			batch.clear();
+
+			if(s->_wheel)
+			{
+				s->_send_tick.store(s->_wheel->now(),boost::memory_order_relaxed);
+			}
+			bool more = s->sent(n);
+			if(_marks.enabled())
+			{
+				resume(s);
+			}
+            if(more)
             {
-                //接受 數據 發送
-                s->_wait = false;
-                return;
+                //繼續 發送 數據
+                send_next(s);
             }
-            //繼續 發送 數據
-            buffer = datas.front();
-            datas.pop_front();
-            post_send(s,buffer);
         }
+		/**
+		*	\brief 發送隊列 是否 達到 高水位
+		*/
+		inline bool over_high(socket_spt& s)const
+		{
+			std::size_t bytes = _marks.high_bytes.load(boost::memory_order_relaxed);
+			std::size_t count = _marks.high_count.load(boost::memory_order_relaxed);
+			return (bytes && s->_bytes >= bytes)
+				|| (count && s->_pending >= count);
+		}
+		/**
+		*	\brief 發送隊列 是否 不超過 低水位
+		*/
+		inline bool under_low(socket_spt& s)const
+		{
+			return (!_marks.high_bytes.load(boost::memory_order_relaxed) || s->_bytes <= _marks.low_bytes.load(boost::memory_order_relaxed))
+				&& (!_marks.high_count.load(boost::memory_order_relaxed) || s->_pending <= _marks.low_count.load(boost::memory_order_relaxed));
+		}
+		/**
+		*	\brief 標記 有 發送 被拒絕
+		*
+		*	先 標記 再 檢查 水位 write 完成後 先 更新 水位 再 檢查 標記 兩者 不會 同時 錯過 對方
+		*
+		*	\return false 隊列 已經 降到 低水位 不需要 拒絕
+		*/
+		bool block_send(socket_spt& s)
+		{
+			bool first = !s->_blocked.exchange(true);
+			if(under_low(s) && s->_blocked.exchange(false))
+			{
+				return false;
+			}
+			if(first)
+			{
+				arm_deadline(s);
+			}
+			return true;
+		}
+		/**
+		*	\brief 標記 recv 暫停 同 block_send
+		*	\return false 隊列 已經 降到 低水位 不需要 暫停
+		*/
+		bool pause_recv(socket_spt& s)
+		{
+			bool first = !s->_paused.exchange(true);
+			if(under_low(s) && s->_paused.exchange(false))
+			{
+				return false;
+			}
+			if(first)
+			{
+				arm_deadline(s);
+			}
+			return true;
+		}
+		/**
+		*	\brief write 完成後 隊列 降到 低水位 時 回調 on_writable 並 恢復 recv
+		*/
+		void resume(socket_spt& s)
+		{
+			if(!under_low(s))
+			{
+				return;
+			}
+			if(s->_blocked && s->_blocked.exchange(false))
+			{
+				on_writable(s);
+			}
+			if(s->_paused && s->_paused.exchange(false))
+			{
+				post_recv(s,bytes_spt());
+			}
+		}
+		/**
+		*	\brief 開始 計時 超過 deadline 仍未 降到 低水位 時 回調 on_slow
+		*
+		*	使用 socket 所屬 事件循環 的 timer_heap_t 連接 不 持有 定時器\n
+		*	已經 在 等待 時 只 更新 到期時間 由 處理器 重新 等待
+		*/
+		void arm_deadline(socket_spt& s)
+		{
+			std::size_t deadline = _marks.deadline.load(boost::memory_order_relaxed);
+			if(!deadline)
+			{
+				return;
+			}
+			//新的 週期 覆蓋 之前的 到期時間
+			s->_deadline_at.store(deadline_now() + (k0::uint64_t)deadline * 1000);
+			if(!s->_deadline_armed.exchange(true) && !post_deadline(s))
+			{
+				s->_deadline_armed.store(false);
+			}
+		}
+		/**
+		*	\brief 等待 s->_deadline_at 只有 將 _deadline_armed 設置爲 true 的 線程 可以 調用
+		*	\return false 定時器 集合 已經 關閉 或 內存 不足 調用者 負責 清除 _deadline_armed
+		*/
+		bool post_deadline(socket_spt& s)
+		{
+			k0::uint64_t at = s->_deadline_at;
+			k0::uint64_t now = deadline_now();
+			//向上 取整 到 毫秒 不會 早於 到期時間
+			std::size_t delay = at > now ? (std::size_t)((at - now + 999) / 1000) : 0;
+			return _timers[loop_of(s->io_service())]->schedule(delay,0,
+				boost::bind(&server_t::post_deadline_handler,this,s)
+			) != 0;
+		}
+		void post_deadline_handler(socket_spt s)
+		{
+			if(wait_deadline(s))
+			{
+				return;
+			}
+			s->_deadline_armed.store(false);
+
+			//釋放 之前 arm_deadline 看到 定時器 在 等待 不會 投遞 在這裏 重新 檢查
+			if(stalled(s) && !s->_deadline_armed.exchange(true))
+			{
+				//新的 週期 在 處理器 檢查 之後 纔 開始 到期時間 可能 還沒有 寫入
+				k0::uint64_t at = deadline_now() + (k0::uint64_t)_marks.deadline.load(boost::memory_order_relaxed) * 1000;
+				if(s->_deadline_at < at)
+				{
+					s->_deadline_at.store(at);
+				}
+				if(!post_deadline(s))
+				{
+					s->_deadline_armed.store(false);
+				}
+			}
+		}
+		/**
+		*	\brief 定時器 到期 時 回調 on_slow 或 繼續 等待
+		*	\return true 重新 投遞了 定時器
+		*/
+		bool wait_deadline(socket_spt& s)
+		{
+			if(!stalled(s))
+			{
+				return false;
+			}
+			k0::uint64_t now = deadline_now();
+			if(s->_deadline_at > now)
+			{
+				//等待 期間 開始了 新的 週期
+				return post_deadline(s);
+			}
+			if(!s->enter_open())
+			{
+				return false;
+			}
+			bool slow = on_slow(s);
+			if(slow)
+			{
+				//斷開 慢速連接
+				post_close(s);
+			}
+			s->leave_open();
+			if(slow)
+			{
+				return false;
+			}
+			s->_deadline_at.store(now + (k0::uint64_t)_marks.deadline.load(boost::memory_order_relaxed) * 1000);
+			return post_deadline(s);
+		}
+		/**
+		*	\brief 連接 是否 因 超過 高水位 拒絕 發送 或 暫停 recv 並且 仍未 降到 低水位
+		*/
+		inline bool stalled(socket_spt& s)const
+		{
+			return _marks.deadline.load(boost::memory_order_relaxed) && (s->_blocked || s->_paused) && !under_low(s) && !s->closed();
+		}
+		/**
+		*	\brief 返回 deadline 使用的 當前時間 微秒 與 timer_heap_t 使用 同一個 單調時鐘
+		*/
+		static inline k0::uint64_t deadline_now()
+		{
+			return timer_heap_t::steady_now();
+		}
+		/**
+		*	\brief 取出 隊列中 已有的 數據 (受 KING_NET_TCP_SEND_BUFFERS 和 KING_NET_TCP_SEND_BUDGET 限制) 並 write
+		*
+		*	只在 負責 write 時 調用 有 生產者 還未 完成 入隊 時 投遞到 io 線程 稍後 重試
+		*/
+		void send_next(socket_spt s)
+		{
+			if(s->pop_sends())
+			{
+				post_send(s);
+				return;
+			}
+			s->io_service().post(boost::bind(&server_t::send_next,this,s));
+		}
 
     };
 
@@ -0,0 +1,245 @@
+//工作線程 的 數量 cpu 親和性 名稱 和 調度策略
+#ifndef KING_LIB_HEADER_NET_TCP_THREAD_CONFIG
+#define KING_LIB_HEADER_NET_TCP_THREAD_CONFIG
+
+#include <k0/core.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace k0
+{
+namespace net
+{
+namespace tcp
+{
+	/**
+	*	\brief 將 當前線程 綁定到 一組 cpu
+	*	\return 平臺 不支持 或 失敗 返回 false
+	*/
+	inline bool pin_thread(const std::vector<std::size_t>& cpus)
+	{
+		if(cpus.empty())
+		{
+			return false;
+		}
+#ifdef _WIN32
+		DWORD_PTR mask = 0;
+		for(std::size_t i=0;i<cpus.size();++i)
+		{
+			if(cpus[i] < sizeof(DWORD_PTR) * 8)
+			{
+				mask |= (DWORD_PTR)1 << cpus[i];
+			}
+		}
+		return mask && SetThreadAffinityMask(GetCurrentThread(),mask) != 0;
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(std::size_t i=0;i<cpus.size();++i)
+		{
+			if(cpus[i] < CPU_SETSIZE)
+			{
+				CPU_SET(cpus[i],&set);
+			}
+		}
+		return CPU_COUNT(&set) && pthread_setaffinity_np(pthread_self(),sizeof(set),&set) == 0;
+#else
+		return false;
+#endif
+	}
+	/**
+	*	\brief 將 當前線程 綁定到 指定 cpu
+	*	\return 平臺 不支持 或 失敗 返回 false
+	*/
+	inline bool pin_thread(const std::size_t cpu)
+	{
+		return pin_thread(std::vector<std::size_t>(1,cpu));
+	}
+
+	/**
+	*	\brief 工作線程 配置
+	*
+	*	每個 工作線程 啓動後 在 運行 io_service 前 調用 apply(i) i 爲 線程序號
+	*/
+	class thread_config_t
+	{
+	public:
+		/**
+		*	\brief 調度策略
+		*/
+		enum policy_t
+		{
+			/**
+			*	\brief 不修改 (SCHED_OTHER)
+			*/
+			sched_default = 0,
+			/**
+			*	\brief 實時 先進先出 (SCHED_FIFO 需要 權限) windows 下 爲 最高優先級
+			*/
+			sched_fifo,
+			/**
+			*	\brief 實時 時間片輪轉 (SCHED_RR 需要 權限) windows 下 爲 最高優先級
+			*/
+			sched_rr,
+			/**
+			*	\brief 批處理 (SCHED_BATCH) windows 下 爲 低優先級
+			*/
+			sched_batch,
+			/**
+			*	\brief 空閒時 運行 (SCHED_IDLE) windows 下 爲 最低優先級
+			*/
+			sched_idle
+		};
+
+		/**
+		*	\brief 線程數量 爲0 時 使用 各個 class 的 默認值
+		*/
+		std::size_t threads;
+		/**
+		*	\brief 每個線程 可以 運行的 cpu 第 i 個 線程 使用 affinity[i % affinity.size()]
+		*/
+		std::vector<std::vector<std::size_t> > affinity;
+		/**
+		*	\brief affinity 爲空 時 是否 將 第 i 個 線程 綁定到 第 i 個 cpu (超過 核心數 時 取模)
+		*/
+		bool pin;
+		/**
+		*	\brief 線程名 前綴 線程名 爲 name + 序號 (linux 下 最多 15 字符) 爲空 時 不修改
+		*/
+		std::string name;
+		/**
+		*	\brief 調度策略
+		*/
+		policy_t policy;
+		/**
+		*	\brief sched_fifo sched_rr 的 優先級 (1-99)
+		*/
+		int priority;
+
+		explicit thread_config_t(const std::size_t threads = 0)
+			:threads(threads),pin(false),policy(sched_default),priority(0)
+		{
+		}
+
+		/**
+		*	\brief 返回 n 個 線程 每個 綁定到 一個 cpu 的 配置
+		*/
+		static thread_config_t pinned(const std::size_t n = 0)
+		{
+			thread_config_t config(n);
+			config.pin = true;
+			return config;
+		}
+
+		/**
+		*	\brief 返回 線程數量 threads 爲0 時 返回 def
+		*/
+		inline std::size_t count(const std::size_t def)const
+		{
+			return threads ? threads : def;
+		}
+
+		/**
+		*	\brief 對 當前線程 應用 配置
+		*	\param i 線程 序號
+		*	\return 所有 設置 都成功 返回 true 失敗的 設置 被忽略
+		*/
+		bool apply(const std::size_t i)const
+		{
+			bool ok = true;
+			if(!affinity.empty())
+			{
+				ok = pin_thread(affinity[i % affinity.size()]) && ok;
+			}
+			else if(pin)
+			{
+				std::size_t cpus = boost::thread::hardware_concurrency();
+				ok = pin_thread(cpus ? i % cpus : i) && ok;
+			}
+			if(!name.empty())
+			{
+				ok = set_name(i) && ok;
+			}
+			if(policy != sched_default)
+			{
+				ok = set_policy() && ok;
+			}
+			return ok;
+		}
+	protected:
+		bool set_name(const std::size_t i)const
+		{
+#if defined(__linux__)
+			char str[16];
+			snprintf(str,sizeof(str),"%s%u",name.c_str(),(unsigned)i);
+			return pthread_setname_np(pthread_self(),str) == 0;
+#else
+			//windows 下 SetThreadDescription 需要 win10 不設置
+			return false;
+#endif
+		}
+		bool set_policy()const
+		{
+#ifdef _WIN32
+			int level = THREAD_PRIORITY_NORMAL;
+			switch(policy)
+			{
+			case sched_fifo:
+			case sched_rr:
+				level = THREAD_PRIORITY_TIME_CRITICAL;
+				break;
+			case sched_batch:
+				level = THREAD_PRIORITY_BELOW_NORMAL;
+				break;
+			case sched_idle:
+				level = THREAD_PRIORITY_IDLE;
+				break;
+			default:
+				break;
+			}
+			return SetThreadPriority(GetCurrentThread(),level) != 0;
+#elif defined(__linux__)
+			int native = SCHED_OTHER;
+			sched_param param;
+			param.sched_priority = 0;
+			switch(policy)
+			{
+			case sched_fifo:
+				native = SCHED_FIFO;
+				param.sched_priority = priority;
+				break;
+			case sched_rr:
+				native = SCHED_RR;
+				param.sched_priority = priority;
+				break;
+			case sched_batch:
+				native = SCHED_BATCH;
+				break;
+			case sched_idle:
+				native = SCHED_IDLE;
+				break;
+			default:
+				break;
+			}
+			return pthread_setschedparam(pthread_self(),native,&param) == 0;
+#else
+			return false;
+#endif
+		}
+	};
+};
+};
+};
+
+#endif // KING_LIB_HEADER_NET_TCP_THREAD_CONFIG
@@ -0,0 +1,530 @@
+//綁定到 事件循環 的 通用 定時器 4叉 最小堆
+#ifndef KING_LIB_HEADER_NET_TCP_TIMER_HEAP
+#define KING_LIB_HEADER_NET_TCP_TIMER_HEAP
+
+#include "type.hpp"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/chrono.hpp>
+
+namespace k0
+{
+namespace net
+{
+namespace tcp
+{
+	/**
+	*	\brief 定時器 id 0 爲 無效
+	*
+	*	高 12 位 事件循環 序號 中間 20 位 槽的 代數 低 32 位 槽 序號
+	*/
+	typedef k0::uint64_t timer_id_t;
+	/**
+	*	\brief 定時器 使用的 單調時鐘 不受 系統時間 調整 影響
+	*/
+	typedef boost::chrono::steady_clock steady_clock_t;
+	/**
+	*	\brief 按 單調時鐘 等待的 asio 定時器
+	*/
+	typedef boost::asio::basic_waitable_timer<steady_clock_t> steady_timer_t;
+
+	/**
+	*	\brief 綁定到 一個 事件循環 的 定時器 集合
+	*
+	*	定時器 按 到期時間 存放在 4叉 最小堆 中 一個 節點的 4 個 子節點 連續 存放 (64 字節) 堆 比 二叉堆 淺 一半\n
+	*	堆中 只 移動 16 字節的 (到期時間,槽) 回調 保存在 槽中 槽 記錄 自己 在堆中的 位置 以便 O(log n) 取消\n
+	*	整個 集合 只 使用 一個 steady_timer_t 等待 堆頂 回調 在 事件循環 的 線程中 執行\n
+	*	所有 操作 以 一個 mutex 保護 可以 從 任意 線程 調用
+	*/
+	class timer_heap_t
+	{
+	public:
+		/**
+		*	\brief 定時器 回調
+		*/
+		typedef boost::function<void()> callback_ft;
+	protected:
+		/**
+		*	\brief 堆 節點
+		*/
+		struct node_t
+		{
+			k0::uint64_t due;
+			k0::uint32_t slot;
+		};
+		enum
+		{
+			slot_free = 0,
+			slot_armed,
+			slot_firing
+		};
+		/**
+		*	\brief 定時器 槽
+		*/
+		struct slot_t
+		{
+			callback_ft fn;
+			/**
+			*	\brief 週期 微秒 0 只執行一次
+			*/
+			k0::uint64_t period;
+			/**
+			*	\brief 在堆中的 位置 空閒時 爲 下一個 空閒槽
+			*/
+			k0::uint32_t pos;
+			/**
+			*	\brief 代數 槽 每次 重用 加1 使 舊的 id 失效
+			*/
+			k0::uint32_t gen;
+			/**
+			*	\brief slot_free slot_armed slot_firing
+			*/
+			k0::byte_t state;
+			/**
+			*	\brief 執行中 被 取消
+			*/
+			bool cancelled;
+
+			slot_t():period(0),pos(0),gen(0),state(slot_free),cancelled(false)
+			{
+			}
+		};
+		/**
+		*	\brief 執行中的 定時器
+		*/
+		struct fired_t
+		{
+			k0::uint32_t slot;
+			k0::uint64_t due;
+			callback_ft fn;
+		};
+
+		io_service_t& _io_s;
+		steady_timer_t _timer;
+		/**
+		*	\brief 計時 起點 單調時鐘 微秒
+		*/
+		k0::uint64_t _base;
+		std::vector<node_t> _heap;
+		std::vector<slot_t> _slots;
+		/**
+		*	\brief 第一個 空閒槽 沒有 時 爲 npos
+		*/
+		k0::uint32_t _free;
+		/**
+		*	\brief _timer 等待的 到期時間 沒有 等待 時 爲 最大值
+		*/
+		k0::uint64_t _armed;
+		/**
+		*	\brief id 中的 事件循環 序號
+		*/
+		k0::uint64_t _tag;
+		boost::mutex _mutex;
+		/**
+		*	\brief 已投遞 還未 返回的 異步回調 數量
+		*/
+		boost::atomic<std::size_t> _handlers;
+		boost::atomic<bool> _closed;
+
+		static const k0::uint32_t npos = 0xffffffff;
+		static const k0::uint32_t gen_mask = 0xfffff;
+	public:
+		/**
+		*	\param io_s 執行 回調 的 事件循環
+		*	\param index 事件循環 序號 記錄在 id 中 見 index_of
+		*/
+		explicit timer_heap_t(io_service_t& io_s,std::size_t index = 0)
+			:_io_s(io_s),
+			_timer(io_s),
+			_base(steady_now()),
+			_free(npos),
+			_armed(~k0::uint64_t(0)),
+			_tag((k0::uint64_t)(index & 0xfff) << 52),
+			_handlers(0),
+			_closed(false)
+		{
+		}
+	private:
+		timer_heap_t(const timer_heap_t&);
+		timer_heap_t& operator=(const timer_heap_t&);
+	public:
+		/**
+		*	\brief 返回 id 中的 事件循環 序號
+		*/
+		static inline std::size_t index_of(const timer_id_t id)
+		{
+			return (std::size_t)(id >> 52);
+		}
+		/**
+		*	\brief 返回 單調時鐘 的 當前時間 微秒
+		*/
+		static inline k0::uint64_t steady_now()
+		{
+			return (k0::uint64_t)boost::chrono::duration_cast<boost::chrono::microseconds>(steady_clock_t::now().time_since_epoch()).count();
+		}
+		/**
+		*	\brief 返回 等待中的 定時器 數量
+		*/
+		inline std::size_t size()
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			return _heap.size();
+		}
+		/**
+		*	\brief 在 delay 毫秒 之後 執行 fn
+		*	\param period 不爲0 時 之後 每 period 毫秒 執行一次 直到 cancel
+		*	\return 失敗 返回 0
+		*/
+		timer_id_t schedule(const std::size_t delay,const std::size_t period,const callback_ft& fn)
+		{
+			if(_closed)
+			{
+				return 0;
+			}
+			k0::uint64_t due = now() + (k0::uint64_t)delay * 1000;
+			timer_id_t id = 0;
+			bool rearm = false;
+			try
+			{
+				//在 鎖外 複製 回調
+				callback_ft f(fn);
+
+				boost::mutex::scoped_lock lock(_mutex);
+				k0::uint32_t slot = acquire();
+				if(slot == npos)
+				{
+					return 0;
+				}
+				slot_t& t = _slots[slot];
+				t.fn.swap(f);
+				t.period = (k0::uint64_t)period * 1000;
+				t.cancelled = false;
+				t.state = slot_armed;
+				t.gen = (t.gen + 1) & gen_mask;
+				if(!t.gen)
+				{
+					t.gen = 1;
+				}
+				id = _tag | ((k0::uint64_t)t.gen << 32) | slot;
+
+				std::size_t i = _heap.size() - 1;
+				_heap[i].due = due;
+				_heap[i].slot = slot;
+				sift_up(i);
+
+				//新的 堆頂 早於 正在等待的 時間 需要 在 事件循環 中 重新 等待
+				if(due < _armed)
+				{
+					_armed = due;
+					rearm = true;
+				}
+			}
+			catch(const std::bad_alloc&)
+			{
+				return 0;
+			}
+			if(rearm)
+			{
+				post_rearm();
+			}
+			return id;
+		}
+		/**
+		*	\brief 取消 定時器 正在執行的 週期 定時器 在 本次 執行 後 停止
+		*	\return 定時器 不存在 或 已經 執行 返回 false
+		*/
+		bool cancel(const timer_id_t id)
+		{
+			k0::uint32_t slot = (k0::uint32_t)id;
+			k0::uint32_t gen = (k0::uint32_t)(id >> 32) & gen_mask;
+			//在 鎖外 釋放 回調
+			callback_ft fn;
+			boost::mutex::scoped_lock lock(_mutex);
+			if(slot >= _slots.size())
+			{
+				return false;
+			}
+			slot_t& t = _slots[slot];
+			if(t.gen != gen || t.state == slot_free)
+			{
+				return false;
+			}
+			if(t.state == slot_firing)
+			{
+				if(!t.period || t.cancelled)
+				{
+					return false;
+				}
+				t.cancelled = true;
+				return true;
+			}
+			remove(t.pos);
+			fn.swap(t.fn);
+			release(slot);
+			return true;
+		}
+		/**
+		*	\brief 停止 所有 定時器 並 等待 已投遞的 回調 返回
+		*
+		*	只在 事件循環 仍然 運行 時 需要 (例如 附加到 io_pool_t 的 client) 不能在 事件循環 的 線程中 調用\n
+		*	事件循環 已經 停止 時 直接 析構 即可
+		*/
+		void close()
+		{
+			if(_closed.exchange(true))
+			{
+				return;
+			}
+			{
+				boost::mutex::scoped_lock lock(_mutex);
+				boost::system::error_code e;
+				_timer.cancel(e);
+			}
+			while(_handlers.load(boost::memory_order_acquire))
+			{
+				boost::this_thread::yield();
+			}
+		}
+	protected:
+		/**
+		*	\brief 返回 從 _base 開始的 微秒數
+		*/
+		inline k0::uint64_t now()const
+		{
+			return steady_now() - _base;
+		}
+		/**
+		*	\brief 在 堆尾 增加一個 節點 並 返回 一個 空閒槽
+		*	\exception std::bad_alloc
+		*/
+		k0::uint32_t acquire()
+		{
+			_heap.push_back(node_t());
+			if(_free != npos)
+			{
+				k0::uint32_t slot = _free;
+				_free = _slots[slot].pos;
+				return slot;
+			}
+			if(_slots.size() >= npos)
+			{
+				_heap.pop_back();
+				return npos;
+			}
+			try
+			{
+				_slots.push_back(slot_t());
+			}
+			catch(const std::bad_alloc&)
+			{
+				_heap.pop_back();
+				throw;
+			}
+			return (k0::uint32_t)(_slots.size() - 1);
+		}
+		/**
+		*	\brief 歸還 槽
+		*/
+		inline void release(const k0::uint32_t slot)
+		{
+			slot_t& t = _slots[slot];
+			t.state = slot_free;
+			t.pos = _free;
+			_free = slot;
+		}
+		inline void place(const std::size_t i,const node_t& node)
+		{
+			_heap[i] = node;
+			_slots[node.slot].pos = (k0::uint32_t)i;
+		}
+		void sift_up(std::size_t i)
+		{
+			node_t node = _heap[i];
+			while(i)
+			{
+				std::size_t parent = (i - 1) / 4;
+				if(_heap[parent].due <= node.due)
+				{
+					break;
+				}
+				place(i,_heap[parent]);
+				i = parent;
+			}
+			place(i,node);
+		}
+		void sift_down(std::size_t i)
+		{
+			node_t node = _heap[i];
+			std::size_t size = _heap.size();
+			while(true)
+			{
+				std::size_t child = i * 4 + 1;
+				if(child >= size)
+				{
+					break;
+				}
+				std::size_t end = child + 4 < size ? child + 4 : size;
+				std::size_t min = child;
+				for(std::size_t j=child+1;j<end;++j)
+				{
+					if(_heap[j].due < _heap[min].due)
+					{
+						min = j;
+					}
+				}
+				if(node.due <= _heap[min].due)
+				{
+					break;
+				}
+				place(i,_heap[min]);
+				i = min;
+			}
+			place(i,node);
+		}
+		/**
+		*	\brief 從 堆中 移除 位置 i 的 節點
+		*/
+		void remove(const std::size_t i)
+		{
+			node_t last = _heap.back();
+			_heap.pop_back();
+			if(i < _heap.size())
+			{
+				place(i,last);
+				sift_down(i);
+				sift_up(_slots[last.slot].pos);
+			}
+		}
+		void post_rearm()
+		{
+			try
+			{
+				_handlers.fetch_add(1,boost::memory_order_relaxed);
+				_io_s.post(boost::bind(&timer_heap_t::rearm_handler,this));
+			}
+			catch(const std::bad_alloc&)
+			{
+				_handlers.fetch_sub(1,boost::memory_order_relaxed);
+				//下次 schedule 時 重試
+				boost::mutex::scoped_lock lock(_mutex);
+				_armed = ~k0::uint64_t(0);
+			}
+		}
+		void rearm_handler()
+		{
+			handler_guard_t guard(_handlers);
+			if(_closed)
+			{
+				return;
+			}
+			arm();
+		}
+		/**
+		*	\brief 等待 堆頂 到期
+		*/
+		void arm()
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			if(_closed || _heap.empty())
+			{
+				_armed = ~k0::uint64_t(0);
+				return;
+			}
+			_armed = _heap[0].due;
+			k0::uint64_t n = now();
+			//steady_timer_t 不是 線程安全的 在 鎖內 操作
+			_timer.expires_from_now(boost::chrono::microseconds(_armed > n ? _armed - n : 0));
+			_handlers.fetch_add(1,boost::memory_order_relaxed);
+			_timer.async_wait(boost::bind(&timer_heap_t::post_wait_handler,
+				this,
+				boost::asio::placeholders::error)
+			);
+		}
+		void post_wait_handler(const boost::system::error_code& e)
+		{
+			handler_guard_t guard(_handlers);
+			if(e || _closed)
+			{
+				return;
+			}
+			fire();
+			arm();
+		}
+		/**
+		*	\brief 執行 所有 到期的 定時器
+		*/
+		void fire()
+		{
+			//回調 在 fired 析構 時 於 鎖外 釋放
+			std::vector<fired_t> fired;
+			k0::uint64_t n = now();
+			{
+				boost::mutex::scoped_lock lock(_mutex);
+				while(!_heap.empty() && _heap[0].due <= n)
+				{
+					try
+					{
+						fired.push_back(fired_t());
+					}
+					catch(const std::bad_alloc&)
+					{
+						//剩下的 等 下次
+						break;
+					}
+					node_t top = _heap[0];
+					remove(0);
+					slot_t& t = _slots[top.slot];
+					t.state = slot_firing;
+					fired.back().slot = top.slot;
+					fired.back().due = top.due;
+					fired.back().fn.swap(t.fn);
+				}
+			}
+
+			for(std::size_t i=0;i<fired.size();++i)
+			{
+				fired[i].fn();
+			}
+
+			boost::mutex::scoped_lock lock(_mutex);
+			for(std::size_t i=0;i<fired.size();++i)
+			{
+				k0::uint32_t slot = fired[i].slot;
+				slot_t& t = _slots[slot];
+				if(!t.period || t.cancelled || _closed)
+				{
+					release(slot);
+					continue;
+				}
+				//週期 定時器 按 上次 到期時間 累加 落後 太多 時 不補 執行
+				k0::uint64_t due = fired[i].due + t.period;
+				if(due <= n)
+				{
+					due = n + t.period;
+				}
+				try
+				{
+					_heap.push_back(node_t());
+				}
+				catch(const std::bad_alloc&)
+				{
+					release(slot);
+					continue;
+				}
+				t.fn.swap(fired[i].fn);
+				t.state = slot_armed;
+				std::size_t j = _heap.size() - 1;
+				_heap[j].due = due;
+				_heap[j].slot = slot;
+				sift_up(j);
+			}
+		}
+	};
+};
+};
+};
+
+#endif // KING_LIB_HEADER_NET_TCP_TIMER_HEAP
@@ -0,0 +1,275 @@
+//每個 事件循環 一個 的 哈希時間輪 用於 連接 超時
+#ifndef KING_LIB_HEADER_NET_TCP_TIMING_WHEEL
+#define KING_LIB_HEADER_NET_TCP_TIMING_WHEEL
+
+#include <k0/core.hpp>
+
+#include <memory>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+/**
+*	\brief 時間輪 默認 槽數 (必須是 2 的冪)
+*/
+#ifndef KING_NET_TCP_WHEEL_SLOTS
+#define KING_NET_TCP_WHEEL_SLOTS 512
+#endif
+
+namespace k0
+{
+namespace net
+{
+namespace tcp
+{
+	/**
+	*	\brief 時間輪 節點 嵌入到 需要 定時的 對象中
+	*
+	*	掛在 輪上 時 持有 所屬對象 的 強引用 到期 或 取消 時 釋放
+	*/
+	class wheel_node_t
+	{
+	public:
+		/**
+		*	\brief 槽內 雙向鏈表 未掛在 輪上 時 爲 NULL
+		*/
+		wheel_node_t* _prev;
+		wheel_node_t* _next;
+		/**
+		*	\brief 到期的 tick
+		*/
+		k0::uint64_t _expire;
+		/**
+		*	\brief 所屬對象
+		*/
+		std::shared_ptr<void> _owner;
+		/**
+		*	\brief close 之後 不能 再 arm
+		*/
+		bool _closed;
+
+		wheel_node_t():_prev(NULL),_next(NULL),_expire(0),_closed(false)
+		{
+		}
+		/**
+		*	\brief 是否 掛在 輪上
+		*/
+		inline bool linked()const
+		{
+			return _prev != NULL;
+		}
+	};
+
+	/**
+	*	\brief 哈希時間輪
+	*
+	*	到期時間 按 tick 取模 放入 槽中 arm cancel 都是 O(1)\n
+	*	advance 每次 前進一個 tick 只 檢查 當前槽 超過 一圈的 節點 留在 槽中 等待 下一圈\n
+	*	所有 操作 以 一個 mutex 保護 分片模式 下 每個 時間輪 只被 一個 線程 使用 不會 競爭
+	*/
+	class timing_wheel_t
+	{
+	protected:
+		/**
+		*	\brief 每個 槽 的 鏈表頭
+		*/
+		std::vector<wheel_node_t> _slots;
+		/**
+		*	\brief 槽數 - 1
+		*/
+		std::size_t _mask;
+		/**
+		*	\brief 當前 tick
+		*/
+		boost::atomic<k0::uint64_t> _tick;
+		/**
+		*	\brief 掛在 輪上的 節點數
+		*/
+		std::size_t _size;
+		boost::mutex _mutex;
+	public:
+		/**
+		*	\param slots 槽數 不是 2 的冪 時 向上 取整
+		*	\exception std::bad_alloc
+		*/
+		explicit timing_wheel_t(std::size_t slots = KING_NET_TCP_WHEEL_SLOTS)
+			:_mask(0),_tick(0),_size(0)
+		{
+			std::size_t n = 1;
+			while(n < slots)
+			{
+				n <<= 1;
+			}
+			_slots.resize(n);
+			_mask = n - 1;
+			for(std::size_t i=0;i<n;++i)
+			{
+				_slots[i]._prev = _slots[i]._next = &_slots[i];
+			}
+		}
+		/**
+		*	\brief 釋放 所有 節點 持有的 對象
+		*/
+		~timing_wheel_t()
+		{
+			clear();
+		}
+	private:
+		timing_wheel_t(const timing_wheel_t&);
+		timing_wheel_t& operator=(const timing_wheel_t&);
+	public:
+		/**
+		*	\brief 返回 當前 tick
+		*/
+		inline k0::uint64_t now()const
+		{
+			return _tick.load(boost::memory_order_relaxed);
+		}
+		/**
+		*	\brief 返回 掛在 輪上的 節點數
+		*/
+		inline std::size_t size()
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			return _size;
+		}
+		/**
+		*	\brief 在 ticks 個 tick 之後 到期 已經 掛在 輪上 時 移動到 新位置
+		*	\param owner 到期前 保持 的 對象 到期時 由 advance 返回
+		*	\return 節點 已經 close 返回 false
+		*/
+		bool arm(wheel_node_t& node,const std::shared_ptr<void>& owner,k0::uint64_t ticks)
+		{
+			if(!ticks)
+			{
+				ticks = 1;
+			}
+			boost::mutex::scoped_lock lock(_mutex);
+			if(node._closed)
+			{
+				return false;
+			}
+			if(node.linked())
+			{
+				unlink(node);
+			}
+			else
+			{
+				node._owner = owner;
+			}
+			node._expire = now() + ticks;
+			link(node);
+			return true;
+		}
+		/**
+		*	\brief 取消 定時 釋放 對象
+		*/
+		void cancel(wheel_node_t& node)
+		{
+			std::shared_ptr<void> owner;
+			boost::mutex::scoped_lock lock(_mutex);
+			if(node.linked())
+			{
+				unlink(node);
+				//在 鎖外 釋放 對象 析構 可能 再次 調用 cancel
+				owner.swap(node._owner);
+			}
+		}
+		/**
+		*	\brief 取消 定時 並 禁止 之後的 arm
+		*/
+		void close(wheel_node_t& node)
+		{
+			std::shared_ptr<void> owner;
+			boost::mutex::scoped_lock lock(_mutex);
+			node._closed = true;
+			if(node.linked())
+			{
+				unlink(node);
+				owner.swap(node._owner);
+			}
+		}
+		/**
+		*	\brief 返回 節點 是否 已經 close
+		*/
+		inline bool closed(wheel_node_t& node)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			return node._closed;
+		}
+		/**
+		*	\brief 前進 一個 tick 將 到期 節點 的 對象 加入 expired
+		*	\exception std::bad_alloc
+		*/
+		void advance(std::vector<std::shared_ptr<void> >& expired)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			k0::uint64_t tick = _tick.load(boost::memory_order_relaxed) + 1;
+			_tick.store(tick,boost::memory_order_relaxed);
+
+			wheel_node_t* head = &_slots[tick & _mask];
+			wheel_node_t* node = head->_next;
+			while(node != head)
+			{
+				wheel_node_t* next = node->_next;
+				if(node->_expire <= tick)
+				{
+					//先 分配 失敗 時 節點 留在 輪上
+					expired.push_back(std::shared_ptr<void>());
+					expired.back().swap(node->_owner);
+					unlink(*node);
+				}
+				node = next;
+			}
+		}
+		/**
+		*	\brief 取消 所有 節點
+		*/
+		void clear()
+		{
+			std::vector<std::shared_ptr<void> > owners;
+			boost::mutex::scoped_lock lock(_mutex);
+			for(std::size_t i=0;i<_slots.size();++i)
+			{
+				wheel_node_t* head = &_slots[i];
+				while(head->_next != head)
+				{
+					wheel_node_t* node = head->_next;
+					unlink(*node);
+					try
+					{
+						owners.push_back(std::shared_ptr<void>());
+						owners.back().swap(node->_owner);
+					}
+					catch(const std::bad_alloc&)
+					{
+						//無法 延後 只能 在 鎖內 釋放
+						node->_owner.reset();
+					}
+				}
+			}
+		}
+	protected:
+		void link(wheel_node_t& node)
+		{
+			wheel_node_t* head = &_slots[node._expire & _mask];
+			node._prev = head->_prev;
+			node._next = head;
+			head->_prev->_next = &node;
+			head->_prev = &node;
+			++_size;
+		}
+		void unlink(wheel_node_t& node)
+		{
+			node._prev->_next = node._next;
+			node._next->_prev = node._prev;
+			node._prev = node._next = NULL;
+			--_size;
+		}
+	};
+};
+};
+};
+
+#endif // KING_LIB_HEADER_NET_TCP_TIMING_WHEEL
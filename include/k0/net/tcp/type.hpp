@@ -4,12 +4,38 @@
 
 
 #include <k0/bytes/type.hpp>
+#include <k0/bytes/pool.hpp>
+#include <k0/mpsc.hpp>
+#include "timing_wheel.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/smart_ptr.hpp>
 
-#include <list>
+#include <climits>
+#include <new>
+#include <vector>
+
+/**
+*	\brief 一次 合併 write 最多 包含的 數據 條數
+*
+*	asio 每次 系統調用 最多 使用 64 個 buffer 並且 不超過 IOV_MAX
+*/
+#ifndef KING_NET_TCP_SEND_BUFFERS
+#if defined(IOV_MAX) && IOV_MAX < 64
+#define KING_NET_TCP_SEND_BUFFERS IOV_MAX
+#else
+#define KING_NET_TCP_SEND_BUFFERS 64
+#endif
+#endif
+
+/**
+*	\brief 一次 合併 write 最多 包含的 字節數 (單條 數據 超過時 單獨 write)
+*/
+#ifndef KING_NET_TCP_SEND_BUDGET
+#define KING_NET_TCP_SEND_BUDGET (1024 * 256)
+#endif
+
 namespace k0
 {
 namespace net
@@ -34,7 +60,229 @@ namespace tcp
 	/**
 	*	\brief 網路數據 字節數組 智能指針
 	*/
-    typedef boost::shared_ptr<k0::bytes::bytes_t> bytes_spt;
+    typedef k0::bytes::bytes_spt bytes_spt;
+
+    /**
+	*	\brief 一段 連續的 const_buffer 作爲 asio buffer 序列 不擁有 也不拷貝 數組
+	*/
+	class const_buffers_view_t
+	{
+	public:
+		typedef boost::asio::const_buffer value_type;
+		typedef const boost::asio::const_buffer* const_iterator;
+	protected:
+		const_iterator _begin;
+		const_iterator _end;
+	public:
+		const_buffers_view_t(const_iterator begin,const_iterator end):_begin(begin),_end(end)
+		{
+		}
+		inline const_iterator begin()const
+		{
+			return _begin;
+		}
+		inline const_iterator end()const
+		{
+			return _end;
+		}
+	};
+
+	/**
+	*	\brief 異步回調 返回時 減少 已投遞 還未 返回的 回調 數量
+	*
+	*	等待 回調 全部 返回 後 才 釋放 資源 時 在 回調 開頭 構造
+	*/
+	class handler_guard_t
+	{
+		boost::atomic<std::size_t>& _handlers;
+	public:
+		explicit handler_guard_t(boost::atomic<std::size_t>& handlers)
+			:_handlers(handlers)
+		{
+		}
+		~handler_guard_t()
+		{
+			_handlers.fetch_sub(1,boost::memory_order_release);
+		}
+	private:
+		handler_guard_t(const handler_guard_t&);
+		handler_guard_t& operator=(const handler_guard_t&);
+	};
+
+	/**
+	*	\brief try_send 的 結果
+	*/
+	enum send_status_t
+	{
+		/**
+		*	\brief 已加入 發送隊列
+		*/
+		send_ok = 0,
+		/**
+		*	\brief 發送隊列 超過 高水位 數據 沒有 加入隊列 隊列 降到 低水位 時 回調 on_writable
+		*/
+		send_would_block,
+		/**
+		*	\brief 連接 已關閉
+		*/
+		send_closed,
+		/**
+		*	\brief 內存 不足
+		*/
+		send_error
+	};
+
+	/**
+	*	\brief on_timeout 的 超時 類型
+	*/
+	enum timeout_t
+	{
+		/**
+		*	\brief 沒有 recv 也沒有 send 完成
+		*/
+		timeout_idle = 0,
+		/**
+		*	\brief 等待 數據 時 沒有 recv
+		*/
+		timeout_read
+	};
+
+	/**
+	*	\brief 每個 連接 發送隊列 的 水位
+	*
+	*	隊列 包含 已入隊 和 正在 write 的 數據 high_bytes high_count 爲0 的 限制 不生效 默認 都不限制
+	*/
+	class watermark_t
+	{
+	public:
+		/**
+		*	\brief 隊列 字節數 達到 high_bytes 時 拒絕 新數據
+		*/
+		std::size_t high_bytes;
+		/**
+		*	\brief 隊列 字節數 不超過 low_bytes 時 恢復
+		*/
+		std::size_t low_bytes;
+		/**
+		*	\brief 隊列 數據條數 達到 high_count 時 拒絕 新數據
+		*/
+		std::size_t high_count;
+		/**
+		*	\brief 隊列 數據條數 不超過 low_count 時 恢復
+		*/
+		std::size_t low_count;
+		/**
+		*	\brief 超過 高水位 時 是否 暫停 recv 直到 降到 低水位
+		*/
+		bool pause;
+		/**
+		*	\brief 超過 高水位 多少 毫秒 仍未 降到 低水位 時 回調 on_slow 爲0 時 不檢查
+		*/
+		std::size_t deadline;
+
+		watermark_t()
+			:high_bytes(0),low_bytes(0),high_count(0),low_count(0),pause(false),deadline(0)
+		{
+		}
+		/**
+		*	\brief 是否 設置了 任何 限制
+		*/
+		inline bool enabled()const
+		{
+			return high_bytes || high_count;
+		}
+	};
+	/**
+	*	\brief 可以 在 運行時 從 任意線程 修改的 watermark_t
+	*
+	*	每個 字段 分別 原子 讀寫 修改 期間 讀者 可能 看到 新舊 混合的 值 只會 多拒絕 或 多恢復 一次
+	*/
+	class atomic_watermark_t
+	{
+	public:
+		boost::atomic<std::size_t> high_bytes;
+		boost::atomic<std::size_t> low_bytes;
+		boost::atomic<std::size_t> high_count;
+		boost::atomic<std::size_t> low_count;
+		boost::atomic<bool> pause;
+		boost::atomic<std::size_t> deadline;
+
+		atomic_watermark_t()
+			:high_bytes(0),low_bytes(0),high_count(0),low_count(0),pause(false),deadline(0)
+		{
+		}
+	private:
+		atomic_watermark_t(const atomic_watermark_t&);
+		atomic_watermark_t& operator=(const atomic_watermark_t&);
+	public:
+		/**
+		*	\brief 返回 當前 水位 的 副本
+		*/
+		watermark_t load()const
+		{
+			watermark_t marks;
+			marks.high_bytes = high_bytes.load(boost::memory_order_relaxed);
+			marks.low_bytes = low_bytes.load(boost::memory_order_relaxed);
+			marks.high_count = high_count.load(boost::memory_order_relaxed);
+			marks.low_count = low_count.load(boost::memory_order_relaxed);
+			marks.pause = pause.load(boost::memory_order_relaxed);
+			marks.deadline = deadline.load(boost::memory_order_relaxed);
+			return marks;
+		}
+		/**
+		*	\brief 設置 水位 先 設置 低水位 和 選項 最後 設置 高水位 啓用 限制
+		*/
+		void store(const watermark_t& marks)
+		{
+			low_bytes.store(marks.low_bytes,boost::memory_order_relaxed);
+			low_count.store(marks.low_count,boost::memory_order_relaxed);
+			pause.store(marks.pause,boost::memory_order_relaxed);
+			deadline.store(marks.deadline,boost::memory_order_relaxed);
+			high_bytes.store(marks.high_bytes,boost::memory_order_release);
+			high_count.store(marks.high_count,boost::memory_order_release);
+		}
+		/**
+		*	\brief 是否 設置了 任何 限制
+		*/
+		inline bool enabled()const
+		{
+			return high_bytes.load(boost::memory_order_relaxed) || high_count.load(boost::memory_order_relaxed);
+		}
+	};
+
+    /**
+	*	\brief 發送隊列 節點
+	*
+	*	從 pool_t 分配 由 生產者 線程 創建 在 io 線程 取出後 釋放
+	*/
+	class send_node_t : public k0::mpsc_node_t
+	{
+	public:
+		/**
+		*	\brief 待發送 數據
+		*/
+		bytes_spt buffer;
+
+		/**
+		*	\brief 創建 節點
+		*	\exception std::bad_alloc
+		*/
+		static send_node_t* create(const bytes_spt& buffer)
+		{
+			void* p = k0::bytes::pool_t::instance().malloc(sizeof(send_node_t));
+			send_node_t* node = new(p) send_node_t();
+			node->buffer = buffer;
+			return node;
+		}
+		/**
+		*	\brief 釋放 節點
+		*/
+		static void destroy(send_node_t* node)
+		{
+			node->~send_node_t();
+			k0::bytes::pool_t::instance().free(node,sizeof(send_node_t));
+		}
+	};
 
     /**
 	*	\brief 對 boost socket 結構的 擴展
@@ -55,6 +303,10 @@ namespace tcp
 		*	\brief boost socket
 		*/
         socket_bt _s;
+		/**
+		*	\brief socket 所屬的 io_service
+		*/
+		io_service_t& _io_s;
 
         /**
 		*	\brief 用戶 綁定的 自定義結構
@@ -69,10 +321,20 @@ namespace tcp
 		/**
 		*	\brief 構造 socket
 		*/
-        explicit socket_t(io_service_t& io_s):_s(io_s),_wait(false)
+        explicit socket_t(io_service_t& io_s):_s(io_s),_io_s(io_s),_pending(0),_bytes(0),_written(0),_blocked(false),_paused(false),_deadline_at(0),_deadline_armed(false),_open(0),_wheel(NULL),_recv_tick(0),_send_tick(0),_partial(true),_reactive(false)
         {
+			_batch.reserve(KING_NET_TCP_SEND_BUFFERS);
+			_iov.reserve(KING_NET_TCP_SEND_BUFFERS);
 
         }
+		virtual ~socket_t()
+		{
+			//析構時 沒有 其它線程 訪問 隊列 不會 遇到 未鏈接的 節點
+			while(send_node_t* node = _sends.pop())
+			{
+				send_node_t::destroy(node);
+			}
+		}
 	private:
 		socket_t(const socket_t&);
 		socket_t& operator=(const socket_t&);
@@ -91,28 +353,242 @@ namespace tcp
         {
             return _user;
         }
+		/**
+		*	\brief 返回 socket 所屬的 io_service
+		*/
+		inline io_service_t& io_service()
+		{
+			return _io_s;
+		}
 		/**
 		*	\brief 返回 socket native 句柄
 		*/
         inline std::size_t native()
         {
-            return _s.native();
+            return _s.native_handle();
         }
 
         /**
-		*	\brief 待發送數據列表 (不要操作此屬性)
+		*	\brief 將 數據 加入 發送隊列 (不要調用此函數)
+		*
+		*	可以 在 任意線程 調用 不需要 加鎖
+		*
+		*	\return 調用者 是否 需要 開始 write (之前 沒有 write 在進行)
+		*	\exception std::bad_alloc
+		*/
+		bool push_send(const bytes_spt& buffer)
+		{
+			send_node_t* node = send_node_t::create(buffer);
+			_bytes.fetch_add(buffer->size());
+			//先 計數 再 入隊 保證 計數 不小於 可取出的 節點數 計數 從0 變爲1 的 線程 負責 write
+			bool start = _pending.fetch_add(1,boost::memory_order_acq_rel) == 0;
+			_sends.push(node);
+			return start;
+		}
+		/**
+		*	\brief 取出 多條 待發送 數據 到 _batch 和 _iov 以便 一次 write (不要調用此函數)
+		*
+		*	只有 負責 write 的 線程 可以 調用\n
+		*	最多 取出 KING_NET_TCP_SEND_BUFFERS 條 總長 不超過 KING_NET_TCP_SEND_BUDGET (至少 取出一條)
+		*
+		*	\return 取出的 條數 爲0 時 應該 稍後 重試
+		*/
+		std::size_t pop_sends()
+		{
+			_batch.clear();
+			_iov.clear();
+			_written = 0;
+			std::size_t bytes = 0;
+			bytes_spt buffer;
+			while(_batch.size() < KING_NET_TCP_SEND_BUFFERS)
+			{
+				send_node_t* node = _sends.pop();
+				if(!node)
+				{
+					break;
+				}
+				buffer.swap(node->buffer);
+				send_node_t::destroy(node);
+
+				bytes += buffer->size();
+				_iov.push_back(boost::asio::const_buffer(buffer->get(),buffer->size()));
+				_batch.push_back(bytes_spt());
+				_batch.back().swap(buffer);
+				if(bytes >= KING_NET_TCP_SEND_BUDGET)
+				{
+					break;
+				}
+			}
+			return _batch.size();
+		}
+		/**
+		*	\brief 返回 _iov 中 還未 寫出的 部分 (不要調用此函數)
+		*/
+		inline const_buffers_view_t send_buffers()const
+		{
+			const boost::asio::const_buffer* iov = &_iov[0];
+			return const_buffers_view_t(iov + _written,iov + _iov.size());
+		}
+		/**
+		*	\brief 記錄 write 寫出了 n 字節 (不要調用此函數)
+		*
+		*	完整寫出的 buffer 被跳過 部分寫出的 buffer 在原位置 前移 不需要 重新分配
+		*
+		*	\return _batch 是否 已經 全部 寫出
+		*/
+		bool written(std::size_t n)
+		{
+			_bytes.fetch_sub(n);
+			while(n && _written < _iov.size())
+			{
+				boost::asio::const_buffer& buffer = _iov[_written];
+				std::size_t size = boost::asio::buffer_size(buffer);
+				if(n < size)
+				{
+					buffer = buffer + n;
+					break;
+				}
+				n -= size;
+				++_written;
+			}
+			//跳過 空 buffer
+			while(_written < _iov.size() && !boost::asio::buffer_size(_iov[_written]))
+			{
+				++_written;
+			}
+			return _written == _iov.size();
+		}
+		/**
+		*	\brief n 條 數據 write 完成 (不要調用此函數)
+		*	\return 是否 還有 待發送 數據 需要 繼續 write
+		*/
+		bool sent(const std::size_t n = 1)
+		{
+			return _pending.fetch_sub(n,boost::memory_order_acq_rel) != n;
+		}
+
+		/**
+		*	\brief 在 recv 處理器 之外 使用 socket 前 調用 阻止 recv 處理器 同時 關閉 socket (不要調用此函數)
+		*
+		*	返回 true 時 必須 調用 leave_open
+		*
+		*	\return false socket 已經 關閉
+		*/
+		inline bool enter_open()
+		{
+			if(_open.fetch_add(2,boost::memory_order_acquire) & 1)
+			{
+				_open.fetch_sub(2,boost::memory_order_release);
+				return false;
+			}
+			return true;
+		}
+		/**
+		*	\brief 結束 enter_open 開始的 使用 (不要調用此函數)
+		*/
+		inline void leave_open()
+		{
+			_open.fetch_sub(2,boost::memory_order_release);
+		}
+		/**
+		*	\brief 標記 關閉 並 等待 enter_open 的 使用者 離開 之後 只有 調用者 可以 關閉 socket (不要調用此函數)
+		*
+		*	只在 recv 處理器 調用 使用者 都在 其它線程 等待 很短
+		*
+		*	\return false 已經 標記過
+		*/
+		bool mark_closed()
+		{
+			if(_open.fetch_or(1,boost::memory_order_acq_rel) & 1)
+			{
+				return false;
+			}
+			while(_open.load(boost::memory_order_acquire) != 1)
+			{
+				boost::this_thread::yield();
+			}
+			return true;
+		}
+		/**
+		*	\brief 返回 是否 已經 標記 關閉
+		*/
+		inline bool closed()const
+		{
+			return (_open.load(boost::memory_order_acquire) & 1) != 0;
+		}
+
+		/**
+		*	\brief 待發送數據 隊列 (不要操作此屬性)
+		*/
+		k0::mpsc_queue_t<send_node_t> _sends;
+
+		/**
+		*	\brief 已入隊 還未 write 完成的 數據數量 非0 時 有一個 write 在進行 (不要操作此屬性)
 		*/
-		std::list<bytes_spt> _datas;
-        
+		boost::atomic<std::size_t> _pending;
 		/**
-		*	\brief 同步 對象 (不要操作此屬性)
+		*	\brief 已入隊 還未 寫出的 字節數 (不要操作此屬性)
 		*/
-        boost::mutex _mutex;
+		boost::atomic<std::size_t> _bytes;
 
 		/**
-		*	\brief 是否正在 等待上次 write (不要操作此屬性)
+		*	\brief 正在 write 的 數據 (不要操作此屬性)
+		*/
+		std::vector<bytes_spt> _batch;
+		/**
+		*	\brief _batch 對應的 buffer 序列 重複使用 (不要操作此屬性)
+		*/
+		std::vector<boost::asio::const_buffer> _iov;
+		/**
+		*	\brief _iov 中 已經 完整寫出的 buffer 數量 (不要操作此屬性)
+		*/
+		std::size_t _written;
+
+		/**
+		*	\brief 是否 有 try_send 因 超過 高水位 被拒絕 還未 回調 on_writable (不要操作此屬性)
+		*/
+		boost::atomic<bool> _blocked;
+		/**
+		*	\brief recv 是否 因 超過 高水位 暫停 (不要操作此屬性)
+		*/
+		boost::atomic<bool> _paused;
+		/**
+		*	\brief 超過 高水位 後 應該 降到 低水位 的 時間 微秒 (不要操作此屬性)
+		*/
+		boost::atomic<k0::uint64_t> _deadline_at;
+		/**
+		*	\brief 是否 有 等待 _deadline_at 的 定時器 同時 最多 一個 (不要操作此屬性)
+		*/
+		boost::atomic<bool> _deadline_armed;
+		/**
+		*	\brief 位0 爲 是否 已經 關閉 其餘 位 爲 enter_open 的 使用者 數量 (不要操作此屬性)
+		*/
+		boost::atomic<std::size_t> _open;
+
+		/**
+		*	\brief 超時 定時器 (不要操作此屬性)
+		*/
+		wheel_node_t _timer;
+		/**
+		*	\brief socket 所屬 事件循環 的 時間輪 沒有 設置 超時 時 爲 NULL (不要操作此屬性)
+		*/
+		timing_wheel_t* _wheel;
+		/**
+		*	\brief 最後 recv 的 tick (不要操作此屬性)
+		*/
+		boost::atomic<k0::uint64_t> _recv_tick;
+		/**
+		*	\brief 最後 send 完成的 tick (不要操作此屬性)
+		*/
+		boost::atomic<k0::uint64_t> _send_tick;
+		/**
+		*	\brief 是否 在 等待 未完成的 數據 read 超時 只在 爲 true 時 生效 server_t 總是 true (不要操作此屬性)
+		*/
+		boost::atomic<bool> _partial;
+		/**
+		*	\brief 是否 使用 reactive recv 接受時 確定 之後 不變 (不要操作此屬性)
 		*/
-        bool _wait;
+		bool _reactive;
 
     };
 
@@ -0,0 +1,221 @@
+/*
+*	k0::bytes 的 微基準測試
+*
+*	報告 bytes_per_second 以及 每次操作的 分配次數
+*	pool_allocs/op 爲 pool_t 的 分配 new/op 爲 全局 operator new 的 調用
+*
+*	g++ -std=c++11 -O2 -I../../../include bench_buffer.cpp -o bench_buffer -lbenchmark -lpthread -lboost_thread
+*	./bench_buffer --benchmark_filter=Buffer
+*/
+#include <k0/bytes/buffer.hpp>
+#include <k0/bytes/type.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/atomic.hpp>
+
+//統計 全局 operator new 調用次數
+//new delete 都以 malloc free 實現 不能 內聯 否則 編譯器 在 調用處 看到 operator new 的 指針 被 free
+static boost::atomic<k0::uint64_t> g_news(0);
+__attribute__((noinline)) void* operator new(std::size_t n)
+{
+	g_news.fetch_add(1,boost::memory_order_relaxed);
+	void* p = malloc(n ? n : 1);
+	if(!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+__attribute__((noinline)) void operator delete(void* p,std::size_t) noexcept
+{
+	free(p);
+}
+
+//統計 一段代碼的 分配次數
+class allocs_t
+{
+	k0::uint64_t _pool;
+	k0::uint64_t _news;
+	static k0::uint64_t pool()
+	{
+		k0::bytes::pool_stats_t s = k0::bytes::pool_t::instance().stats();
+		return s.hits + s.misses + s.larges;
+	}
+public:
+	allocs_t():_pool(pool()),_news(g_news.load())
+	{
+	}
+	void report(benchmark::State& state)
+	{
+		state.counters["pool_allocs/op"] = benchmark::Counter((double)(pool() - _pool),benchmark::Counter::kAvgIterations);
+		state.counters["new/op"] = benchmark::Counter((double)(g_news.load() - _news),benchmark::Counter::kAvgIterations);
+	}
+};
+
+//數據塊 容量 x 消息大小
+static void capacity_size(benchmark::internal::Benchmark* b)
+{
+	int capacities[] = {256,1024,4096,16384};
+	int sizes[] = {16,64,512,4096,65536};
+	for(int i=0;i<4;++i)
+	{
+		for(int j=0;j<5;++j)
+		{
+			b->Args({capacities[i],sizes[j]});
+		}
+	}
+}
+
+//寫入 一條消息 再 讀出 (收到 完整消息 立刻處理)
+static void BM_BufferWriteRead(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(0));
+	std::vector<k0::byte_t> msg((std::size_t)state.range(1),'m');
+	std::vector<k0::byte_t> out(msg.size());
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		buf.write(msg.data(),msg.size());
+		benchmark::DoNotOptimize(buf.read(out.data(),out.size()));
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_BufferWriteRead)->Apply(capacity_size);
+
+//積壓 64 條消息 後 一次 讀出 (消費者 落後)
+static void BM_BufferBacklog(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(0));
+	std::vector<k0::byte_t> msg((std::size_t)state.range(1),'m');
+	std::vector<k0::byte_t> out(msg.size());
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		for(int i=0;i<64;++i)
+		{
+			buf.write(msg.data(),msg.size());
+		}
+		for(int i=0;i<64;++i)
+		{
+			benchmark::DoNotOptimize(buf.read(out.data(),out.size()));
+		}
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * state.range(1) * 64);
+}
+BENCHMARK(BM_BufferBacklog)->Apply(capacity_size);
+
+//小塊 寫入 大塊 讀取 (tcp 分段 到達)
+static void BM_BufferSmallWriteLargeRead(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(0));
+	std::vector<k0::byte_t> msg((std::size_t)state.range(1),'m');
+	std::vector<k0::byte_t> out(msg.size() * 8);
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		for(int i=0;i<8;++i)
+		{
+			buf.write(msg.data(),msg.size());
+		}
+		benchmark::DoNotOptimize(buf.read(out.data(),out.size()));
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * state.range(1) * 8);
+}
+BENCHMARK(BM_BufferSmallWriteLargeRead)->Apply(capacity_size);
+
+//在 64k 積壓數據 中 隨機位置 copy_to (解析 包頭)
+static void BM_BufferCopyTo(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(0));
+	std::vector<k0::byte_t> fill(1024 * 64,'f');
+	buf.write(fill.data(),fill.size());
+	std::size_t n = (std::size_t)state.range(1);
+	if(n > fill.size() / 2)
+	{
+		n = fill.size() / 2;
+	}
+	std::vector<k0::byte_t> out(n);
+	std::size_t skip = 0;
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		skip = (skip * 1103515245 + 12345) % (fill.size() - n);
+		benchmark::DoNotOptimize(buf.copy_to(skip,out.data(),n));
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_BufferCopyTo)->Apply(capacity_size);
+
+//prepare/commit 讀入 再 讀出 切片 (msg_server_t 的 接收路徑)
+static void BM_BufferPrepareSlice(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(0));
+	std::size_t n = (std::size_t)state.range(1);
+	k0::bytes::buffer_t::mutable_buffers_t buffers;
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		if(buf.prepare(n,buffers) != n)
+		{
+			state.SkipWithError("prepare");
+			break;
+		}
+		for(std::size_t i=0;i<buffers.size();++i)
+		{
+			memset(boost::asio::buffer_cast<void*>(buffers[i]),'s',boost::asio::buffer_size(buffers[i]));
+		}
+		buf.commit(n);
+		k0::bytes::slice_t slice;
+		benchmark::DoNotOptimize(buf.read(n,slice));
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_BufferPrepareSlice)->Apply(capacity_size);
+
+//fragmentation_t 寫滿 再 讀出
+static void BM_FragmentationWriteRead(benchmark::State& state)
+{
+	k0::bytes::fragmentation_t fragmentation((std::size_t)state.range(0));
+	std::vector<k0::byte_t> msg((std::size_t)state.range(0),'m');
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		fragmentation.init();
+		fragmentation.write(msg.data(),msg.size());
+		benchmark::DoNotOptimize(fragmentation.read(msg.data(),msg.size()));
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FragmentationWriteRead)->Arg(64)->Arg(1024)->Arg(16384);
+
+//創建 字節數組 (push_send 的 拷貝路徑)
+static void BM_MakeBytes(benchmark::State& state)
+{
+	std::size_t n = (std::size_t)state.range(0);
+	allocs_t allocs;
+	for(auto _ : state)
+	{
+		k0::bytes::bytes_spt b = k0::bytes::make_bytes(n);
+		benchmark::DoNotOptimize(b->get());
+	}
+	allocs.report(state);
+	state.SetBytesProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_MakeBytes)->Arg(16)->Arg(64)->Arg(65)->Arg(1024)->Arg(65536);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,135 @@
+/*
+*	buffer_t::find 與 先拷貝出數據 再 memchr/search 的 對比
+*
+*	g++ -std=c++11 -O2 -I../../../include bench_search.cpp -o bench_search -lbenchmark -lpthread -lboost_thread
+*/
+#include <k0/bytes/buffer.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+//類似 http 頭的 數據 每行 以 \r\n 結尾 末尾 放置 分隔符
+static std::string header(std::size_t size)
+{
+	std::string str(size,'a');
+	for(std::size_t i=0;i<size;++i)
+	{
+		str[i] = (char)('a' + i % 23);
+		if(i % 29 == 27)
+		{
+			str[i] = '\r';
+		}
+		else if(i % 29 == 28)
+		{
+			str[i] = '\n';
+		}
+	}
+	str.replace(size - 4,4,"\r\n\r\n");
+	return str;
+}
+static void fill(k0::bytes::buffer_t& buf,std::size_t size,std::size_t chunk)
+{
+	std::string str = header(size);
+	for(std::size_t i=0;i<size;i += chunk)
+	{
+		buf.write((const k0::byte_t*)str.data() + i,std::min(chunk,size - i));
+	}
+}
+
+//查找 不存在的 字節 掃描 全部數據
+static void BM_FindByte(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(1));
+	fill(buf,(std::size_t)state.range(0),(std::size_t)state.range(1));
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(buf.find(0x7f));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FindByte)->Args({64,1024})->Args({4096,1024})->Args({65536,1024})->Args({65536,16384});
+
+static void BM_FindByteCopy(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(1));
+	fill(buf,(std::size_t)state.range(0),(std::size_t)state.range(1));
+	std::vector<k0::byte_t> bytes(buf.size());
+	for(auto _ : state)
+	{
+		buf.copy_to(bytes.data(),bytes.size());
+		benchmark::DoNotOptimize(memchr(bytes.data(),0x7f,bytes.size()));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FindByteCopy)->Args({64,1024})->Args({4096,1024})->Args({65536,1024})->Args({65536,16384});
+
+static void BM_FindPattern(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(1));
+	fill(buf,(std::size_t)state.range(0),(std::size_t)state.range(1));
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(buf.find("\r\n\r\n"));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FindPattern)->Args({64,1024})->Args({4096,1024})->Args({65536,1024})->Args({65536,16384});
+
+static void BM_FindPatternCopy(benchmark::State& state)
+{
+	k0::bytes::buffer_t buf((int)state.range(1));
+	fill(buf,(std::size_t)state.range(0),(std::size_t)state.range(1));
+	std::vector<k0::byte_t> bytes(buf.size());
+	const char* pattern = "\r\n\r\n";
+	for(auto _ : state)
+	{
+		buf.copy_to(bytes.data(),bytes.size());
+		benchmark::DoNotOptimize(std::search(bytes.begin(),bytes.end(),pattern,pattern + 4));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FindPatternCopy)->Args({64,1024})->Args({4096,1024})->Args({65536,1024})->Args({65536,16384});
+
+//各個 內核 在 連續內存 上的 速度
+template<k0::bytes::find_pattern_ft F>
+static void BM_Kernel(benchmark::State& state)
+{
+	std::string str = header((std::size_t)state.range(0));
+	const k0::byte_t* pattern = (const k0::byte_t*)"\r\n\r\n";
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(F((const k0::byte_t*)str.data(),str.size(),pattern,4));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Kernel,k0::bytes::find_pattern_scalar)->Arg(4096)->Arg(65536);
+#if defined(KING_CPU_X86)
+BENCHMARK_TEMPLATE(BM_Kernel,k0::bytes::find_pattern_sse2)->Arg(4096)->Arg(65536);
+#endif
+#if defined(KING_CPU_AVX2)
+BENCHMARK_TEMPLATE(BM_Kernel,k0::bytes::find_pattern_avx2)->Arg(4096)->Arg(65536);
+#endif
+
+//字節 內核 查找 不存在的 字節 掃描 全部數據 glibc 上 find_byte 使用 find_byte_scalar (memchr) 以此 驗證
+template<k0::bytes::find_byte_ft F>
+static void BM_ByteKernel(benchmark::State& state)
+{
+	std::string str = header((std::size_t)state.range(0));
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(F((const k0::byte_t*)str.data(),str.size(),0x7f));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_ByteKernel,k0::bytes::find_byte_scalar)->Arg(64)->Arg(4096)->Arg(65536);
+#if defined(KING_CPU_X86)
+BENCHMARK_TEMPLATE(BM_ByteKernel,k0::bytes::find_byte_sse2)->Arg(64)->Arg(4096)->Arg(65536);
+#endif
+#if defined(KING_CPU_AVX2)
+BENCHMARK_TEMPLATE(BM_ByteKernel,k0::bytes::find_byte_avx2)->Arg(64)->Arg(4096)->Arg(65536);
+#endif
+
+BENCHMARK_MAIN();
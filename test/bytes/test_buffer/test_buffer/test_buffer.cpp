@@ -3,6 +3,9 @@
 
 #include "stdafx.h"
 #include <k0/bytes/buffer.hpp>
+#include <k0/bytes/mirror.hpp>
+#include <k0/bytes/codec.hpp>
+#include <k0/bytes/crc32c.hpp>
 
 int _tmain(int argc, _TCHAR* argv[])
 {
@@ -146,4 +149,636 @@ TEST(TypeBuffer, HandleNoneZeroInput)
 		n = buf.copy_to(pos,(std::uint8_t*)b,size);
 		EXPECT_EQ(std::string(b,n),str.substr(pos));
     }
-}
\ No newline at end of file
+}
+
+TEST(TypePool, HandleNoneZeroInput)
+{
+	k0::bytes::pool_t& pool = k0::bytes::pool_t::instance();
+	EXPECT_EQ(k0::bytes::pool_t::round(1),16);
+	EXPECT_EQ(k0::bytes::pool_t::round(17),32);
+	EXPECT_EQ(k0::bytes::pool_t::round(4096),4096);
+	EXPECT_EQ(k0::bytes::pool_t::round(k0::bytes::pool_t::max_size + 1),k0::bytes::pool_t::max_size + 1);
+
+	//ጷ ٴՈ ľ̾ ȡ
+	void* p = pool.malloc(100);
+	pool.free(p,100);
+	k0::bytes::pool_stats_t s0 = pool.stats();
+	void* p1 = pool.malloc(100);
+	EXPECT_EQ(p,p1);
+	pool.free(p1,100);
+	k0::bytes::pool_stats_t s1 = pool.stats();
+	EXPECT_EQ(s1.hits,s0.hits + 1);
+	EXPECT_EQ(s1.misses,s0.misses);
+
+	k0::bytes::bytes_spt b = k0::bytes::make_bytes(12);
+	EXPECT_TRUE(*b);
+	EXPECT_EQ(b->size(),12);
+
+	k0::bytes::bytes_t empty(0);
+	EXPECT_FALSE(empty);
+}
+
+TEST(TypeBufferChunks, HandleNoneZeroInput)
+{
+	//c std::string  SC x
+	k0::bytes::buffer_t buf(16);
+	std::string expect;
+	k0::byte_t bytes[256];
+	unsigned int seed = 1;
+	for(int i=0;i<2000;++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		std::size_t n = (seed >> 16) % 200;
+		if((seed >> 8) & 1)
+		{
+			for(std::size_t j=0;j<n;++j)
+			{
+				bytes[j] = (k0::byte_t)(i + j);
+			}
+			EXPECT_EQ(buf.write(bytes,n),n);
+			expect.append((const char*)bytes,n);
+		}
+		else
+		{
+			std::size_t count = buf.read(bytes,n);
+			EXPECT_EQ(count,std::min(n,expect.size()));
+			EXPECT_EQ(std::string((const char*)bytes,count),expect.substr(0,count));
+			expect.erase(0,count);
+		}
+		EXPECT_EQ(buf.size(),expect.size());
+	}
+
+	std::size_t skip = expect.size() / 3;
+	std::string copy(expect.size(),0);
+	EXPECT_EQ(buf.copy_to(skip,(k0::byte_t*)&copy[0],copy.size()),expect.size() - skip);
+	EXPECT_EQ(copy.substr(0,expect.size() - skip),expect.substr(skip));
+
+	buf.reset(false);
+	EXPECT_EQ(buf.size(),0);
+	EXPECT_EQ(buf.write(bytes,10),10);
+	EXPECT_EQ(buf.size(),10);
+}
+
+TEST(TypeBufferSkip, HandleNoneZeroInput)
+{
+	//ÿ  ͬС ʹK С һ
+	k0::bytes::buffer_t buf(4);
+	std::string expect;
+	for(int i=1;i<64;++i)
+	{
+		std::string str(i,(char)('a' + i % 26));
+		EXPECT_EQ(buf.write((const k0::byte_t*)str.data(),str.size()),str.size());
+		expect += str;
+	}
+	k0::byte_t tmp[8];
+	EXPECT_EQ(buf.read(tmp,7),7);
+	expect.erase(0,7);
+	EXPECT_EQ(buf.size(),expect.size());
+
+	char bytes[16];
+	for(std::size_t skip=0;skip<expect.size();++skip)
+	{
+		std::size_t n = buf.copy_to(skip,(k0::byte_t*)bytes,sizeof(bytes));
+		EXPECT_EQ(std::string(bytes,n),expect.substr(skip,sizeof(bytes)));
+	}
+	EXPECT_EQ(buf.copy_to(expect.size(),(k0::byte_t*)bytes,sizeof(bytes)),0);
+}
+
+TEST(TypeBufferView, HandleNoneZeroInput)
+{
+	k0::bytes::buffer_t buf(8);
+	std::string expect;
+	for(int i=0;i<20;++i)
+	{
+		//ֱ  Ɍ^
+		std::size_t n = 3 + i % 7;
+		k0::bytes::buffer_t::mutable_buffers_t buffers;
+		EXPECT_EQ(buf.prepare(n,buffers),n);
+		std::size_t count = 0;
+		for(std::size_t j=0;j<buffers.size();++j)
+		{
+			k0::byte_t* p = boost::asio::buffer_cast<k0::byte_t*>(buffers[j]);
+			std::size_t size = boost::asio::buffer_size(buffers[j]);
+			for(std::size_t k=0;k<size;++k)
+			{
+				p[k] = (k0::byte_t)('a' + (i + k) % 26);
+				expect.push_back((char)p[k]);
+			}
+			count += size;
+		}
+		EXPECT_EQ(count,n);
+		EXPECT_EQ(buf.commit(n),n);
+		EXPECT_EQ(buf.size(),expect.size());
+
+		if(i % 3 == 2)
+		{
+			EXPECT_EQ(buf.consume(5),5);
+			expect.erase(0,5);
+		}
+	}
+
+	//x^
+	k0::bytes::buffer_t::const_buffers_t buffers;
+	EXPECT_EQ(buf.data(buffers),expect.size());
+	std::string str;
+	for(std::size_t i=0;i<buffers.size();++i)
+	{
+		str.append(boost::asio::buffer_cast<const char*>(buffers[i]),boost::asio::buffer_size(buffers[i]));
+	}
+	EXPECT_EQ(str,expect);
+
+	buffers.clear();
+	EXPECT_EQ(buf.data(buffers,10),10);
+	EXPECT_EQ(boost::asio::buffer_size(buffers),10);
+
+	char bytes[64];
+	std::size_t n = buf.copy_to(3,(k0::byte_t*)bytes,sizeof(bytes));
+	EXPECT_EQ(std::string(bytes,n),expect.substr(3,sizeof(bytes)));
+}
+
+TEST(TypeBufferSlice, HandleNoneZeroInput)
+{
+	k0::bytes::buffer_t buf(16);
+	std::string str = "0123456789abcdefghijklmnopqrstuvwxyz";
+	EXPECT_EQ(buf.write((const k0::byte_t*)str.data(),str.size()),str.size());
+
+	// ͬһK 픵
+	k0::bytes::slice_t s0;
+	EXPECT_EQ(buf.read(4,s0),4);
+	EXPECT_EQ(std::string((const char*)s0.get(),s0.size()),str.substr(0,4));
+
+	// K ؐ
+	k0::bytes::slice_t s1;
+	std::size_t n = buf.size() - 2;
+	EXPECT_EQ(buf.read(n,s1),n);
+	EXPECT_EQ(std::string((const char*)s1.get(),s1.size()),str.substr(4,n));
+	EXPECT_EQ(buf.size(),2);
+
+	//
+	k0::bytes::slice_t s2;
+	EXPECT_EQ(buf.read(3,s2),0);
+	EXPECT_FALSE(s2);
+
+	//n^ ጷ Ƭ ȻЧ
+	buf.reset();
+	k0::bytes::slice_t s3 = s0;
+	s0.reset();
+	EXPECT_EQ(std::string((const char*)s3.get(),s3.size()),str.substr(0,4));
+
+	k0::bytes::bytes_spt b = s3.to_bytes();
+	EXPECT_EQ(std::string((const char*)b->get(),b->size()),str.substr(0,4));
+}
+
+TEST(TypeBufferCache, HandleNoneZeroInput)
+{
+	k0::bytes::pool_t& pool = k0::bytes::pool_t::instance();
+	k0::bytes::buffer_t buf(64,8);
+	EXPECT_EQ(buf.cache(),8);
+	k0::byte_t bytes[64] = {0};
+
+	for(int burst=0;burst<3;++burst)
+	{
+		k0::bytes::pool_stats_t s0 = pool.stats();
+		for(int i=0;i<8;++i)
+		{
+			EXPECT_EQ(buf.write(bytes,sizeof(bytes)),sizeof(bytes));
+		}
+		while(buf.read(bytes,sizeof(bytes)))
+		{
+		}
+		k0::bytes::pool_stats_t s1 = pool.stats();
+		if(burst)
+		{
+			//   K
+			EXPECT_EQ(s1.hits + s1.misses,s0.hits + s0.misses);
+		}
+		EXPECT_GT(buf.cached(),0);
+		EXPECT_LE(buf.cached(),8);
+	}
+
+	buf.cache(1);
+	EXPECT_EQ(buf.cached(),1);
+	buf.reset();
+	EXPECT_EQ(buf.cached(),0);
+}
+
+TEST(TypeMirrorRing, HandleNoneZeroInput)
+{
+	k0::bytes::mirror_ring_t ring(1);
+	EXPECT_TRUE(ring);
+	std::size_t capacity = ring.capacity();
+	EXPECT_GT(capacity,0);
+
+	//ʹ xλ ^ h΅^ ĩβ
+	std::string expect;
+	std::string str(capacity / 3 + 7,'x');
+	for(int i=0;i<10;++i)
+	{
+		for(std::size_t j=0;j<str.size();++j)
+		{
+			str[j] = (char)('a' + (i + j) % 26);
+		}
+		EXPECT_EQ(ring.write((const k0::byte_t*)str.data(),str.size()),str.size());
+		expect += str;
+
+		//x^  Bm
+		EXPECT_EQ(std::string((const char*)ring.begin(),ring.size()),expect);
+
+		k0::bytes::slice_t slice;
+		std::size_t n = str.size() - 3;
+		EXPECT_EQ(ring.read(n,slice),n);
+		EXPECT_FALSE(slice.owned());
+		EXPECT_EQ(std::string((const char*)slice.get(),slice.size()),expect.substr(0,n));
+		expect.erase(0,n);
+	}
+	EXPECT_EQ(ring.capacity(),capacity);
+
+	//g r U
+	std::string big(capacity * 2,'z');
+	EXPECT_EQ(ring.write((const k0::byte_t*)big.data(),big.size()),big.size());
+	expect += big;
+	EXPECT_GE(ring.capacity(),capacity * 2);
+	EXPECT_EQ(std::string((const char*)ring.begin(),ring.size()),expect);
+
+	k0::bytes::mirror_ring_t::mutable_buffers_t buffers;
+	EXPECT_EQ(ring.prepare(10,buffers),10);
+	memset(boost::asio::buffer_cast<k0::byte_t*>(buffers[0]),'k',10);
+	EXPECT_EQ(ring.commit(10),10);
+	expect += std::string(10,'k');
+
+	char bytes[32];
+	std::size_t n = ring.copy_to(expect.size() - 20,(k0::byte_t*)bytes,sizeof(bytes));
+	EXPECT_EQ(std::string(bytes,n),expect.substr(expect.size() - 20));
+}
+
+TEST(TypeBufferFind, HandleNoneZeroInput)
+{
+	// F c std::string::find Y ͬ
+	std::string str;
+	for(int i=0;i<300;++i)
+	{
+		str += (char)('a' + (i * 7) % 5);
+	}
+	str += "\r\n\r\n";
+	const char* patterns[] = {"a","\n","\r\n\r\n","cd","abcde","eba","xyz"};
+	for(std::size_t k=0;k<sizeof(patterns)/sizeof(patterns[0]);++k)
+	{
+		const k0::byte_t* pattern = (const k0::byte_t*)patterns[k];
+		std::size_t m = strlen(patterns[k]);
+		for(std::size_t i=0;i<64;++i)
+		{
+			const k0::byte_t* p = (const k0::byte_t*)str.data() + i;
+			std::size_t n = str.size() - i;
+			std::size_t pos = str.find(patterns[k],i);
+			const k0::byte_t* expect = pos == std::string::npos ? NULL : (const k0::byte_t*)str.data() + pos;
+			EXPECT_EQ(k0::bytes::find_pattern_scalar(p,n,pattern,m),expect);
+			EXPECT_EQ(k0::bytes::find_pattern(p,n,pattern,m),expect);
+#if defined(KING_CPU_X86)
+			EXPECT_EQ(k0::bytes::find_pattern_sse2(p,n,pattern,m),expect);
+			EXPECT_EQ(k0::bytes::find_byte_sse2(p,n,pattern[0]),k0::bytes::find_byte_scalar(p,n,pattern[0]));
+#endif
+#if defined(KING_CPU_AVX2)
+			if(k0::cpu::features().avx2)
+			{
+				EXPECT_EQ(k0::bytes::find_pattern_avx2(p,n,pattern,m),expect);
+				EXPECT_EQ(k0::bytes::find_byte_avx2(p,n,pattern[0]),k0::bytes::find_byte_scalar(p,n,pattern[0]));
+			}
+#endif
+		}
+	}
+
+	//ģʽ Խ K ߅
+	k0::bytes::buffer_t buf(16);
+	k0::bytes::mirror_ring_t ring(1);
+	std::size_t npos = k0::bytes::buffer_t::npos;
+	for(std::size_t i=0;i<str.size();)
+	{
+		std::size_t n = 1 + i % 13;
+		if(n > str.size() - i)
+		{
+			n = str.size() - i;
+		}
+		buf.write((const k0::byte_t*)str.data() + i,n);
+		ring.write((const k0::byte_t*)str.data() + i,n);
+		i += n;
+	}
+	char bytes[8];
+	EXPECT_EQ(buf.read((k0::byte_t*)bytes,5),5);
+	EXPECT_EQ(ring.read((k0::byte_t*)bytes,5),5);
+	str.erase(0,5);
+	for(std::size_t k=0;k<sizeof(patterns)/sizeof(patterns[0]);++k)
+	{
+		for(std::size_t skip=0;skip<=str.size();skip += 3)
+		{
+			std::size_t pos = str.find(patterns[k],skip);
+			std::size_t expect = pos == std::string::npos ? npos : pos;
+			EXPECT_EQ(buf.find(patterns[k],skip),expect);
+			EXPECT_EQ(ring.find(patterns[k],skip),expect);
+		}
+	}
+	for(std::size_t skip=0;skip<str.size();++skip)
+	{
+		std::size_t pos = str.find('\n',skip);
+		EXPECT_EQ(buf.find('\n',skip),pos == std::string::npos ? npos : pos);
+	}
+	EXPECT_EQ(buf.find('\n',str.size()),npos);
+	EXPECT_EQ(buf.find("\r\n\r\n"),str.size() - 4);
+}
+
+TEST(TypeCodec, HandleNoneZeroInput)
+{
+	//L  Ҫ R
+	k0::byte_t b[16];
+	k0::bytes::put_le<k0::uint32_t>(b + 1,0x01020304);
+	EXPECT_EQ(b[1],0x04);
+	EXPECT_EQ(b[4],0x01);
+	EXPECT_EQ(k0::bytes::get_le<k0::uint32_t>(b + 1),0x01020304);
+	k0::bytes::put_be<k0::uint64_t>(b + 3,0x0102030405060708ULL);
+	EXPECT_EQ(b[3],0x01);
+	EXPECT_EQ(b[10],0x08);
+	EXPECT_EQ(k0::bytes::get_be<k0::uint64_t>(b + 3),0x0102030405060708ULL);
+	k0::bytes::put_be<k0::int16_t>(b,-2);
+	EXPECT_EQ(k0::bytes::get_be<k0::int16_t>(b),-2);
+
+	//varint
+	k0::uint64_t values[] = {0,1,127,128,300,16383,16384,0xffffffffULL,0x7fffffffffffffffULL,0xffffffffffffffffULL};
+	for(std::size_t i=0;i<sizeof(values)/sizeof(values[0]);++i)
+	{
+		std::size_t n = k0::bytes::put_varint(b,values[i]);
+		EXPECT_EQ(n,k0::bytes::varint_size(values[i]));
+		k0::uint64_t v = 0;
+		EXPECT_EQ(k0::bytes::get_varint(b,n,v),n);
+		EXPECT_EQ(v,values[i]);
+		//
+		EXPECT_EQ(k0::bytes::get_varint(b,n - 1,v),0);
+	}
+	memset(b,0xff,sizeof(b));
+	k0::uint64_t v;
+	EXPECT_EQ(k0::bytes::get_varint(b,sizeof(b),v),k0::bytes::varint_error);
+	EXPECT_EQ(k0::bytes::zigzag_decode(k0::bytes::zigzag_encode(-1)),-1);
+	EXPECT_EQ(k0::bytes::zigzag_encode(-1),1);
+	EXPECT_EQ(k0::bytes::zigzag_encode(1),2);
+
+	//bytes_t
+	k0::bytes::bytes_t bytes(64);
+	k0::bytes::writer_t writer(bytes);
+	EXPECT_TRUE(writer.put_le<k0::uint16_t>(0xabcd));
+	EXPECT_TRUE(writer.put_be<k0::uint32_t>(7));
+	EXPECT_TRUE(writer.put_varint(300));
+	EXPECT_TRUE(writer.put((const k0::byte_t*)"ok",2));
+	EXPECT_FALSE(writer.put(bytes.get(),64));
+	k0::bytes::reader_t reader(bytes.get(),writer.offset());
+	k0::uint16_t u16;
+	k0::uint32_t u32;
+	char str[2];
+	EXPECT_TRUE(reader.get_le(u16));
+	EXPECT_EQ(u16,0xabcd);
+	EXPECT_TRUE(reader.get_be(u32));
+	EXPECT_EQ(u32,7);
+	EXPECT_TRUE(reader.get_varint(v));
+	EXPECT_EQ(v,300);
+	EXPECT_TRUE(reader.get((k0::byte_t*)str,2));
+	EXPECT_EQ(std::string(str,2),"ok");
+	EXPECT_FALSE(reader.get_le(u32));
+	EXPECT_EQ(reader.size(),0);
+
+	//buffer_t Խ K
+	k0::bytes::buffer_t buf(8);
+	for(k0::uint32_t i=0;i<100;++i)
+	{
+		EXPECT_TRUE(k0::bytes::write_be(buf,i * 1000003));
+		EXPECT_TRUE(k0::bytes::write_varint(buf,(k0::uint64_t)i << (i % 60)));
+	}
+	EXPECT_TRUE(k0::bytes::peek_be(buf,0,u32));
+	EXPECT_EQ(u32,0);
+	for(k0::uint32_t i=0;i<100;++i)
+	{
+		EXPECT_TRUE(k0::bytes::read_be(buf,u32));
+		EXPECT_EQ(u32,i * 1000003);
+		std::size_t n = k0::bytes::read_varint(buf,v);
+		EXPECT_EQ(n,k0::bytes::varint_size((k0::uint64_t)i << (i % 60)));
+		EXPECT_EQ(v,(k0::uint64_t)i << (i % 60));
+	}
+	EXPECT_FALSE(k0::bytes::read_le(buf,u32));
+	EXPECT_EQ(k0::bytes::read_varint(buf,v),0);
+
+	// a c  a ͬ
+	std::vector<k0::uint64_t> expect;
+	std::vector<k0::byte_t> data(4096);
+	std::size_t size = 0;
+	for(std::size_t i=0;i<300;++i)
+	{
+		k0::uint64_t x = i < 40 ? i : (i * 0x9e3779b97f4a7c15ULL) >> (i % 64);
+		expect.push_back(x);
+		size += k0::bytes::put_varint(&data[size],x);
+	}
+	std::vector<k0::uint64_t> out(expect.size() + 1);
+	std::size_t used;
+	EXPECT_EQ(k0::bytes::get_varints(&data[0],size,&out[0],out.size(),used),expect.size());
+	EXPECT_EQ(used,size);
+	out.resize(expect.size());
+	EXPECT_TRUE(out == expect);
+	// һ  a
+	EXPECT_EQ(k0::bytes::get_varints(&data[0],size - 1,&out[0],out.size(),used),expect.size() - 1);
+	EXPECT_LT(used,size);
+}
+
+TEST(TypeSmallBytes, HandleNoneZeroInput)
+{
+	k0::bytes::pool_stats_t s0 = k0::bytes::pool_t::instance().stats();
+	{
+		//СM c ƉK ֻ һη
+		k0::bytes::bytes_spt b = k0::bytes::make_bytes(20);
+		EXPECT_EQ(b->size(),20);
+		memset(b->get(),'s',20);
+		k0::bytes::pool_stats_t s1 = k0::bytes::pool_t::instance().stats();
+		EXPECT_EQ(s1.hits + s1.misses + s1.larges,s0.hits + s0.misses + s0.larges + 1);
+	}
+	{
+		k0::bytes::pool_stats_t s1 = k0::bytes::pool_t::instance().stats();
+		k0::bytes::bytes_spt b = k0::bytes::make_bytes(KING_BYTES_SMALL_SIZE + 1);
+		EXPECT_EQ(b->size(),KING_BYTES_SMALL_SIZE + 1);
+		k0::bytes::pool_stats_t s2 = k0::bytes::pool_t::instance().stats();
+		EXPECT_EQ(s2.hits + s2.misses + s2.larges,s1.hits + s1.misses + s1.larges + 2);
+	}
+
+	//^ 惦 r  pool_t 
+	k0::bytes::small_bytes_t<8> big(100);
+	EXPECT_EQ(big.size(),100);
+	memset(big.get(),'b',100);
+
+	// move r ؐ
+	k0::bytes::small_bytes_t<8> small(5);
+	memcpy(small.get(),"hello",5);
+	k0::bytes::bytes_t m(std::move(small));
+	EXPECT_TRUE(small.empty());
+	EXPECT_EQ(std::string((const char*)m.get(),m.size()),"hello");
+	m = std::move(big);
+	EXPECT_EQ(m.size(),100);
+	EXPECT_EQ(m.get()[99],'b');
+	EXPECT_TRUE(big.empty());
+
+	//slice_t::to_bytes ʹ 惦
+	k0::bytes::buffer_t buf;
+	buf.write((const k0::byte_t*)"ping",4);
+	k0::bytes::slice_t slice;
+	EXPECT_EQ(buf.read(4,slice),4);
+	k0::bytes::bytes_spt copy = slice.to_bytes();
+	EXPECT_TRUE(dynamic_cast<k0::bytes::small_bytes_t<>*>(copy.get()) != NULL);
+	EXPECT_EQ(std::string((const char*)copy->get(),copy->size()),"ping");
+}
+
+TEST(TypeBufferSpill, HandleNoneZeroInput)
+{
+	k0::bytes::buffer_t buf(16);
+	std::size_t npos = k0::bytes::buffer_t::npos;
+	EXPECT_TRUE(buf.spill(100,"/tmp"));
+	EXPECT_EQ(buf.spill(),100);
+
+	//c std::string 
+	std::string expect;
+	std::string str;
+	char bytes[256];
+	std::size_t spilled = 0;
+	for(int i=0;i<200;++i)
+	{
+		str.assign(1 + (i * 7) % 60,(char)('a' + i % 26));
+		EXPECT_EQ(buf.write((const k0::byte_t*)str.data(),str.size()),str.size());
+		expect += str;
+		if(i % 3 == 0)
+		{
+			//ֱ x Ɍ^
+			k0::bytes::buffer_t::mutable_buffers_t buffers;
+			EXPECT_EQ(buf.prepare(20,buffers),20);
+			std::size_t n0 = boost::asio::buffer_size(buffers[0]);
+			memset(boost::asio::buffer_cast<k0::byte_t*>(buffers[0]),'#',n0);
+			if(n0 < 20)
+			{
+				memset(boost::asio::buffer_cast<k0::byte_t*>(buffers[1]),'#',20 - n0);
+			}
+			EXPECT_EQ(buf.commit(20),20);
+			expect += std::string(20,'#');
+		}
+		EXPECT_EQ(buf.size(),expect.size());
+		spilled = std::max(spilled,buf.spilled());
+
+		std::size_t n = buf.copy_to(expect.size() / 2,(k0::byte_t*)bytes,sizeof(bytes));
+		EXPECT_EQ(std::string(bytes,n),expect.substr(expect.size() / 2,sizeof(bytes)));
+		std::size_t pos = expect.find("#a");
+		EXPECT_EQ(buf.find("#a"),pos == std::string::npos ? npos : pos);
+		EXPECT_EQ(buf.find('#',5),expect.find('#',5) == std::string::npos ? npos : expect.find('#',5));
+
+		if(i % 4 == 3)
+		{
+			k0::bytes::slice_t slice;
+			n = expect.size() / 3;
+			EXPECT_EQ(buf.read(n,slice),n);
+			EXPECT_EQ(std::string((const char*)slice.get(),slice.size()),expect.substr(0,n));
+			expect.erase(0,n);
+		}
+		else if(i % 4 == 1)
+		{
+			n = buf.read((k0::byte_t*)bytes,sizeof(bytes));
+			EXPECT_EQ(std::string(bytes,n),expect.substr(0,n));
+			expect.erase(0,n);
+		}
+	}
+	EXPECT_GT(spilled,0);
+	k0::bytes::buffer_t::const_buffers_t buffers;
+	EXPECT_EQ(buf.data(buffers),expect.size());
+	std::string data;
+	for(std::size_t i=0;i<buffers.size();++i)
+	{
+		data.append(boost::asio::buffer_cast<const char*>(buffers[i]),boost::asio::buffer_size(buffers[i]));
+	}
+	EXPECT_EQ(data,expect);
+
+	//x ļ  ֏ ʹ ȴ
+	EXPECT_EQ(buf.consume(buf.size()),expect.size());
+	EXPECT_EQ(buf.spilled(),0);
+	buf.write((const k0::byte_t*)"abc",3);
+	EXPECT_EQ(buf.spilled(),0);
+	EXPECT_EQ(buf.size(),3);
+}
+
+TEST(TypeSpillFile, HandleNoneZeroInput)
+{
+	//M ͣ e н r ļ С Ҳ н
+	k0::bytes::spill_file_t file("/tmp");
+	std::vector<k0::byte_t> bytes(64 * 1024);
+	std::vector<k0::byte_t> out(bytes.size());
+	k0::uint32_t written = 0;
+	k0::uint32_t consumed = 0;
+	std::size_t backlog = 0;
+	std::size_t bad = 0;
+	for(int i=0;i<1024;++i)
+	{
+		// ɉK x  ɉK e    ǻ
+		for(int j=0;j<2;++j)
+		{
+			for(std::size_t k=0;k<bytes.size();++k)
+			{
+				bytes[k] = (k0::byte_t)(written++ * 31);
+			}
+			EXPECT_EQ(file.write(&bytes[0],bytes.size()),bytes.size());
+		}
+		std::size_t n = file.size() > 3 * 1024 * 1024 ? 2 * bytes.size() : bytes.size() + 1000;
+		while(n)
+		{
+			std::size_t count = file.read(&out[0],std::min(n,out.size()));
+			EXPECT_GT(count,0);
+			for(std::size_t k=0;k<count;++k)
+			{
+				bad += out[k] != (k0::byte_t)(consumed++ * 31);
+			}
+			n -= count;
+		}
+		backlog = std::max(backlog,file.size());
+	}
+	//  128MB ļ ^ e  4 
+	EXPECT_EQ(bad,0);
+	EXPECT_GT(backlog,0);
+	EXPECT_LE(file.capacity(),4 * (backlog + 2 * bytes.size()));
+	EXPECT_EQ(file.size(),(std::size_t)(written - consumed));
+}
+
+TEST(TypeCrc32c, HandleNoneZeroInput)
+{
+	EXPECT_EQ(k0::bytes::crc32c((const k0::byte_t*)"123456789",9),0xe3069283);
+	EXPECT_EQ(k0::bytes::crc32c(NULL,0),0);
+
+	std::string str;
+	for(int i=0;i<1000;++i)
+	{
+		str += (char)(i * 31 + 7);
+	}
+	const k0::byte_t* p = (const k0::byte_t*)str.data();
+	k0::uint32_t expect = k0::bytes::crc32c(p,str.size());
+	for(std::size_t i=0;i<=str.size();i += 37)
+	{
+		EXPECT_EQ(k0::bytes::crc32c_extend(k0::bytes::crc32c(p,i),p + i,str.size() - i),expect);
+		EXPECT_EQ(~k0::bytes::crc32c_scalar(~0U,p,i),k0::bytes::crc32c(p,i));
+#if defined(KING_CPU_SSE42)
+		if(k0::cpu::features().sse42)
+		{
+			EXPECT_EQ(k0::bytes::crc32c_sse42(0x12345678,p + 1,i),k0::bytes::crc32c_scalar(0x12345678,p + 1,i));
+		}
+#endif
+	}
+
+	// ֶ _ Խ K
+	k0::bytes::buffer_t buf(64);
+	k0::bytes::crc32c_stream_t crc;
+	for(std::size_t i=0;i<str.size();i += 13)
+	{
+		buf.write(p + i,std::min<std::size_t>(13,str.size() - i));
+		crc.update(buf,500);
+	}
+	EXPECT_EQ(crc.hashed(),500);
+	EXPECT_EQ(crc.value(),k0::bytes::crc32c(p,500));
+	buf.consume(500);
+	crc.reset();
+	EXPECT_TRUE(crc.update(buf,500));
+	EXPECT_EQ(crc.value(),k0::bytes::crc32c(p + 500,500));
+	EXPECT_FALSE(crc.update(buf,501));
+}
@@ -0,0 +1,155 @@
+/*
+*	連接風暴 下 server_t 的 接受延遲
+*
+*	多個 線程 按 指定 速率 不停 建立 新連接 連接後 立刻 發送 connect 之前的 時間戳 並 以 RST 關閉\n
+*	服務器 收到 時間戳 時 記錄 延遲 (握手 + accept + 投遞 recv) 之後 斷開\n
+*	報告 實際 每秒 連接數 以及 延遲 的 p50 p99 p999
+*
+*	g++ -std=c++11 -O2 -I../../../../include bench_accept.cpp -o bench_accept -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./bench_accept [每秒連接數=20000] [秒=5] [生成線程數=4] [分片數=0]
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef boost::chrono::steady_clock clock_t_;
+
+//延遲 直方圖 10us 一格 最大 1s
+static const std::size_t g_buckets = 100 * 1000;
+static boost::atomic<k0::uint32_t> g_histogram[g_buckets + 1];
+static boost::atomic<k0::uint64_t> g_accepts(0);
+
+static k0::uint64_t now_us()
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>(clock_t_::now().time_since_epoch()).count();
+}
+
+class server_t : public server_bt
+{
+public:
+	server_t(const std::string& addr,std::size_t shards)
+		:server_bt(addr,0,shards)
+	{
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		if(n >= sizeof(k0::uint64_t))
+		{
+			k0::uint64_t start;
+			memcpy(&start,b,sizeof(start));
+			k0::uint64_t us = now_us() - start;
+			std::size_t i = (std::size_t)(us / 10);
+			g_histogram[i < g_buckets ? i : g_buckets].fetch_add(1,boost::memory_order_relaxed);
+			g_accepts.fetch_add(1,boost::memory_order_relaxed);
+		}
+		//記錄後 斷開
+		return false;
+	}
+};
+
+static void generate(unsigned short port,std::size_t id,std::size_t threads,double rate,clock_t_::time_point deadline,boost::atomic<k0::uint64_t>* failed)
+{
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port);
+	//每個 線程 平分 速率
+	boost::chrono::nanoseconds interval((k0::int64_t)(1e9 * threads / rate));
+	clock_t_::time_point next = clock_t_::now();
+	for(std::size_t i=0;clock_t_::now() < deadline;++i)
+	{
+		next += interval;
+		boost::this_thread::sleep_until(next);
+
+		boost::asio::ip::tcp::socket s(io_s);
+		boost::system::error_code e;
+		s.open(boost::asio::ip::tcp::v4(),e);
+		//使用 不同的 本地地址 避免 臨時端口 耗盡
+		std::size_t n = i * threads + id;
+		char local[32];
+		sprintf(local,"127.%u.%u.%u",(unsigned)(1 + n / 62500 % 250),(unsigned)(n / 250 % 250),(unsigned)(2 + n % 250));
+		s.bind(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(local),0),e);
+		k0::uint64_t start = now_us();
+		if(!e)
+		{
+			s.connect(endpoint,e);
+		}
+		if(!e)
+		{
+			boost::asio::write(s,boost::asio::buffer(&start,sizeof(start)),e);
+		}
+		if(e)
+		{
+			failed->fetch_add(1,boost::memory_order_relaxed);
+			continue;
+		}
+		//RST 關閉 不留下 TIME_WAIT
+		s.set_option(boost::asio::socket_base::linger(true,0),e);
+		s.close(e);
+	}
+}
+
+static double percentile(k0::uint64_t total,double p)
+{
+	k0::uint64_t want = (k0::uint64_t)(total * p);
+	k0::uint64_t sum = 0;
+	for(std::size_t i=0;i<=g_buckets;++i)
+	{
+		sum += g_histogram[i];
+		if(sum > want)
+		{
+			return (double)i * 10;
+		}
+	}
+	return (double)g_buckets * 10;
+}
+
+int main(int argc,char* argv[])
+{
+	double rate = argc > 1 ? atof(argv[1]) : 20000;
+	int seconds = argc > 2 ? atoi(argv[2]) : 5;
+	std::size_t threads = argc > 3 ? (std::size_t)atoi(argv[3]) : 4;
+	std::size_t shards = argc > 4 ? (std::size_t)atoi(argv[4]) : 0;
+	if(!threads)
+	{
+		threads = 1;
+	}
+	for(std::size_t i=0;i<=g_buckets;++i)
+	{
+		g_histogram[i] = 0;
+	}
+
+	try
+	{
+		server_t server("127.0.0.1:23467",shards);
+		boost::atomic<k0::uint64_t> failed(0);
+		clock_t_::time_point deadline = clock_t_::now() + boost::chrono::seconds(seconds);
+		boost::thread_group generators;
+		for(std::size_t i=0;i<threads;++i)
+		{
+			generators.create_thread(boost::bind(generate,(unsigned short)23467,i,threads,rate,deadline,&failed));
+		}
+		generators.join_all();
+		//等待 最後的 連接
+		boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+		k0::uint64_t accepts = g_accepts;
+		printf("rate=%-7.0f shards=%-3u threads=%-3u connects/s=%-8.0f failed=%-6u p50=%.0fus p99=%.0fus p999=%.0fus\n",
+			rate,(unsigned)shards,(unsigned)server.work_threads(),
+			(double)accepts / seconds,(unsigned)failed,
+			percentile(accepts,0.5),
+			percentile(accepts,0.99),
+			percentile(accepts,0.999)
+		);
+	}
+	catch(const k0::exception& e)
+	{
+		printf("%s\n",e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+*	大量 空閒 連接 時 server_t 和 msg_server_t 的 內存 佔用 默認模式 與 reactive 模式 的 對比
+*
+*	每個 連接 發送 一條 消息 後 保持 空閒 報告 進程 常駐內存 的 增量 (linux /proc/self/statm)\n
+*	msg_server_t 直接 讀入 消息緩衝區 reactive 模式 在 消息 讀空 後 釋放 緩衝區 的 數據塊
+*
+*	g++ -std=c++11 -O2 -I../../../../include bench_idle.cpp -o bench_idle -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./bench_idle [連接數=5000]
+*	./bench_idle 100000		(需要 ulimit -n 大於 200000)
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+#include <k0/net/tcp/msg_server.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+#include <sys/resource.h>
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef k0::net::tcp::msg_server_t<int> msg_server_bt;
+
+//每個 連接 發送的 消息 包含 4 字節 消息頭
+static const std::size_t g_msg_size = 16;
+
+class server_t : public server_bt
+{
+public:
+	boost::atomic<std::size_t> recvs;
+	server_t(const std::string& addr,std::size_t conns,bool reactive)
+		:server_bt(addr,conns,0,k0::net::tcp::thread_config_t(2)),recvs(0)
+	{
+		server_bt::reactive(reactive);
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		recvs += n;
+		return true;
+	}
+	//是否 收到 所有 連接的 消息
+	bool received(std::size_t conns)const
+	{
+		return recvs >= conns * g_msg_size;
+	}
+};
+
+class msg_server_t : public msg_server_bt
+{
+public:
+	boost::atomic<std::size_t> msgs;
+	msg_server_t(const std::string& addr,std::size_t conns,bool reactive)
+		:msg_server_bt(addr,conns,4,boost::bind(&msg_server_bt::reader_header,_1,_2),0,k0::net::tcp::thread_config_t(2)),msgs(0)
+	{
+		msg_server_bt::reactive(reactive);
+	}
+	virtual bool on_slice(socket_spt& s,k0::bytes::slice_t& msg)
+	{
+		++msgs;
+		return true;
+	}
+	bool received(std::size_t conns)const
+	{
+		return msgs >= conns;
+	}
+};
+
+static double rss_mb()
+{
+	FILE* f = fopen("/proc/self/statm","r");
+	if(!f)
+	{
+		return 0;
+	}
+	unsigned long size = 0,resident = 0;
+	if(fscanf(f,"%lu %lu",&size,&resident) != 2)
+	{
+		resident = 0;
+	}
+	fclose(f);
+	return (double)resident * sysconf(_SC_PAGESIZE) / 1024 / 1024;
+}
+
+template<typename S>
+static void run(const char* name,unsigned short port,std::size_t conns,bool reactive)
+{
+	char addr[64];
+	sprintf(addr,"127.0.0.1:%u",(unsigned)port);
+	double before = rss_mb();
+	S server(addr,conns + 16,reactive);
+
+	boost::asio::io_service io_s;
+	std::vector<boost::asio::ip::tcp::socket*> sockets;
+	sockets.reserve(conns);
+	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port);
+	char msg[g_msg_size] = {(char)g_msg_size,0,0,0,'h','e','l','l','o'};
+	for(std::size_t i=0;i<conns;++i)
+	{
+		boost::asio::ip::tcp::socket* s = new boost::asio::ip::tcp::socket(io_s);
+		boost::system::error_code e;
+		s->open(boost::asio::ip::tcp::v4(),e);
+		//使用 不同的 本地地址 避免 臨時端口 耗盡
+		char local[32];
+		sprintf(local,"127.0.%u.%u",(unsigned)(i / 250 % 250),(unsigned)(2 + i % 250));
+		s->bind(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(local),0),e);
+		if(!e)
+		{
+			s->connect(endpoint,e);
+		}
+		if(!e)
+		{
+			boost::asio::write(*s,boost::asio::buffer(msg,sizeof(msg)),e);
+		}
+		if(e)
+		{
+			printf("%s: connect %u failed %s\n",name,(unsigned)i,e.message().c_str());
+			delete s;
+			break;
+		}
+		sockets.push_back(s);
+	}
+	for(int i=0;i<500 && !server.received(sockets.size());++i)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+	}
+
+	double after = rss_mb();
+	printf("%-13s conns=%-7u rss=+%.1fMB (%.0f bytes/conn)\n",
+		name,(unsigned)sockets.size(),after - before,
+		sockets.empty() ? 0.0 : (after - before) * 1024 * 1024 / sockets.size()
+	);
+	for(std::size_t i=0;i<sockets.size();++i)
+	{
+		delete sockets[i];
+	}
+}
+
+int main(int argc,char* argv[])
+{
+	std::size_t conns = argc > 1 ? (std::size_t)atoi(argv[1]) : 5000;
+
+	//客戶端 和 服務器 在 同一進程 需要 兩倍 連接數 的 描述符
+	rlimit limit;
+	if(!getrlimit(RLIMIT_NOFILE,&limit))
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE,&limit);
+		if(limit.rlim_cur < conns * 2 + 64)
+		{
+			printf("warning: RLIMIT_NOFILE %u is too small for %u connections\n",(unsigned)limit.rlim_cur,(unsigned)conns);
+		}
+	}
+
+	try
+	{
+		//reactive 先 運行 避免 默認模式 釋放的 內存 留在 進程中 影響 結果
+		run<server_t>("reactive",23462,conns,true);
+		run<msg_server_t>("msg reactive",23464,conns,true);
+		run<server_t>("default",23463,conns,false);
+		run<msg_server_t>("msg default",23465,conns,false);
+	}
+	catch(const k0::exception& e)
+	{
+		printf("%s\n",e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+*	多個 線程 向 同一個 socket 發送 數據 時 發送隊列 的 競爭
+*
+*	對比 socket_t 的 無鎖 mpsc 隊列 與 之前的 mutex + std::list\n
+*	write 被模擬爲 立刻完成 負責 write 的 線程 直接 取出 下一批 數據
+*
+*	g++ -std=c++11 -O2 -I../../../../include bench_send.cpp -o bench_send -lbenchmark -lpthread -lboost_thread -lboost_chrono -lboost_system
+*/
+#include <k0/net/tcp/type.hpp>
+
+#include <list>
+
+#include <benchmark/benchmark.h>
+
+typedef k0::net::tcp::socket_t<int> socket_t;
+typedef k0::net::tcp::bytes_spt bytes_spt;
+
+//每個 生產者 發送的 數據 條數
+static const int g_count = 1024 * 16;
+
+//之前的 實現
+class locked_queue_t
+{
+	std::list<bytes_spt> _datas;
+	boost::mutex _mutex;
+	bool _wait;
+public:
+	locked_queue_t():_wait(false)
+	{
+	}
+	void push_send(const bytes_spt& buffer)
+	{
+		bytes_spt next;
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			if(_wait)
+			{
+				_datas.push_back(buffer);
+				return;
+			}
+			_wait = true;
+			next = buffer;
+		}
+		while(true)
+		{
+			benchmark::DoNotOptimize(next->get());
+
+			boost::mutex::scoped_lock lock(_mutex);
+			if(_datas.empty())
+			{
+				_wait = false;
+				return;
+			}
+			next = _datas.front();
+			_datas.pop_front();
+		}
+	}
+};
+
+static void push_send(socket_t& s,const bytes_spt& buffer)
+{
+	if(!s.push_send(buffer))
+	{
+		return;
+	}
+	std::size_t n;
+	do
+	{
+		while(!(n = s.pop_sends()))
+		{
+			boost::this_thread::yield();
+		}
+		benchmark::DoNotOptimize(s._iov.data());
+		s._batch.clear();
+	}while(s.sent(n));
+}
+
+template<typename F>
+static void run(benchmark::State& state,F f)
+{
+	int n = (int)state.range(0);
+	bytes_spt buffer = k0::bytes::make_bytes(64);
+	for(auto _ : state)
+	{
+		boost::thread_group threads;
+		for(int i=0;i<n;++i)
+		{
+			threads.create_thread([&f,&buffer]
+			{
+				for(int j=0;j<g_count;++j)
+				{
+					f(buffer);
+				}
+			});
+		}
+		threads.join_all();
+	}
+	state.SetItemsProcessed(state.iterations() * n * g_count);
+}
+
+static void BM_SendMpsc(benchmark::State& state)
+{
+	k0::net::tcp::io_service_t io_s;
+	socket_t s(io_s);
+	run(state,[&s](const bytes_spt& buffer)
+	{
+		push_send(s,buffer);
+	});
+}
+BENCHMARK(BM_SendMpsc)->RangeMultiplier(2)->Range(1,64)->UseRealTime();
+
+static void BM_SendLocked(benchmark::State& state)
+{
+	locked_queue_t q;
+	run(state,[&q](const bytes_spt& buffer)
+	{
+		q.push_send(buffer);
+	});
+}
+BENCHMARK(BM_SendLocked)->RangeMultiplier(2)->Range(1,64)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,240 @@
+/*
+*	server_t 默認模式 (共享 io_service) 與 分片模式 (每核心 一個 事件循環 + SO_REUSEPORT) 的 對比
+*
+*	服務器 原樣 返回 收到的 數據 每個 客戶端 連接 不停 發送 32 字節 消息 並 等待 回覆\n
+*	報告 每秒 消息數 以及 往返延遲 的 p50 p99
+*
+*	g++ -std=c++11 -O2 -I../../../../include bench_shard.cpp -o bench_shard -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./bench_shard [連接數=1000] [秒=5] [分片數=cpu核心數]
+*	./bench_shard 50000 10		(需要 ulimit -n 大於 100000)
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef boost::chrono::steady_clock clock_t_;
+
+static const std::size_t g_size = 32;
+//延遲 直方圖 1us 一格 最大 1s
+static const std::size_t g_buckets = 1000 * 1000;
+
+class echo_server_t : public server_bt
+{
+public:
+	echo_server_t(const std::string& addr,std::size_t conns,std::size_t shards)
+		:server_bt(addr,conns,shards)
+	{
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		return push_send(s,b,n);
+	}
+};
+
+//每個 客戶端 事件循環 一份 只在 該循環 線程 訪問
+struct stats_t
+{
+	std::vector<k0::uint32_t> histogram;
+	k0::uint64_t msgs;
+	stats_t():histogram(g_buckets + 1,0),msgs(0)
+	{
+	}
+};
+
+class connection_t : public boost::enable_shared_from_this<connection_t>
+{
+	boost::asio::ip::tcp::socket _s;
+	stats_t& _stats;
+	const clock_t_::time_point& _deadline;
+	k0::byte_t _buffer[g_size];
+	clock_t_::time_point _start;
+public:
+	connection_t(k0::net::tcp::io_service_t& io_s,stats_t& stats,const clock_t_::time_point& deadline)
+		:_s(io_s),_stats(stats),_deadline(deadline)
+	{
+		memset(_buffer,'p',g_size);
+	}
+	boost::asio::ip::tcp::socket& socket()
+	{
+		return _s;
+	}
+	void start()
+	{
+		_start = clock_t_::now();
+		boost::asio::async_write(_s,boost::asio::buffer(_buffer,g_size),
+			boost::bind(&connection_t::on_write,shared_from_this(),boost::asio::placeholders::error));
+	}
+	void close()
+	{
+		boost::system::error_code e;
+		_s.close(e);
+	}
+protected:
+	void on_write(const boost::system::error_code& e)
+	{
+		if(e)
+		{
+			return;
+		}
+		boost::asio::async_read(_s,boost::asio::buffer(_buffer,g_size),
+			boost::bind(&connection_t::on_read,shared_from_this(),boost::asio::placeholders::error));
+	}
+	void on_read(const boost::system::error_code& e)
+	{
+		if(e)
+		{
+			return;
+		}
+		clock_t_::time_point now = clock_t_::now();
+		k0::uint64_t us = boost::chrono::duration_cast<boost::chrono::microseconds>(now - _start).count();
+		++_stats.histogram[us < g_buckets ? us : g_buckets];
+		++_stats.msgs;
+		if(now < _deadline)
+		{
+			start();
+		}
+	}
+};
+typedef boost::shared_ptr<connection_t> connection_spt;
+
+static double percentile(const std::vector<k0::uint64_t>& histogram,k0::uint64_t total,double p)
+{
+	k0::uint64_t want = (k0::uint64_t)(total * p);
+	k0::uint64_t sum = 0;
+	for(std::size_t i=0;i<histogram.size();++i)
+	{
+		sum += histogram[i];
+		if(sum > want)
+		{
+			return (double)i;
+		}
+	}
+	return (double)histogram.size();
+}
+
+static void run(const char* name,unsigned short port,std::size_t conns,int seconds,std::size_t shards)
+{
+	char addr[64];
+	sprintf(addr,"127.0.0.1:%u",(unsigned)port);
+	echo_server_t server(addr,conns + 16,shards);
+
+	//客戶端 使用 兩個 事件循環 不綁定 cpu
+	k0::net::tcp::io_pool_t clients((k0::net::tcp::thread_config_t(2)));
+	std::vector<stats_t> stats(clients.size());
+	clock_t_::time_point deadline = clock_t_::now() + boost::chrono::hours(24);
+
+	std::vector<connection_spt> connections;
+	connections.reserve(conns);
+	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port);
+	for(std::size_t i=0;i<conns;++i)
+	{
+		std::size_t loop = i % clients.size();
+		connection_spt c = boost::make_shared<connection_t>(boost::ref(clients.get(loop)),boost::ref(stats[loop]),boost::cref(deadline));
+		boost::system::error_code e;
+		c->socket().open(boost::asio::ip::tcp::v4(),e);
+		//使用 不同的 本地地址 避免 臨時端口 耗盡
+		char local[32];
+		sprintf(local,"127.0.%u.%u",(unsigned)(i / 250 % 250),(unsigned)(2 + i % 250));
+		c->socket().bind(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(local),0),e);
+		if(!e)
+		{
+			c->socket().connect(endpoint,e);
+		}
+		if(e)
+		{
+			printf("%s: connect %u failed %s\n",name,(unsigned)i,e.message().c_str());
+			break;
+		}
+		boost::asio::ip::tcp::no_delay option(true);
+		c->socket().set_option(option,e);
+		connections.push_back(c);
+	}
+
+	//預熱 後 開始 統計
+	deadline = clock_t_::now() + boost::chrono::seconds(seconds + 1);
+	for(std::size_t i=0;i<connections.size();++i)
+	{
+		clients.get(i % clients.size()).post(boost::bind(&connection_t::start,connections[i]));
+	}
+	boost::this_thread::sleep(boost::posix_time::seconds(1));
+	for(std::size_t i=0;i<clients.size();++i)
+	{
+		clients.get(i).post([&stats,i]
+		{
+			stats[i] = stats_t();
+		});
+	}
+	boost::this_thread::sleep(boost::posix_time::seconds(seconds));
+	//超過 deadline 的 連接 不再 發送 等待 最後的 回覆
+	boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+	clients.stop();
+	clients.join();
+
+	std::vector<k0::uint64_t> histogram(g_buckets + 1,0);
+	k0::uint64_t msgs = 0;
+	for(std::size_t i=0;i<stats.size();++i)
+	{
+		msgs += stats[i].msgs;
+		for(std::size_t j=0;j<histogram.size();++j)
+		{
+			histogram[j] += stats[i].histogram[j];
+		}
+	}
+	printf("%-8s shards=%-3u conns=%-6u threads=%-3u msgs/s=%-10.0f p50=%.0fus p99=%.0fus\n",
+		name,(unsigned)shards,(unsigned)connections.size(),(unsigned)server.work_threads(),
+		(double)msgs / seconds,
+		percentile(histogram,msgs,0.5),
+		percentile(histogram,msgs,0.99)
+	);
+	for(std::size_t i=0;i<connections.size();++i)
+	{
+		connections[i]->close();
+	}
+}
+
+int main(int argc,char* argv[])
+{
+	std::size_t conns = argc > 1 ? (std::size_t)atoi(argv[1]) : 1000;
+	int seconds = argc > 2 ? atoi(argv[2]) : 5;
+	std::size_t shards = argc > 3 ? (std::size_t)atoi(argv[3]) : boost::thread::hardware_concurrency();
+	if(!shards)
+	{
+		shards = 1;
+	}
+
+#ifndef _WIN32
+	//客戶端 和 服務器 在 同一進程 需要 兩倍 連接數 的 描述符
+	rlimit limit;
+	if(!getrlimit(RLIMIT_NOFILE,&limit))
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE,&limit);
+		if(limit.rlim_cur < conns * 2 + 64)
+		{
+			printf("warning: RLIMIT_NOFILE %u is too small for %u connections\n",(unsigned)limit.rlim_cur,(unsigned)conns);
+		}
+	}
+#endif
+
+	try
+	{
+		run("shared",23460,conns,seconds,0);
+		run("sharded",23461,conns,seconds,shards);
+	}
+	catch(const k0::exception& e)
+	{
+		printf("%s\n",e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+*	server_t 定時器 schedule_after schedule_every 的 吞吐
+*
+*	1 arm 隨機 延遲 的 定時器 報告 每秒 arm 數 以及 執行 延遲 (實際 執行 - 到期) 的 p50 p99 p999\n
+*	2 arm 後 立刻 cancel 報告 每秒 cancel 數\n
+*	3 同時 到期的 定時器 報告 每秒 執行數\n
+*	4 schedule_every 10ms 運行 1s 報告 執行 次數
+*
+*	g++ -std=c++11 -O2 -I../../../../include bench_timer.cpp -o bench_timer -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./bench_timer [定時器數=1000000] [分片數=0] [最大延遲毫秒=1000]
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+typedef k0::net::tcp::server_t<int> server_t;
+typedef boost::chrono::steady_clock clock_t_;
+
+//延遲 直方圖 100us 一格 最大 10s
+static const std::size_t g_buckets = 100 * 1000;
+static boost::atomic<k0::uint32_t> g_histogram[g_buckets + 1];
+static boost::atomic<k0::uint64_t> g_fires(0);
+static boost::atomic<k0::uint64_t> g_first(0);
+static boost::atomic<k0::uint64_t> g_last(0);
+
+static k0::uint64_t now_us()
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>(clock_t_::now().time_since_epoch()).count();
+}
+
+static void on_fire(k0::uint64_t due)
+{
+	k0::uint64_t now = now_us();
+	std::size_t i = now > due ? (std::size_t)((now - due) / 100) : 0;
+	g_histogram[i < g_buckets ? i : g_buckets].fetch_add(1,boost::memory_order_relaxed);
+	g_fires.fetch_add(1,boost::memory_order_relaxed);
+	k0::uint64_t zero = 0;
+	g_first.compare_exchange_strong(zero,now);
+	g_last.store(now,boost::memory_order_relaxed);
+}
+
+static double percentile(k0::uint64_t total,double p)
+{
+	k0::uint64_t want = (k0::uint64_t)(total * p);
+	k0::uint64_t sum = 0;
+	for(std::size_t i=0;i<=g_buckets;++i)
+	{
+		sum += g_histogram[i];
+		if(sum > want)
+		{
+			return (double)i / 10;
+		}
+	}
+	return (double)g_buckets / 10;
+}
+
+static void reset()
+{
+	for(std::size_t i=0;i<=g_buckets;++i)
+	{
+		g_histogram[i] = 0;
+	}
+	g_fires = 0;
+	g_first = 0;
+}
+
+static void wait_fires(k0::uint64_t count)
+{
+	while(g_fires < count)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+	}
+}
+
+int main(int argc,char* argv[])
+{
+	std::size_t count = argc > 1 ? (std::size_t)atoi(argv[1]) : 1000000;
+	std::size_t shards = argc > 2 ? (std::size_t)atoi(argv[2]) : 0;
+	std::size_t spread = argc > 3 ? (std::size_t)atoi(argv[3]) : 1000;
+	if(!spread)
+	{
+		spread = 1;
+	}
+
+	try
+	{
+		server_t server("127.0.0.1:23472",1024,shards);
+		srand(1);
+
+		//隨機 延遲
+		reset();
+		k0::uint64_t start = now_us();
+		for(std::size_t i=0;i<count;++i)
+		{
+			std::size_t delay = (std::size_t)rand() % spread;
+			server.schedule_after(delay,boost::bind(on_fire,now_us() + delay * 1000));
+		}
+		k0::uint64_t used = now_us() - start;
+		wait_fires(count);
+		printf("arm:    timers=%-8u shards=%-3u arms/s=%-10.0f late p50=%.1fms p99=%.1fms p999=%.1fms\n",
+			(unsigned)count,(unsigned)shards,count * 1e6 / used,
+			percentile(count,0.5),percentile(count,0.99),percentile(count,0.999));
+
+		//cancel
+		std::vector<k0::net::tcp::timer_id_t> ids(count);
+		for(std::size_t i=0;i<count;++i)
+		{
+			ids[i] = server.schedule_after(60 * 1000 + rand() % spread,boost::bind(on_fire,0));
+		}
+		start = now_us();
+		std::size_t cancels = 0;
+		for(std::size_t i=0;i<count;++i)
+		{
+			if(server.cancel_timer(ids[i]))
+			{
+				++cancels;
+			}
+		}
+		used = now_us() - start;
+		printf("cancel: timers=%-8u cancelled=%-8u cancels/s=%-10.0f\n",
+			(unsigned)count,(unsigned)cancels,count * 1e6 / used);
+
+		//同時 到期
+		reset();
+		for(std::size_t i=0;i<count;++i)
+		{
+			server.schedule_after(200,boost::bind(on_fire,0));
+		}
+		wait_fires(count);
+		used = g_last - g_first;
+		printf("fire:   timers=%-8u fires/s=%-10.0f\n",
+			(unsigned)count,count * 1e6 / (used ? used : 1));
+
+		//週期 定時器
+		reset();
+		k0::net::tcp::timer_id_t id = server.schedule_every(10,boost::bind(on_fire,0));
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1000));
+		bool cancelled = server.cancel_timer(id);
+		printf("every:  10ms for 1s fires=%u cancel=%s\n",(unsigned)g_fires,cancelled ? "ok" : "bad");
+	}
+	catch(const k0::exception& e)
+	{
+		printf("%s\n",e.what());
+		return 1;
+	}
+	return 0;
+}
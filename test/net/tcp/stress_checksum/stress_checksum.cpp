@@ -0,0 +1,261 @@
+/*
+*	驗證 msg_server_t msg_client_t 的 crc32c 校驗
+*
+*	1 開啓 checksum 的 msg_client_t 與 echo msg_server_t 使用 push_msg 往返 消息 完整 有序\n
+*	2 兩個 消息 在 每一個 字節 位置 (包括 校驗 內部) 分兩次 發送 服務器 增量 計算的 crc 都 正確\n
+*	  分別 使用 默認 消息緩衝區 溢出到 磁盤的 消息緩衝區 和 鏡像環形緩衝區\n
+*	3 校驗 或 包體 被 修改 時 服務器 斷開連接 並且 不回調 on_msg
+*
+*	每條 消息 [4字節 長度][4字節 序號][內容][4字節 crc32c] 內容 由 序號 生成 長度 不包含 校驗
+*
+*	g++ -std=c++11 -O2 -I../../../../include stress_checksum.cpp -o stress_checksum -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./stress_checksum 成功 返回 0
+*/
+#include <k0/bytes/codec.hpp>
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/msg_server.hpp>
+#include <k0/net/tcp/msg_client.hpp>
+
+#include <cstdio>
+#include <vector>
+
+typedef k0::net::tcp::bytes_spt bytes_spt;
+
+//往返 消息數
+static const int g_count = 2000;
+//消息 最大長度 (不超過 KING_NET_TCP_MAX_MSG_SIZE)
+static const std::size_t g_max = 1024 * 8;
+
+static k0::byte_t pattern(k0::uint32_t seq,std::size_t i)
+{
+	return (k0::byte_t)(seq * 31 + i * 7);
+}
+static std::size_t size_of(k0::uint32_t seq)
+{
+	return 8 + (seq * 2654435761u) % g_max;
+}
+//創建 消息 的 header + body
+static std::vector<k0::byte_t> make_body(k0::uint32_t seq,std::size_t n)
+{
+	std::vector<k0::byte_t> b(n);
+	k0::bytes::put_le<k0::uint32_t>(&b[0],(k0::uint32_t)n);
+	k0::bytes::put_le<k0::uint32_t>(&b[4],seq);
+	for(std::size_t j=8;j<n;++j)
+	{
+		b[j] = pattern(seq,j);
+	}
+	return b;
+}
+//消息 內容 正確 返回 true
+static bool check(const k0::byte_t* p,std::size_t n,k0::uint32_t seq)
+{
+	if(n < 8 || k0::bytes::get_le<k0::uint32_t>(p) != n || k0::bytes::get_le<k0::uint32_t>(p + 4) != seq)
+	{
+		return false;
+	}
+	for(std::size_t j=8;j<n;++j)
+	{
+		if(p[j] != pattern(seq,j))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void sleep_ms(int ms)
+{
+	boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+}
+
+//按 序號 檢查 消息 並 可選 echo
+template<typename B>
+class server_t : public B
+{
+public:
+	typedef typename B::socket_spt socket_spt;
+	boost::atomic<int> msgs;
+	boost::atomic<int> bad;
+	boost::atomic<int> closes;
+	bool echo;
+
+	server_t(const std::string& addr,bool echo_ = false)
+		:B(addr),msgs(0),bad(0),closes(0),echo(echo_)
+	{
+		this->checksum(true);
+	}
+	virtual bool on_msg(socket_spt& s,bytes_spt& msg)
+	{
+		if(echo)
+		{
+			++msgs;
+			return this->push_msg(s,msg);
+		}
+		//未 echo 時 序號 從0 連續
+		if(!check(msg->get(),msg->size(),(k0::uint32_t)(int)msgs))
+		{
+			++bad;
+		}
+		++msgs;
+		return true;
+	}
+	virtual void on_close(socket_spt& s)
+	{
+		++closes;
+	}
+};
+typedef server_t<k0::net::tcp::msg_server_t<int> > msg_server_t;
+typedef server_t<k0::net::tcp::msg_server_t<int,1024*4,k0::net::tcp::mirror_msg_buffer_spt> > mirror_server_t;
+
+class client_t : public k0::net::tcp::msg_client_t<int>
+{
+public:
+	boost::atomic<int> msgs;
+	boost::atomic<int> bad;
+
+	explicit client_t(const std::string& addr)
+		:k0::net::tcp::msg_client_t<int>(addr,4,boost::bind(&msg_client_t::reader_header,_1,_2),k0::net::tcp::thread_config_t(),false),msgs(0),bad(0)
+	{
+		checksum(true);
+		start();
+	}
+	virtual bool on_msg(bytes_spt& msg)
+	{
+		if(!check(msg->get(),msg->size(),(k0::uint32_t)(int)msgs))
+		{
+			++bad;
+		}
+		++msgs;
+		return true;
+	}
+};
+
+static void open_client(boost::asio::ip::tcp::socket& c,unsigned short port)
+{
+	c.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port));
+	c.set_option(boost::asio::ip::tcp::no_delay(true));
+}
+
+//對方 已經 斷開 時 返回 true
+static bool closed_by_peer(boost::asio::ip::tcp::socket& c)
+{
+	char b[16];
+	boost::system::error_code e;
+	c.read_some(boost::asio::buffer(b),e);
+	return e ? true : false;
+}
+
+//msg_client_t 與 msg_server_t 往返
+static bool test_roundtrip(unsigned short port)
+{
+	msg_server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port),true);
+	client_t c("127.0.0.1:" + boost::lexical_cast<std::string>(port));
+	for(int i=0;i<g_count;++i)
+	{
+		std::vector<k0::byte_t> b = make_body((k0::uint32_t)i,size_of((k0::uint32_t)i));
+		//一半 分開 發送 消息頭 和 消息體
+		bool ok = i % 2 ? c.push_msg(&b[0],b.size()) : c.push_msg(&b[0],4,&b[4],b.size() - 4);
+		if(!ok)
+		{
+			printf("push_msg failed seq=%d\n",i);
+			return false;
+		}
+	}
+	for(int i=0;i<500 && c.msgs < g_count;++i)
+	{
+		sleep_ms(10);
+	}
+	bool ok = srv.msgs == g_count && c.msgs == g_count && !c.bad && !srv.closes;
+	printf("roundtrip: server=%d client=%d bad=%d closes=%d %s\n",
+		(int)srv.msgs,(int)c.msgs,(int)c.bad,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+//兩個 消息 在 每一個 位置 分兩次 發送
+template<typename S>
+static bool test_split(const char* name,unsigned short port,std::size_t spill)
+{
+	S srv("127.0.0.1:" + boost::lexical_cast<std::string>(port));
+	if(spill)
+	{
+		srv.spill(spill);
+	}
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,port);
+
+	//每個 消息 [8字節 header][13字節 內容][4字節 crc] 兩個 消息 50 字節
+	const std::size_t n = 8 + 13;
+	const std::size_t frame = n + 4;
+	int sent = 0;
+	std::size_t total = 0;
+	std::vector<k0::byte_t> frames;
+	boost::system::error_code e;
+	for(std::size_t k=1;k<frame * 2 && !e;++k)
+	{
+		frames.clear();
+		for(int i=0;i<2;++i)
+		{
+			std::vector<k0::byte_t> b = make_body((k0::uint32_t)sent++,n);
+			bytes_spt f = k0::net::tcp::make_msg(&b[0],b.size(),true);
+			frames.insert(frames.end(),f->get(),f->get() + f->size());
+		}
+		total += frames.size();
+		//服務器 斷開 時 停止 發送
+		boost::asio::write(c,boost::asio::buffer(&frames[0],k),e);
+		sleep_ms(2);
+		if(!e)
+		{
+			boost::asio::write(c,boost::asio::buffer(&frames[k],frames.size() - k),e);
+		}
+		sleep_ms(2);
+	}
+	for(int i=0;i<200 && srv.msgs < sent;++i)
+	{
+		sleep_ms(10);
+	}
+	bool ok = srv.msgs == sent && !srv.bad && !srv.closes;
+	printf("split(%s): bytes=%u msgs=%d/%d bad=%d closes=%d %s\n",
+		name,(unsigned)total,(int)srv.msgs,sent,(int)srv.bad,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+//修改 第二個 消息 的 校驗 或 包體 後 服務器 應該 斷開
+static bool test_corrupt(const char* name,unsigned short port,bool trailer)
+{
+	msg_server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port));
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,port);
+
+	//第一個 消息 正確 第二個 被 修改
+	std::vector<k0::byte_t> b0 = make_body(0,40);
+	std::vector<k0::byte_t> b1 = make_body(1,40);
+	bytes_spt f0 = k0::net::tcp::make_msg(&b0[0],b0.size(),true);
+	bytes_spt f1 = k0::net::tcp::make_msg(&b1[0],b1.size(),true);
+	f1->get()[trailer ? f1->size() - 1 : 20] ^= 0x01;
+	boost::system::error_code e;
+	boost::asio::write(c,boost::asio::buffer(f0->get(),f0->size()),e);
+	boost::asio::write(c,boost::asio::buffer(f1->get(),f1->size()),e);
+
+	bool closed = closed_by_peer(c);
+	for(int i=0;i<100 && !srv.closes;++i)
+	{
+		sleep_ms(10);
+	}
+	bool ok = closed && srv.msgs == 1 && !srv.bad && srv.closes == 1;
+	printf("corrupt(%s): closed=%d msgs=%d closes=%d %s\n",
+		name,closed ? 1 : 0,(int)srv.msgs,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+int main()
+{
+	bool ok = test_roundtrip(23471);
+	ok = test_split<msg_server_t>("buffer",23472,0) && ok;
+	ok = test_split<msg_server_t>("spill",23473,8) && ok;
+	ok = test_split<mirror_server_t>("mirror",23474,0) && ok;
+	ok = test_corrupt("trailer",23475,true) && ok;
+	ok = test_corrupt("body",23476,false) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/*
+*	在 很小的 SO_SNDBUF 下 多線程 push_send 驗證 部分寫出 時 不丟失 也不重複 數據
+*
+*	每條 消息 [4字節 長度][4字節 序號][內容] 內容 由 序號 生成\n
+*	客戶端 使用 很小的 SO_RCVBUF 並 間歇 休眠 讀取 使 服務器 write 經常 只寫出 部分 數據
+*
+*	g++ -std=c++11 -O2 -I../../../../include stress_send.cpp -o stress_send -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./stress_send 成功 返回 0
+*/
+#include <k0/bytes/codec.hpp>
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+
+#include <cstdio>
+#include <vector>
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef k0::net::tcp::bytes_spt bytes_spt;
+
+//生產者 線程數
+static const int g_threads = 4;
+//每個 線程 發送的 消息數
+static const int g_count = 2000;
+//消息 最大長度
+static const std::size_t g_max = 1024 * 24;
+
+static k0::byte_t pattern(k0::uint32_t seq,std::size_t i)
+{
+	return (k0::byte_t)(seq * 31 + i * 7);
+}
+static std::size_t size_of(k0::uint32_t seq)
+{
+	return 8 + (seq * 2654435761u) % g_max;
+}
+
+class server_t : public server_bt
+{
+	boost::mutex _mutex;
+	boost::condition_variable _cv;
+	socket_spt _s;
+public:
+	boost::atomic<int> sends;
+
+	explicit server_t(const std::string& addr):server_bt(addr),sends(0)
+	{
+	}
+	virtual void on_accept(socket_spt& s)
+	{
+		boost::system::error_code e;
+		s->socket().set_option(boost::asio::socket_base::send_buffer_size(2048),e);
+
+		boost::mutex::scoped_lock lock(_mutex);
+		_s = s;
+		_cv.notify_all();
+	}
+	virtual void on_send(socket_spt& s,bytes_spt& buffer)
+	{
+		++sends;
+	}
+	socket_spt wait()
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		while(!_s)
+		{
+			_cv.wait(lock);
+		}
+		return _s;
+	}
+};
+
+static void produce(server_t* srv,server_t::socket_spt s,int id)
+{
+	for(int i=0;i<g_count;++i)
+	{
+		k0::uint32_t seq = (k0::uint32_t)(id * g_count + i);
+		std::size_t n = size_of(seq);
+		bytes_spt buffer = k0::bytes::make_bytes(n);
+		k0::byte_t* p = buffer->get();
+		k0::bytes::put_le<k0::uint32_t>(p,(k0::uint32_t)n);
+		k0::bytes::put_le<k0::uint32_t>(p + 4,seq);
+		for(std::size_t j=8;j<n;++j)
+		{
+			p[j] = pattern(seq,j);
+		}
+		if(!srv->push_send(s,buffer))
+		{
+			printf("push_send failed seq=%u\n",seq);
+			return;
+		}
+	}
+}
+
+int main()
+{
+	const int total = g_threads * g_count;
+	server_t srv("127.0.0.1:23457");
+
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	c.open(boost::asio::ip::tcp::v4());
+	c.set_option(boost::asio::socket_base::receive_buffer_size(2048));
+	c.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),23457));
+
+	server_t::socket_spt s = srv.wait();
+	boost::thread_group producers;
+	for(int i=0;i<g_threads;++i)
+	{
+		producers.create_thread(boost::bind(produce,&srv,s,i));
+	}
+
+	std::vector<bool> seen(total,false);
+	std::vector<k0::byte_t> stream;
+	std::vector<k0::byte_t> bytes(1500);
+	int msgs = 0;
+	int bad = 0;
+	std::size_t reads = 0;
+	while(msgs < total && !bad)
+	{
+		boost::system::error_code e;
+		std::size_t n = c.read_some(boost::asio::buffer(bytes),e);
+		if(e)
+		{
+			printf("read error %s\n",e.message().c_str());
+			break;
+		}
+		stream.insert(stream.end(),bytes.begin(),bytes.begin() + n);
+		if(++reads % 64 == 0)
+		{
+			//讓 服務器 發送緩衝區 填滿
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		}
+
+		std::size_t offset = 0;
+		while(stream.size() - offset >= 8)
+		{
+			const k0::byte_t* p = &stream[offset];
+			k0::uint32_t size = k0::bytes::get_le<k0::uint32_t>(p);
+			k0::uint32_t seq = k0::bytes::get_le<k0::uint32_t>(p + 4);
+			if(seq >= (k0::uint32_t)total || size != size_of(seq) || seen[seq])
+			{
+				printf("bad header at message %d seq=%u size=%u\n",msgs,seq,size);
+				++bad;
+				break;
+			}
+			if(stream.size() - offset < size)
+			{
+				break;
+			}
+			for(std::size_t j=8;j<size;++j)
+			{
+				if(p[j] != pattern(seq,j))
+				{
+					printf("bad byte seq=%u offset=%u\n",seq,(unsigned)j);
+					++bad;
+					break;
+				}
+			}
+			seen[seq] = true;
+			++msgs;
+			offset += size;
+		}
+		stream.erase(stream.begin(),stream.begin() + offset);
+	}
+	producers.join_all();
+	for(int i=0;i<100 && srv.sends < total;++i)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+	}
+
+	printf("msgs=%d/%d on_send=%d bad=%d leftover=%u\n",msgs,total,(int)srv.sends,bad,(unsigned)stream.size());
+	bool ok = msgs == total && srv.sends == total && !bad && stream.empty();
+	return ok ? 0 : 1;
+}
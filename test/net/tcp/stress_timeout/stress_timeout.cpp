@@ -0,0 +1,273 @@
+/*
+*	驗證 連接 超時
+*
+*	1 idle 超時 客戶端 不收不發 被 斷開 持續 發送的 客戶端 不被 斷開\n
+*	2 msg_server_t read 超時 只在 消息 未完整 時 生效 完整消息 之後 空閒 不被 斷開 半個 消息頭 之後 被 斷開\n
+*	3 on_timeout 返回 false 時 重新 計時 連接 保持\n
+*	4 多線程 共享 事件循環 客戶端 在 超時 附近 斷開 on_timeout 不會 在 on_close 之後 回調
+*
+*	g++ -std=c++11 -O2 -I../../../../include stress_timeout.cpp -o stress_timeout -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./stress_timeout 成功 返回 0
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+#include <k0/net/tcp/msg_server.hpp>
+
+#include <cstdio>
+#include <vector>
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef k0::net::tcp::msg_server_t<int> msg_server_bt;
+typedef k0::net::tcp::bytes_spt bytes_spt;
+
+class server_t : public server_bt
+{
+public:
+	boost::atomic<int> idles;
+	boost::atomic<int> reads;
+	boost::atomic<int> closes;
+	//on_timeout 返回 false 的 次數
+	boost::atomic<int> keeps;
+
+	server_t(const std::string& addr,std::size_t shards)
+		:server_bt(addr,1024,shards),idles(0),reads(0),closes(0),keeps(0)
+	{
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		return true;
+	}
+	virtual bool on_timeout(socket_spt& s,k0::net::tcp::timeout_t t)
+	{
+		if(t == k0::net::tcp::timeout_idle)
+		{
+			++idles;
+		}
+		else
+		{
+			++reads;
+		}
+		if(keeps > 0)
+		{
+			--keeps;
+			return false;
+		}
+		return true;
+	}
+	virtual void on_close(socket_spt& s)
+	{
+		++closes;
+	}
+};
+
+class msg_server_t : public msg_server_bt
+{
+public:
+	boost::atomic<int> msgs;
+	boost::atomic<int> reads;
+	boost::atomic<int> closes;
+
+	msg_server_t(const std::string& addr)
+		:msg_server_bt(addr),msgs(0),reads(0),closes(0)
+	{
+	}
+	virtual bool on_msg(socket_spt& s,bytes_spt& msg)
+	{
+		++msgs;
+		return true;
+	}
+	virtual bool on_timeout(socket_spt& s,k0::net::tcp::timeout_t t)
+	{
+		if(t == k0::net::tcp::timeout_read)
+		{
+			++reads;
+		}
+		return true;
+	}
+	virtual void on_close(socket_spt& s)
+	{
+		++closes;
+	}
+};
+
+//記錄 on_close 之後 收到的 on_timeout
+class order_server_t : public server_bt
+{
+public:
+	boost::atomic<int> expires;
+	boost::atomic<int> closes;
+	boost::atomic<int> bad;
+
+	explicit order_server_t(const std::string& addr)
+		:server_bt(addr,4096,0,k0::net::tcp::thread_config_t(4)),expires(0),closes(0),bad(0)
+	{
+	}
+	virtual void on_accept(socket_spt& s)
+	{
+		s->get_t() = 0;
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		return true;
+	}
+	virtual bool on_timeout(socket_spt& s,k0::net::tcp::timeout_t t)
+	{
+		++expires;
+		if(s->get_t())
+		{
+			++bad;
+		}
+		//讓 recv 處理器 有 機會 同時 關閉
+		boost::this_thread::yield();
+		if(s->get_t())
+		{
+			++bad;
+		}
+		return true;
+	}
+	virtual void on_close(socket_spt& s)
+	{
+		s->get_t() = 1;
+		++closes;
+	}
+};
+
+static void open_client(boost::asio::ip::tcp::socket& c,unsigned short port)
+{
+	c.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port));
+}
+
+static void sleep_ms(int ms)
+{
+	boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+}
+
+//對方 已經 斷開 時 返回 true
+static bool closed_by_peer(boost::asio::ip::tcp::socket& c)
+{
+	char b[16];
+	boost::system::error_code e;
+	c.read_some(boost::asio::buffer(b),e);
+	return e ? true : false;
+}
+
+//idle 超時
+static bool test_idle(std::size_t shards,unsigned short port)
+{
+	server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port),shards);
+	srv.timeouts(300,0,50);
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket idle(io_s);
+	boost::asio::ip::tcp::socket busy(io_s);
+	open_client(idle,port);
+	open_client(busy,port);
+
+	//busy 每 100ms 發送一次 持續 1s
+	for(int i=0;i<10;++i)
+	{
+		boost::asio::write(busy,boost::asio::buffer("ping",4));
+		sleep_ms(100);
+	}
+	int closes = srv.closes;
+	int idles = srv.idles;
+	bool ok = closes == 1 && idles == 1 && closed_by_peer(idle);
+
+	//busy 停止 後 也 超時
+	sleep_ms(600);
+	ok = ok && srv.closes == 2 && srv.idles == 2 && srv.reads == 0 && closed_by_peer(busy);
+	printf("idle(shards=%u): closes during busy=%d on_timeout=%d final closes=%d %s\n",
+		(unsigned)shards,closes,idles,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+//msg_server_t read 超時
+static bool test_read(unsigned short port)
+{
+	msg_server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port));
+	srv.timeouts(0,300,50);
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,port);
+
+	//完整 消息 長度 包含 4 字節 消息頭
+	k0::byte_t msg[8] = {8,0,0,0,'m','s','g','!'};
+	boost::asio::write(c,boost::asio::buffer(msg,sizeof(msg)));
+	sleep_ms(800);
+	int msgs = srv.msgs;
+	int closes = srv.closes;
+
+	//半個 消息頭 之後 停止
+	boost::asio::write(c,boost::asio::buffer(msg,2));
+	sleep_ms(600);
+	bool ok = msgs == 1 && closes == 0 && srv.reads == 1 && srv.closes == 1 && closed_by_peer(c);
+	printf("read: idle after message closes=%d partial header on_timeout=%d closes=%d %s\n",
+		closes,(int)srv.reads,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+//on_timeout 返回 false 保持 連接
+static bool test_keep(unsigned short port)
+{
+	server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port),0);
+	srv.keeps = 2;
+	srv.timeouts(200,0,20);
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,port);
+
+	//兩次 重新 計時 第三次 斷開
+	sleep_ms(500);
+	int closes = srv.closes;
+	sleep_ms(400);
+	bool ok = closes == 0 && srv.idles == 3 && srv.closes == 1 && closed_by_peer(c);
+	printf("keep: closes after 2 timeouts=%d on_timeout=%d final closes=%d %s\n",
+		closes,(int)srv.idles,(int)srv.closes,ok ? "ok" : "bad");
+	return ok;
+}
+
+//超時 和 對端 斷開 同時 發生
+static bool test_order(unsigned short port)
+{
+	order_server_t srv("127.0.0.1:" + boost::lexical_cast<std::string>(port));
+	srv.timeouts(60,0,5);
+	boost::asio::io_service io_s;
+	const int rounds = 5;
+	const int conns = 300;
+	for(int i=0;i<rounds;++i)
+	{
+		std::vector<boost::asio::ip::tcp::socket*> clients;
+		for(int j=0;j<conns;++j)
+		{
+			clients.push_back(new boost::asio::ip::tcp::socket(io_s));
+			open_client(*clients.back(),port);
+		}
+		sleep_ms(55 + i);
+		for(std::size_t j=0;j<clients.size();++j)
+		{
+			delete clients[j];
+		}
+		sleep_ms(150);
+	}
+	bool ok = srv.bad == 0 && srv.closes == rounds * conns;
+	printf("order: on_timeout=%d closes=%d on_timeout after on_close=%d %s\n",
+		(int)srv.expires,(int)srv.closes,(int)srv.bad,ok ? "ok" : "bad");
+	return ok;
+}
+
+int main()
+{
+	try
+	{
+		bool ok = test_idle(0,23468);
+		ok = test_idle(2,23469) && ok;
+		ok = test_read(23470) && ok;
+		ok = test_keep(23471) && ok;
+		ok = test_order(23473) && ok;
+		return ok ? 0 : 1;
+	}
+	catch(const std::exception& e)
+	{
+		printf("%s\n",e.what());
+		return 1;
+	}
+}
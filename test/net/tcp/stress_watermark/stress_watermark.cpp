@@ -0,0 +1,253 @@
+/*
+*	驗證 發送隊列 水位
+*
+*	1 echo 服務器 開啓 pause 客戶端 先 只發送 不讀取 服務器 隊列 不應 超過 高水位 太多 之後 讀取 時 數據 不丟失\n
+*	2 生產者 遇到 send_would_block 時 等待 on_writable 客戶端 慢速 讀取 數據 完整 有序\n
+*	3 客戶端 不讀取 超過 deadline 後 on_slow 斷開 連接
+*
+*	g++ -std=c++11 -O2 -I../../../../include stress_watermark.cpp -o stress_watermark -lpthread -lboost_thread -lboost_chrono -lboost_system
+*	./stress_watermark 成功 返回 0
+*/
+#include <k0/net/tcp/exception.hpp>
+#include <k0/net/tcp/server.hpp>
+
+#include <cstdio>
+#include <vector>
+
+typedef k0::net::tcp::server_t<int> server_bt;
+typedef k0::net::tcp::bytes_spt bytes_spt;
+
+static const std::size_t g_high = 1024 * 64;
+static const std::size_t g_low = 1024 * 16;
+
+class server_t : public server_bt
+{
+	boost::mutex _mutex;
+	boost::condition_variable _cv;
+	socket_spt _s;
+	bool _writable;
+public:
+	bool echo;
+	boost::atomic<std::size_t> peak;
+	boost::atomic<int> writables;
+	boost::atomic<int> slows;
+	boost::atomic<int> closes;
+
+	server_t(const std::string& addr,bool pause,std::size_t deadline)
+		:server_bt(addr),_writable(false),echo(false),peak(0),writables(0),slows(0),closes(0)
+	{
+		k0::net::tcp::watermark_t marks;
+		marks.high_bytes = g_high;
+		marks.low_bytes = g_low;
+		marks.pause = pause;
+		marks.deadline = deadline;
+		watermark(marks);
+	}
+	virtual void on_accept(socket_spt& s)
+	{
+		boost::system::error_code e;
+		s->socket().set_option(boost::asio::socket_base::send_buffer_size(4096),e);
+
+		boost::mutex::scoped_lock lock(_mutex);
+		_s = s;
+		_cv.notify_all();
+	}
+	virtual bool on_recv(socket_spt& s,k0::byte_t* b,std::size_t n)
+	{
+		if(!echo)
+		{
+			return true;
+		}
+		if(!push_send(s,b,n))
+		{
+			printf("echo rejected %u bytes\n",(unsigned)n);
+			return false;
+		}
+		std::size_t bytes = s->_bytes;
+		if(bytes > peak)
+		{
+			peak = bytes;
+		}
+		return true;
+	}
+	virtual void on_writable(socket_spt& s)
+	{
+		++writables;
+		boost::mutex::scoped_lock lock(_mutex);
+		_writable = true;
+		_cv.notify_all();
+	}
+	virtual bool on_slow(socket_spt& s)
+	{
+		++slows;
+		return true;
+	}
+	virtual void on_close(socket_spt& s)
+	{
+		++closes;
+	}
+	socket_spt wait()
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		while(!_s)
+		{
+			_cv.wait(lock);
+		}
+		return _s;
+	}
+	void wait_writable()
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		while(!_writable)
+		{
+			_cv.wait(lock);
+		}
+		_writable = false;
+	}
+};
+
+static void open_client(boost::asio::ip::tcp::socket& c,unsigned short port)
+{
+	c.open(boost::asio::ip::tcp::v4());
+	c.set_option(boost::asio::socket_base::receive_buffer_size(4096));
+	c.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),port));
+}
+
+//echo 服務器 暫停 recv
+static bool test_pause()
+{
+	const std::size_t total = 1024 * 1024 * 8;
+	server_t srv("127.0.0.1:23464",true,0);
+	srv.echo = true;
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,23464);
+	srv.wait();
+
+	//發送 直到 服務器 停止 讀取 對方 接收緩衝區 填滿
+	std::vector<k0::byte_t> out(total);
+	for(std::size_t i=0;i<total;++i)
+	{
+		out[i] = (k0::byte_t)(i * 7 + i / 4096);
+	}
+	c.non_blocking(true);
+	std::size_t sent = 0;
+	for(int idle=0;sent < total && idle < 50;)
+	{
+		boost::system::error_code e;
+		std::size_t n = c.write_some(boost::asio::buffer(&out[sent],total - sent),e);
+		if(e == boost::asio::error::would_block)
+		{
+			++idle;
+			boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+			continue;
+		}
+		sent += n;
+	}
+	std::size_t peak = srv.peak;
+	c.non_blocking(false);
+
+	//讀取 全部 echo 同時 發送 剩餘部分
+	std::vector<k0::byte_t> in(total);
+	std::size_t got = 0;
+	boost::thread writer([&c,&out,sent,total]
+	{
+		boost::system::error_code e;
+		boost::asio::write(c,boost::asio::buffer(&out[sent],total - sent),e);
+	});
+	boost::system::error_code e;
+	boost::asio::read(c,boost::asio::buffer(in),e);
+	got = e ? 0 : total;
+	writer.join();
+
+	bool ok = got == total && in == out && srv.peak <= g_high + 1024 * 64;
+	printf("pause: paused after %u bytes peak=%u final peak=%u echo=%s\n",
+		(unsigned)sent,(unsigned)peak,(unsigned)srv.peak,ok ? "ok" : "bad");
+	return ok;
+}
+
+//send_would_block 後 等待 on_writable
+static bool test_writable()
+{
+	const int count = 2000;
+	const std::size_t size = 1024 * 4;
+	server_t srv("127.0.0.1:23465",false,0);
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,23465);
+	server_t::socket_spt s = srv.wait();
+
+	int blocks = 0;
+	boost::thread producer([&srv,&s,&blocks,count,size]
+	{
+		for(int i=0;i<count;)
+		{
+			bytes_spt buffer = k0::bytes::make_bytes(size);
+			memset(buffer->get(),(k0::byte_t)i,size);
+			k0::net::tcp::send_status_t status = srv.try_send(s,buffer);
+			if(status == k0::net::tcp::send_would_block)
+			{
+				++blocks;
+				srv.wait_writable();
+				continue;
+			}
+			if(status != k0::net::tcp::send_ok)
+			{
+				printf("try_send failed %d\n",(int)status);
+				return;
+			}
+			++i;
+		}
+	});
+
+	std::vector<k0::byte_t> in(size);
+	int bad = 0;
+	for(int i=0;i<count && !bad;++i)
+	{
+		boost::system::error_code e;
+		boost::asio::read(c,boost::asio::buffer(in),e);
+		if(e || in[0] != (k0::byte_t)i || in[size - 1] != (k0::byte_t)i)
+		{
+			++bad;
+		}
+		if(i % 64 == 0)
+		{
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		}
+	}
+	producer.join();
+	bool ok = !bad && blocks > 0 && srv.writables == blocks;
+	printf("writable: would_block=%d on_writable=%d data=%s\n",blocks,(int)srv.writables,bad ? "bad" : "ok");
+	return ok;
+}
+
+//慢速 消費者 被 斷開
+static bool test_slow()
+{
+	server_t srv("127.0.0.1:23466",true,200);
+	srv.echo = true;
+	boost::asio::io_service io_s;
+	boost::asio::ip::tcp::socket c(io_s);
+	open_client(c,23466);
+	srv.wait();
+
+	std::vector<k0::byte_t> out(1024 * 1024,'s');
+	c.non_blocking(true);
+	for(int i=0;i<500 && !srv.closes;++i)
+	{
+		boost::system::error_code e;
+		c.write_some(boost::asio::buffer(out),e);
+		boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+	}
+	bool ok = srv.slows == 1 && srv.closes == 1;
+	printf("slow: on_slow=%d on_close=%d\n",(int)srv.slows,(int)srv.closes);
+	return ok;
+}
+
+int main()
+{
+	bool ok = test_pause();
+	ok = test_writable() && ok;
+	ok = test_slow() && ok;
+	return ok ? 0 : 1;
+}